@@ -1,10 +1,47 @@
 #include "atom.hpp"
 
-Atom::Atom() {
-  m_type = Type::NoneKind;
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+constexpr std::uint64_t Atom::BOX_BITS;
+constexpr std::uint64_t Atom::PAYLOAD_MASK;
+
+namespace {
+
+// the one NaN a Number holds, so no NaN a computation produces can be
+// mistaken for a tagged value
+const std::uint64_t CANONICAL_NAN = 0x7FF8000000000000ull;
+
+std::uint64_t bitsOf(double value) noexcept {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double doubleOf(std::uint64_t bits) noexcept {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
 }
 
-Atom::Atom(double value){
+}
+
+struct Atom::Box {
+  std::atomic<std::size_t> refs;
+};
+
+struct Atom::ComplexBox: Atom::Box {
+  std::complex<double> value;
+};
+
+struct Atom::StringBox: Atom::Box {
+  std::string text;
+};
+
+static_assert(sizeof(Atom) == 8, "Atom is not a single word");
+
+Atom::Atom(double value) noexcept: Atom() {
   setNumber(value);
 }
 
@@ -13,19 +50,29 @@ Atom::Atom(std::complex<double> value): Atom() {
 }
 
 Atom::Atom(const Token & token): Atom(){
+  setToken(token.asString());
+}
+
+Atom::Atom(const TokenView & token): Atom(){
+
+  // the tokenizer has already parsed any number
+  if(token.type() == Token::NUMBER){
+    setNumber(token.number());
+  }
+  else if(!std::isdigit(static_cast<unsigned char>(*token.data()))){
+    setSymbol(token.asString());
+  }
+}
+
+void Atom::setToken(const std::string & text){
 
-  std::istringstream iss(token.asString());
   double temp;
-  if(iss >> temp){
-    // is token a number?
-    // check for trailing characters if >> succeeds
-    if(iss.rdbuf()->in_avail() == 0){
-      setNumber(temp);
-    }
+  if(parseNumber(text.data(), text.data() + text.size(), temp)){
+    setNumber(temp);
   }
-  else if(!std::isdigit(token.asString()[0]) ){ 
+  else if(!std::isdigit(static_cast<unsigned char>(text[0])) ){
       // else assume symbol
-      setSymbol(token.asString());
+      setSymbol(text);
   }
 }
 
@@ -33,95 +80,80 @@ Atom::Atom(const std::string & value): Atom() {
   setSymbol(value);
 }
 
-Atom::Atom(const Atom & x): Atom(){
-
-  if(x.isNumber()){
-    setNumber(x.numberValue);
-  }
-  else if(x.isSymbol() || x.isString()){
-    setSymbol(x.stringValue);
-  }
-  else if(x.isComplex()){
-    setComplex(x.complexValue);
-  }
+Atom::ComplexBox * Atom::complexBox() const noexcept{
+  return reinterpret_cast<ComplexBox *>(static_cast<std::uintptr_t>(payload()));
 }
 
-Atom & Atom::operator=(const Atom & x){
-
-  if(this != &x){
-    if(x.m_type == NoneKind){
-      m_type = NoneKind;
-    }
-    else if(x.m_type == NumberKind){
-      setNumber(x.numberValue);
-    }
-    else if(x.m_type == SymbolKind){
-      setSymbol(x.stringValue);
-    }
-    else if(x.m_type == ComplexKind){
-      setComplex(x.complexValue);
-    }
-  }
-  return *this;
+Atom::StringBox * Atom::stringBox() const noexcept{
+  return reinterpret_cast<StringBox *>(static_cast<std::uintptr_t>(payload()));
 }
 
-Atom::~Atom(){
-
-  //ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
+Atom::Box * Atom::box() const noexcept{
+  if(tag() == ComplexTag){
+    return complexBox();
   }
+  return stringBox();
 }
 
-bool Atom::isNone() const noexcept{
-  return m_type == NoneKind;
-}
-
-bool Atom::isNumber() const noexcept{
-  return m_type == NumberKind;
+void Atom::retainBox() const noexcept{
+  box()->refs.fetch_add(1, std::memory_order_relaxed);
 }
 
-bool Atom::isSymbol() const noexcept{
-  return (m_type == SymbolKind && stringValue[0] != '"');
-}
+void Atom::releaseBox() noexcept{
 
-bool Atom::isComplex() const noexcept{
-  return m_type == ComplexKind;
+  if(box()->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+    if(tag() == ComplexTag){
+      delete complexBox();
+    }
+    else{
+      delete stringBox();
+    }
+  }
 }
 
-bool Atom::isString() const noexcept{
-  return m_type == SymbolKind && stringValue[0] == '"';
+std::uint64_t Atom::boxPayload(const Box * box) noexcept{
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(box);
+  assert((address & ~PAYLOAD_MASK) == 0 && "pointer does not fit an Atom payload");
+  return address;
 }
 
-void Atom::setNumber(double value){
+void Atom::setNumber(double value) noexcept{
 
-  m_type = NumberKind;
-  numberValue = value;
+  release();
+  m_bits = std::isnan(value) ? CANONICAL_NAN : bitsOf(value);
 }
 
 void Atom::setSymbol(const std::string & value){
 
-  // we need to ensure the destructor of the symbol string is called
-  if(m_type == SymbolKind){
-    stringValue.~basic_string();
+  // strings keep their quotes, and are boxed rather than interned
+  if(!value.empty() && value[0] == '"'){
+    StringBox * b = new StringBox();
+    b->refs.store(1, std::memory_order_relaxed);
+    b->text = value;
+    release();
+    m_bits = tagged(StringTag, boxPayload(b));
+    return;
   }
 
-  m_type = SymbolKind;
-
-  // copy construct in place
-  new (&stringValue) std::string(value);
+  SymbolId id = SymbolTable::intern(value);
+  release();
+  m_bits = tagged(SymbolTag, id);
 }
 
 void Atom::setComplex(const std::complex<double> & value){
-  m_type = ComplexKind;
-  complexValue = value;
+
+  ComplexBox * b = new ComplexBox();
+  b->refs.store(1, std::memory_order_relaxed);
+  b->value = value;
+  release();
+  m_bits = tagged(ComplexTag, boxPayload(b));
 }
 
 double Atom::asNumber() const noexcept{
-  if (m_type == ComplexKind) {
-    return complexValue.real();
+  if (isComplex()) {
+    return complexBox()->value.real();
   }
-  return (m_type == NumberKind) ? numberValue : 0.0;
+  return isNumber() ? doubleOf(m_bits) : 0.0;
 }
 
 
@@ -129,8 +161,11 @@ std::string Atom::asSymbol() const noexcept{
 
   std::string s;
 
-  if(m_type == SymbolKind){
-    s = stringValue;
+  if(isSymbol()){
+    s = SymbolTable::name(symbolId());
+  }
+  else if(isString()){
+    s = stringBox()->text;
     s.erase(remove( s.begin(), s.end(), '\"' ),s.end());
   }
 
@@ -141,56 +176,58 @@ std::string Atom::asString() const noexcept{
 
   std::ostringstream os;
 
-  if(m_type == SymbolKind){
-    os << stringValue;
+  if(isSymbol()){
+    return SymbolTable::name(symbolId());
+  }
+  else if(isString()){
+    return stringBox()->text;
   }
-  else if (m_type == NumberKind){
-    os << numberValue;
+  else if (isNumber()){
+    os << asNumber();
   }
-  else if (m_type == ComplexKind){
-    os << complexValue;
+  else if (isComplex()){
+    os << complexBox()->value;
   }
 
   return os.str();
 }
 
 std::complex<double> Atom::asComplex() const noexcept{
-  if (m_type == NumberKind) {
-    std::complex<double> number2complex(numberValue, 0.0);
+  if (isNumber()) {
+    std::complex<double> number2complex(asNumber(), 0.0);
     return number2complex;
   }
-  return (m_type == ComplexKind) ? complexValue : (std::complex<double>)(0);
+  return isComplex() ? complexBox()->value : (std::complex<double>)(0);
+}
+
+SymbolId Atom::propertyKey() const{
+  return isString() ? SymbolTable::intern(stringBox()->text) : symbolId();
 }
 
 bool Atom::operator==(const Atom & right) const noexcept{
 
-  if(m_type != right.m_type) return false;
+  if(tag() != right.tag()) return false;
 
-  switch(m_type){
-    case NoneKind:
-      if(right.m_type != NoneKind) return false;
+  switch(tag()){
+    case NoneTag:
       break;
-    case NumberKind:
+    case NumberTag:
       {
-        if(right.m_type != NumberKind) return false;
-        double dleft = numberValue;
-        double dright = right.numberValue;
+        double dleft = asNumber();
+        double dright = right.asNumber();
         double diff = fabs(dleft - dright);
         if(std::isnan(diff) || (diff > (std::numeric_limits<double>::epsilon()*2) ) )
           return false;
       }
       break;
-    case SymbolKind:
-      {
-        if(right.m_type != SymbolKind) return false;
-        return stringValue == right.stringValue;
-      }
-      break;
-    case ComplexKind:
+    case SymbolTag:
+      return m_bits == right.m_bits;
+    case StringTag:
+      return m_bits == right.m_bits || stringBox()->text == right.stringBox()->text;
+    case ComplexTag:
     {
-      if(right.m_type != ComplexKind) return false;
       std::complex<double> diff;
-      diff = (complexValue - right.complexValue);
+      diff = (complexBox()->value - right.complexBox()->value);
       double realPart = std::fabs(diff.real());
       double imagPart = std::fabs(diff.imag());
       if(realPart > std::numeric_limits<double>::epsilon()*2 || imagPart > std::numeric_limits<double>::epsilon()*2)
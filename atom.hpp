@@ -6,7 +6,9 @@ Defines the Atom type and associated functions.
 #define ATOM_HPP
 
 #include "token.hpp"
+#include "symbol_table.hpp"
 #include <complex>
+#include <cstdint>
 #include <limits>
 #include <sstream>
 #include <cctype>
@@ -16,16 +18,23 @@ Defines the Atom type and associated functions.
 /*! \class Atom
 \brief A variant type that may be a Number or Symbol or the default type None.
 
-This class provides value semantics.
+This class provides value semantics. An Atom is a single NaN-boxed 64-bit
+word: a Number is stored as its own bits, and every other type as a quiet
+NaN pattern arithmetic never produces, tagged with the type. Symbols are
+interned in the SymbolTable and stored by ID, so copying and comparing them
+is an integer operation. A String or Complex value does not fit in a word,
+so it is stored in a shared heap box; these are the types whose copies
+touch a reference count. Strings are not interned, so the strings a program
+builds are freed with their last Atom.
 */
 class Atom {
 public:
 
   /// Construct a default Atom of type None
-  Atom();
+  Atom() noexcept;
 
   /// Construct an Atom of type Number with value
-  Atom(double value);
+  Atom(double value) noexcept;
 
   /// Construct an Atom of type Symbol named value
   Atom(const std::string & value);
@@ -36,11 +45,17 @@ public:
   /// Construct an Atom directly from a Token
   Atom(const Token & token);
 
+  /// Construct an Atom directly from a token read from a buffer
+  Atom(const TokenView & token);
+
   /// Copy-construct an Atom
-  Atom(const Atom & x);
+  Atom(const Atom & x) noexcept;
+
+  /// Move-construct an Atom, leaving x None
+  Atom(Atom && x) noexcept;
 
   /// Assign an Atom
-  Atom & operator=(const Atom & x);
+  Atom & operator=(const Atom & x) noexcept;
 
   /// Atom destructor
   ~Atom();
@@ -72,36 +87,156 @@ public:
   /// value of Atom as a comlex number, returns 0 if not a complex number
   std::complex<double> asComplex() const noexcept;
 
+  /// interned ID of a Symbol, only meaningful if isSymbol()
+  SymbolId symbolId() const noexcept;
+
+  /// interned ID of a Symbol, or of a String with its quotes, interning
+  /// the String; used for property keys
+  SymbolId propertyKey() const;
+
   /// equality comparison based on type and value
   bool operator==(const Atom & right) const noexcept;
 
 private:
 
-  // internal enum of known types
-  enum Type {NoneKind, NumberKind, SymbolKind, ComplexKind};
+  // the type of the value: a Number is any word that is not a boxed NaN
+  // pattern, and the other types are stored in its bits 48-50
+  enum Tag : std::uint64_t {NumberTag = 0, NoneTag, SymbolTag, StringTag, ComplexTag};
+
+  // the bits of a negative quiet NaN; a word with all of them set and a
+  // nonzero tag below them is not a Number
+  static constexpr std::uint64_t BOX_BITS = 0xFFF8000000000000ull;
+
+  // the bits below the tag
+  static constexpr std::uint64_t PAYLOAD_MASK = 0x0000FFFFFFFFFFFFull;
+
+  // the number of Atoms sharing a boxed value
+  struct Box;
+
+  // a boxed Complex value
+  struct ComplexBox;
+
+  // a boxed String, with its quotes
+  struct StringBox;
+
+  // the value: the bits of a Number, or a tag and its payload
+  std::uint64_t m_bits;
 
-  // track the type
-  Type m_type;
+  // the word of a tagged value
+  static std::uint64_t tagged(Tag tag, std::uint64_t payload) noexcept;
 
-  // values for the known types. Note the use of a union requires care
-  // when setting non POD values (see setSymbol)
-  union {
-    double numberValue;
-    std::string stringValue;
-    std::complex<double> complexValue;
-  };
+  // the tag of a tagged value, or NumberTag for a Number
+  Tag tag() const noexcept;
+
+  // the low bits holding a symbol ID or box pointer
+  std::uint64_t payload() const noexcept;
+
+  // true if the value is in a Box
+  bool isBoxed() const noexcept;
+
+  // the box of a String or Complex
+  Box * box() const noexcept;
+
+  // the box of a Complex
+  ComplexBox * complexBox() const noexcept;
+
+  // the box of a String
+  StringBox * stringBox() const noexcept;
+
+  // the payload of a new box, which must fit below the tag
+  static std::uint64_t boxPayload(const Box * box) noexcept;
 
   // helper to set type and value of Number
-  void setNumber(double value);
+  void setNumber(double value) noexcept;
 
-  // helper to set type and value of Symbol
+  // helper to set type and value of Symbol, or of String if value is quoted
   void setSymbol(const std::string & value);
 
   // helper to set type and value of a Complex Number
   void setComplex(const std::complex<double> & value);
 
+  // helper to set type and value from the text of a token
+  void setToken(const std::string & text);
+
+  // helper to share the box of a String or Complex
+  void retain() const noexcept;
+
+  // helper to drop this Atom's share of a box, before changing type
+  void release() noexcept;
+
+  // the slow paths of retain and release, for a String or Complex
+  void retainBox() const noexcept;
+  void releaseBox() noexcept;
 };
 
+// Copying, destroying and testing the type of an Atom are inline: every
+// copy of an Expression node goes through them, and apart from a String or
+// Complex they are a few integer operations.
+
+inline Atom::Atom() noexcept: m_bits(tagged(NoneTag, 0)) {}
+
+inline Atom::Atom(const Atom & x) noexcept: m_bits(x.m_bits) {
+  retain();
+}
+
+inline Atom::Atom(Atom && x) noexcept: m_bits(x.m_bits) {
+  x.m_bits = tagged(NoneTag, 0);
+}
+
+inline Atom & Atom::operator=(const Atom & x) noexcept {
+
+  // share x's box before dropping ours, which may be the same one, and
+  // read its bits first in case x is this Atom
+  std::uint64_t bits = x.m_bits;
+  x.retain();
+  release();
+  m_bits = bits;
+  return *this;
+}
+
+inline Atom::~Atom(){
+  release();
+}
+
+inline std::uint64_t Atom::tagged(Tag tag, std::uint64_t payload) noexcept {
+  return BOX_BITS | (static_cast<std::uint64_t>(tag) << 48) | payload;
+}
+
+inline Atom::Tag Atom::tag() const noexcept {
+  return ((m_bits & BOX_BITS) == BOX_BITS) ? static_cast<Tag>((m_bits >> 48) & 7) : NumberTag;
+}
+
+inline std::uint64_t Atom::payload() const noexcept {
+  return m_bits & PAYLOAD_MASK;
+}
+
+inline bool Atom::isNone() const noexcept { return tag() == NoneTag; }
+inline bool Atom::isNumber() const noexcept { return tag() == NumberTag; }
+inline bool Atom::isSymbol() const noexcept { return tag() == SymbolTag; }
+inline bool Atom::isComplex() const noexcept { return tag() == ComplexTag; }
+inline bool Atom::isString() const noexcept { return tag() == StringTag; }
+
+inline SymbolId Atom::symbolId() const noexcept {
+  return static_cast<SymbolId>(payload());
+}
+
+inline bool Atom::isBoxed() const noexcept {
+  return tag() >= StringTag;
+}
+
+inline void Atom::retain() const noexcept {
+  if(isBoxed()){
+    retainBox();
+  }
+}
+
+inline void Atom::release() noexcept {
+  if(isBoxed()){
+    releaseBox();
+  }
+  m_bits = tagged(NoneTag, 0);
+}
+
 /// inequality comparison for Atom
 bool operator!=(const Atom &left, const Atom & right) noexcept;
 
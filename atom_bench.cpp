@@ -0,0 +1,55 @@
+#include "bench.hpp"
+
+#include <vector>
+
+#include "atom.hpp"
+
+static std::vector<Atom> mixed_atoms(std::size_t n){
+
+  std::vector<Atom> atoms;
+  atoms.reserve(n);
+  for(std::size_t i = 0; i < n; ++i){
+    switch(i % 3){
+      case 0:
+        atoms.push_back(Atom(0.5 * i));
+        break;
+      case 1:
+        atoms.push_back(Atom("x"));
+        break;
+      default:
+        atoms.push_back(Atom("\"a string label\""));
+    }
+  }
+  return atoms;
+}
+
+static void atom_copy(){
+
+  const std::size_t N = 100;
+  const std::size_t ITEMS = 100000;
+
+  std::vector<Atom> atoms = mixed_atoms(ITEMS);
+  double ns = bench::time_ns(N, [&](){
+    std::vector<Atom> copy(atoms);
+    bench::keep(&copy);
+  });
+  bench::report("copy", ns / ITEMS, "per atom, numbers, symbols and strings");
+}
+BENCHMARK(atom_copy, "atom copy");
+
+static void atom_compare(){
+
+  const std::size_t N = 100;
+  const std::size_t ITEMS = 100000;
+
+  std::vector<Atom> left = mixed_atoms(ITEMS), right = mixed_atoms(ITEMS);
+  double ns = bench::time_ns(N, [&](){
+    std::size_t equal = 0;
+    for(std::size_t i = 0; i < ITEMS; ++i){
+      equal += (left[i] == right[i]);
+    }
+    bench::keep(&equal);
+  });
+  bench::report("compare", ns / ITEMS, "per atom, numbers, symbols and strings");
+}
+BENCHMARK(atom_compare, "atom compare");
@@ -1,5 +1,8 @@
 #include "catch.hpp"
 
+#include <limits>
+#include <utility>
+
 #include "atom.hpp"
 
 TEST_CASE( "Test atom constructors", "[atom]" ) {
@@ -281,5 +284,68 @@ TEST_CASE( "Test atom comparisons", "[atom]" ) {
 
 }
 
+TEST_CASE( "Test atoms are a single word", "[atom]" ) {
+
+  REQUIRE(sizeof(Atom) == 8);
+
+  {
+    INFO("every double is a number, NaNs and infinities included");
+    double values[] = {0.0, -0.0, 1e308, -1e-308, std::numeric_limits<double>::infinity(),
+                       -std::numeric_limits<double>::infinity(),
+                       std::numeric_limits<double>::quiet_NaN(),
+                       -std::numeric_limits<double>::quiet_NaN()};
+    for(double x : values){
+      Atom a(x);
+      REQUIRE(a.isNumber());
+      REQUIRE(!a.isNone());
+      if(std::isnan(x)){
+        REQUIRE(std::isnan(a.asNumber()));
+      }
+      else{
+        REQUIRE(a.asNumber() == x);
+      }
+    }
+  }
 
+  {
+    INFO("strings keep their quotes and compare by their text");
+    Atom a("\"a string\"");
+    REQUIRE(a.asString() == "\"a string\"");
+    REQUIRE(a.asSymbol() == "a string");
+    REQUIRE(a == Atom("\"a string\""));
+    REQUIRE(a != Atom("\"another string\""));
+    REQUIRE(a != Atom("a string"));
+
+    // copies share the string, which outlives the original
+    Atom c;
+    {
+      Atom b(a);
+      c = b;
+    }
+    REQUIRE(c.asString() == "\"a string\"");
+
+    // a string is interned only when used as a property key
+    REQUIRE(a.propertyKey() == SymbolTable::intern("\"a string\""));
+    REQUIRE(a.propertyKey() != Atom("a string").propertyKey());
+  }
 
+  {
+    INFO("complex copies share a box that outlives the original");
+    Atom c;
+    {
+      Atom a(std::complex<double>(1, -2));
+      Atom b(a);
+      c = b;
+      c = c;
+      REQUIRE(b.asComplex() == std::complex<double>(1, -2));
+    }
+    REQUIRE(c.isComplex());
+    REQUIRE(c.asComplex() == std::complex<double>(1, -2));
+
+    Atom moved(std::move(c));
+    REQUIRE(c.isNone());
+    REQUIRE(moved == Atom(std::complex<double>(1, -2)));
+    moved = Atom(3.0);
+    REQUIRE(moved.isNumber());
+  }
+}
@@ -0,0 +1,62 @@
+/*! \file bench.hpp
+Defines a minimal harness for the micro-benchmarks.
+
+Each benchmark is a plain function registered under a name with
+BENCHMARK. The benchmarks executable runs every registered function whose
+name contains the (optional) command line filter.
+ */
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+/// a registered benchmark
+struct Case {
+  std::string name;
+  void (*run)();
+};
+
+/// return all registered benchmarks
+std::vector<Case> & registry();
+
+/// registers a benchmark at static-initialization time
+struct Registrar {
+  Registrar(const char * name, void (*run)());
+};
+
+/// print one result line: label, nanoseconds per operation and a note
+void report(const std::string & label, double ns_per_op, const std::string & note = "");
+
+/// prevent the optimizer from discarding a computed value
+void keep(const void * value);
+
+/// return the number of calls to the global operator new so far
+std::size_t allocations();
+
+/*! time fn, called iterations times
+  \return the mean wall time per call in nanoseconds
+ */
+template <typename F>
+double time_ns(std::size_t iterations, F fn){
+
+  auto start = std::chrono::steady_clock::now();
+  for(std::size_t i = 0; i < iterations; ++i){
+    fn();
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+}
+
+}
+
+/// register function as a benchmark called name
+#define BENCHMARK(function, name) \
+  static bench::Registrar function##_registrar(name, function)
+
+#endif
@@ -0,0 +1,85 @@
+#include "bench.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+namespace {
+
+std::atomic<std::size_t> allocation_count(0);
+
+}
+
+// count every allocation, so a benchmark can report how many it made
+void * operator new(std::size_t bytes){
+
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void * p = std::malloc(bytes ? bytes : 1);
+  if(!p){
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p) noexcept{
+  std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept{
+  std::free(p);
+}
+
+namespace bench {
+
+std::vector<Case> & registry(){
+  static std::vector<Case> cases;
+  return cases;
+}
+
+Registrar::Registrar(const char * name, void (*run)()){
+  registry().push_back(Case{name, run});
+}
+
+void report(const std::string & label, double ns_per_op, const std::string & note){
+  std::cout << "  " << std::left << std::setw(48) << label
+            << std::right << std::setw(14) << std::fixed << std::setprecision(1)
+            << ns_per_op << " ns/op";
+  if(!note.empty()){
+    std::cout << "  " << note;
+  }
+  std::cout << std::endl;
+}
+
+void keep(const void * value){
+#if defined(__GNUC__)
+  // the compiler must assume the empty asm reads value and all memory
+  asm volatile("" : : "g"(value) : "memory");
+#else
+  static const void * volatile sink;
+  sink = value;
+  const void * volatile read = sink;
+  (void)read;
+#endif
+}
+
+std::size_t allocations(){
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  std::string filter = (argc > 1) ? argv[1] : "";
+
+  for(auto & c : bench::registry()){
+    if(c.name.find(filter) == std::string::npos) continue;
+
+    std::cout << c.name << std::endl;
+    c.run();
+  }
+
+  return EXIT_SUCCESS;
+}
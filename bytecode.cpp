@@ -0,0 +1,401 @@
+#include "bytecode.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Walks a SyntaxTree in the same order as Expression::eval walks the
+// Expression it is the tree of, emitting the instructions that reproduce
+// its behavior. The walk keeps its own stack of pending steps rather than
+// recursing, so a deeply nested program cannot overflow the C++ stack.
+class Compiler {
+public:
+
+  // known is false when the parameters of the lambdas enclosing the tree
+  // are unknown, and no call may be resolved at compile time
+  Compiler(const SyntaxTree & t, bool known): tree(t) {
+    units.push_back(Unit{Chunk(), std::vector<SymbolId>(), known, Expression()});
+  }
+
+  // compile node n and the Return ending the program
+  Chunk compileProgram(NodeId n);
+
+private:
+
+  // what remains to be done for a node
+  enum class Step {
+    Compile,   // emit the node, scheduling its children
+    Finish,    // emit what follows the node's children
+    Pop,       // emit Pop
+    Arguments, // compile the node and then its following siblings
+    Sequence   // compile the node, then Pop and its following siblings
+  };
+
+  struct Task {
+    Step step;
+    NodeId node;
+  };
+
+  // the chunk being emitted into: the program, or the body of a lambda
+  struct Unit {
+    Chunk chunk;
+    std::vector<SymbolId> parameters; // of the enclosing lambdas
+    bool known;                       // false if they are unknown
+    Expression lambda;                // the lambda whose body this is
+  };
+
+  const SyntaxTree & tree;
+
+  std::vector<Task> tasks;
+
+  // the innermost unit last
+  std::vector<Unit> units;
+
+  Chunk & chunk() noexcept {
+    return units.back().chunk;
+  }
+
+  void emit(OpCode op, std::uint32_t a = 0, std::uint32_t b = 0){
+    chunk().code.push_back(Instruction{op, a, b});
+  }
+
+  void schedule(Step step, NodeId n){
+    tasks.push_back(Task{step, n});
+  }
+
+  // return the i-th child of node n
+  NodeId child(NodeId n, std::size_t i) const noexcept {
+    return tree.child(n, i);
+  }
+
+  std::uint32_t constant(const Expression & exp){
+    chunk().constants.push_back(exp);
+    return chunk().constants.size() - 1;
+  }
+
+  std::uint32_t atom(const Atom & a){
+    std::vector<Atom> & atoms = chunk().atoms;
+    for(std::size_t i = 0; i < atoms.size(); ++i){
+      if(atoms[i] == a) return i;
+    }
+    atoms.push_back(a);
+    return atoms.size() - 1;
+  }
+
+  std::uint32_t string(const std::string & s){
+    chunk().strings.push_back(s);
+    return chunk().strings.size() - 1;
+  }
+
+  void fail(const std::string & message){
+    emit(OpCode::Fail, string(message));
+  }
+
+  std::uint32_t procedure(const Procedure & proc){
+    std::vector<Procedure> & procedures = chunk().procedures;
+    for(std::size_t i = 0; i < procedures.size(); ++i){
+      if(procedures[i] == proc) return i;
+    }
+    procedures.push_back(proc);
+    return procedures.size() - 1;
+  }
+
+  // true if head names the same built-in procedure wherever this code runs
+  bool resolve(const Atom & head, Procedure & proc) const {
+    const Unit & unit = units.back();
+    if(!unit.known || !builtinProcedure(head, proc)){
+      return false;
+    }
+    return std::find(unit.parameters.begin(), unit.parameters.end(), head.symbolId()) == unit.parameters.end();
+  }
+
+  void compileNode(NodeId n);
+  void finishNode(NodeId n);
+
+  void compileLookup(const Atom & head);
+  void compileDefine(NodeId n);
+  void finishDefine(NodeId n);
+  void compileLambda(NodeId n);
+  void finishLambda();
+  void compileApplyOrMap(NodeId n, bool isMap);
+  void finishApplyOrMap(NodeId n, bool isMap);
+  void compileSetProperty(NodeId n);
+  void compileGetProperty(NodeId n);
+  void finishGetProperty(NodeId n);
+  void finishCall(NodeId n);
+};
+
+Chunk Compiler::compileProgram(NodeId n){
+
+  schedule(Step::Compile, n);
+  while(!tasks.empty()){
+    Task task = tasks.back();
+    tasks.pop_back();
+
+    switch(task.step){
+    case Step::Compile:
+      compileNode(task.node);
+      break;
+    case Step::Finish:
+      finishNode(task.node);
+      break;
+    case Step::Pop:
+      emit(OpCode::Pop);
+      break;
+    case Step::Arguments:
+      if(tree.nextSibling(task.node) != SyntaxTree::NONE){
+        schedule(Step::Arguments, tree.nextSibling(task.node));
+      }
+      schedule(Step::Compile, task.node);
+      break;
+    case Step::Sequence:
+      if(tree.nextSibling(task.node) != SyntaxTree::NONE){
+        schedule(Step::Sequence, tree.nextSibling(task.node));
+        schedule(Step::Pop, task.node);
+      }
+      schedule(Step::Compile, task.node);
+      break;
+    }
+  }
+
+  emit(OpCode::Return);
+  return std::move(chunk());
+}
+
+// Steps are scheduled in the reverse of the order they run in.
+
+void Compiler::compileNode(NodeId n){
+
+  switch(tree.form(n)){
+    case SpecialForm::Lookup:
+      return compileLookup(tree.head(n));
+    case SpecialForm::Begin:
+      if(tree.firstChild(n) != SyntaxTree::NONE){
+        schedule(Step::Sequence, tree.firstChild(n));
+      }
+      return;
+    case SpecialForm::Define:
+      return compileDefine(n);
+    case SpecialForm::Lambda:
+      return compileLambda(n);
+    case SpecialForm::Apply:
+      return compileApplyOrMap(n, false);
+    case SpecialForm::Map:
+      return compileApplyOrMap(n, true);
+    case SpecialForm::SetProperty:
+      return compileSetProperty(n);
+    case SpecialForm::GetProperty:
+      return compileGetProperty(n);
+    case SpecialForm::DiscretePlot:
+    case SpecialForm::ContinuousPlot:
+      // plot construction is dominated by its own work, not dispatch, so
+      // defer to the tree-walking evaluator
+      emit(OpCode::EvalTree, constant(tree.toExpression(n)));
+      return;
+    default:
+      break;
+  }
+
+  // a list or a call: its arguments, then the node itself
+  schedule(Step::Finish, n);
+  if(tree.firstChild(n) != SyntaxTree::NONE){
+    schedule(Step::Arguments, tree.firstChild(n));
+  }
+}
+
+void Compiler::finishNode(NodeId n){
+
+  switch(tree.form(n)){
+    case SpecialForm::List:
+      return emit(OpCode::MakeList, tree.childCount(n));
+    case SpecialForm::Define:
+      return finishDefine(n);
+    case SpecialForm::Lambda:
+      return finishLambda();
+    case SpecialForm::Apply:
+      return finishApplyOrMap(n, false);
+    case SpecialForm::Map:
+      return finishApplyOrMap(n, true);
+    case SpecialForm::SetProperty:
+      return emit(OpCode::SetProperty, tree.head(child(n, 0)).propertyKey());
+    case SpecialForm::GetProperty:
+      return finishGetProperty(n);
+    default:
+      break;
+  }
+
+  finishCall(n);
+}
+
+void Compiler::compileLookup(const Atom & head){
+
+  if(head.isSymbol()){
+    emit(OpCode::Lookup, atom(head));
+  }
+  else if(head.isNumber() || head.isComplex() || head.isString()){
+    emit(OpCode::PushConst, constant(Expression(head)));
+  }
+  else{
+    fail("Error during handle lookup: Invalid type in terminal expression");
+  }
+}
+
+void Compiler::compileDefine(NodeId n){
+
+  if(tree.childCount(n) != 2){
+    return fail("Error during handle define: invalid number of arguments to define");
+  }
+
+  const Atom & name = tree.head(child(n, 0));
+  if(!name.isSymbol()){
+    return fail("Error during handle define: first argument to define not symbol");
+  }
+
+  SymbolId s = name.symbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol) || (s == LambdaSymbol) || (s == ListSymbol)) {
+    return fail("Error during handle define: attempt to redefine a special-form");
+  }
+
+  emit(OpCode::CheckDefine, atom(name));
+  schedule(Step::Finish, n);
+  schedule(Step::Compile, child(n, 1));
+}
+
+void Compiler::finishDefine(NodeId n){
+  emit(OpCode::Define, atom(tree.head(child(n, 0))));
+}
+
+void Compiler::compileLambda(NodeId n){
+
+  if(tree.childCount(n) != 2){
+    return fail("Error during handle lambda: invalid number of arguments to lambda");
+  }
+
+  NodeId params = child(n, 0);
+  std::vector<Expression> argument_template;
+  argument_template.emplace_back(Expression(tree.head(params)));
+  for(NodeId c = tree.firstChild(params); c != SyntaxTree::NONE; c = tree.nextSibling(c)){
+    argument_template.emplace_back(tree.toExpression(c));
+  }
+
+  // the body sees these parameters as well as those of the lambdas
+  // enclosing this one
+  Unit inner{Chunk(), std::vector<SymbolId>(), units.back().known, Expression()};
+  if(inner.known){
+    inner.parameters = units.back().parameters;
+    for(const Expression & p : argument_template){
+      if(p.head().isSymbol()) inner.parameters.push_back(p.head().symbolId());
+    }
+  }
+
+  // the body is emitted into its own chunk, which finishLambda attaches
+  NodeId body = child(n, 1);
+  inner.lambda = Expression(argument_template, tree.toExpression(body));
+  units.push_back(std::move(inner));
+  schedule(Step::Finish, n);
+  schedule(Step::Compile, body);
+}
+
+void Compiler::finishLambda(){
+
+  emit(OpCode::Return);
+  Unit inner = std::move(units.back());
+  units.pop_back();
+
+  inner.lambda.setCode(std::make_shared<const Chunk>(std::move(inner.chunk)));
+  emit(OpCode::MakeLambda, constant(inner.lambda));
+}
+
+void Compiler::compileApplyOrMap(NodeId n, bool isMap){
+
+  if(tree.childCount(n) != 2){
+    return fail(isMap ? "Error during map: invalid number of arguments"
+                      : "Error during apply: invalid number of arguments");
+  }
+
+  NodeId op = child(n, 0);
+  std::uint32_t flags = 0;
+  if(tree.childCount(op) > 0) flags |= OperatorHasTail;
+  if(isMap) flags |= CallerIsMap;
+
+  emit(OpCode::CheckCallable, atom(tree.head(op)), flags);
+  schedule(Step::Finish, n);
+  schedule(Step::Compile, child(n, 1));
+}
+
+void Compiler::finishApplyOrMap(NodeId n, bool isMap){
+  emit(isMap ? OpCode::Map : OpCode::Apply, atom(tree.head(child(n, 0))));
+}
+
+void Compiler::compileSetProperty(NodeId n){
+
+  if(tree.childCount(n) != 3){
+    return fail("Error invalid number of arguments for set-property.");
+  }
+  const Atom & key = tree.head(child(n, 0));
+  if(!key.isString()){
+    return fail("Error: first argument to set-property not a string.");
+  }
+
+  // the value is evaluated before the target
+  schedule(Step::Finish, n);
+  schedule(Step::Compile, child(n, 1));
+  schedule(Step::Compile, child(n, 2));
+}
+
+void Compiler::compileGetProperty(NodeId n){
+
+  if(tree.childCount(n) != 2){
+    return fail("Error: invalid number of arguments for get-property.");
+  }
+
+  schedule(Step::Finish, n);
+  schedule(Step::Compile, child(n, 1));
+}
+
+void Compiler::finishGetProperty(NodeId n){
+
+  // the key is checked after the target is evaluated, as eval does
+  const Atom & key = tree.head(child(n, 0));
+  if(!key.isString()){
+    return fail("Error: first argument to get-property not a string.");
+  }
+  emit(OpCode::GetProperty, key.propertyKey());
+}
+
+void Compiler::finishCall(NodeId n){
+
+  const Atom & head = tree.head(n);
+  std::uint32_t argc = tree.childCount(n);
+  Procedure proc;
+  if(!resolve(head, proc)){
+    emit(OpCode::Call, atom(head), argc);
+  }
+  else if(!proc.signature().accepts(argc)){
+    fail(proc.signature().arityError);
+  }
+  else{
+    emit(OpCode::CallBuiltin, procedure(proc), argc);
+  }
+}
+
+}
+
+std::shared_ptr<const Chunk> compile(const SyntaxTree & tree, NodeId node){
+
+  Compiler compiler(tree, true);
+  return std::make_shared<const Chunk>(compiler.compileProgram(node));
+}
+
+std::shared_ptr<const Chunk> compile(const Expression & exp){
+
+  SyntaxTree tree(exp);
+  return compile(tree, tree.root());
+}
+
+std::shared_ptr<const Chunk> compileBody(const Expression & lambda){
+
+  SyntaxTree tree(lambda.tailConstBegin()[1]);
+  Compiler compiler(tree, false);
+  return std::make_shared<const Chunk>(compiler.compileProgram(tree.root()));
+}
@@ -0,0 +1,119 @@
+/*! \file bytecode.hpp
+Defines the bytecode representation of a program and the compiler that
+lowers a parsed program (abstract syntax tree) into it.
+ */
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "atom.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+#include "syntax_tree.hpp"
+
+/*! \enum OpCode
+\brief The instructions understood by the VM.
+
+Every instruction operates on the VM operand stack. Operands a and b of an
+Instruction index into the owning Chunk's tables as noted below.
+ */
+enum class OpCode : std::uint8_t {
+  PushConst,     //< push constants[a]
+  Lookup,        //< push the expression bound to atoms[a]
+  MakeList,      //< pop a values, push them as a list
+  MakeLambda,    //< push constants[a] (a compiled lambda)
+  Pop,           //< discard the top of the stack
+  CheckDefine,   //< verify atoms[a] may be (re)defined
+  Define,        //< bind atoms[a] to the top of the stack (left in place)
+  Call,          //< pop b arguments, call atoms[a] with them
+  CallBuiltin,   //< pop b arguments, call procedures[a] with them; the
+                 //< arity was checked at compile time
+  CheckCallable, //< verify atoms[a] names a procedure, b holds CallableFlags
+  Apply,         //< pop a list, call atoms[a] with its items
+  Map,           //< pop a list, call atoms[a] on each item
+  SetProperty,   //< pop value and target, set the property interned as a on target
+  GetProperty,   //< pop target, push the property interned as a of target
+  EvalTree,      //< push the tree-walking evaluation of constants[a]
+  Fail,          //< throw a SemanticError with message strings[a]
+  Return         //< return the top of the stack to the caller
+};
+
+/*! \enum CallableFlags
+\brief Bit flags carried in operand b of CheckCallable.
+ */
+enum CallableFlags : std::uint32_t {
+  OperatorHasTail = 1, //< the operator node had a (non-empty) tail
+  CallerIsMap = 2      //< report errors as coming from map rather than apply
+};
+
+/// A single VM instruction: an opcode and two operands
+struct Instruction {
+  OpCode op;
+  std::uint32_t a;
+  std::uint32_t b;
+};
+
+/*! \class Chunk
+\brief A compiled unit of bytecode and the tables its instructions refer to.
+
+A Chunk is immutable once compiled and may be shared between interpreters.
+ */
+class Chunk {
+public:
+  /// the instruction sequence, always terminated by Return
+  std::vector<Instruction> code;
+
+  /// constant Expressions referenced by PushConst, MakeLambda, etc.
+  std::vector<Expression> constants;
+
+  /// symbols referenced by Lookup, Define, Call, etc.
+  std::vector<Atom> atoms;
+
+  /// error messages referenced by Fail
+  std::vector<std::string> strings;
+
+  /// built-in procedures referenced by CallBuiltin
+  std::vector<Procedure> procedures;
+};
+
+/*! \fn compile
+\brief lower a syntax tree into bytecode
+
+\param tree the parsed program
+\param node the node of the tree to compile
+\return the compiled Chunk
+
+Compilation never throws for semantic errors; such errors are compiled
+into Fail instructions so they are raised at the same point during
+execution as the tree-walking evaluator would raise them.
+
+A call to a built-in procedure that no enclosing lambda parameter shadows
+is resolved here, and its argument count checked, so running it neither
+looks the procedure up nor checks the count again.
+ */
+std::shared_ptr<const Chunk> compile(const SyntaxTree & tree, NodeId node);
+
+/*! \fn compile
+\brief lower an expression into bytecode, through its syntax tree
+
+\param exp the expression (abstract syntax tree) to compile
+\return the compiled Chunk
+ */
+std::shared_ptr<const Chunk> compile(const Expression & exp);
+
+/*! \fn compileBody
+\brief lower the body of a lambda made by the tree-walking evaluator
+
+\param lambda the lambda
+\return the compiled Chunk
+
+The parameters of the lambdas the body was nested in are not known here,
+so every call in it is resolved when it runs.
+ */
+std::shared_ptr<const Chunk> compileBody(const Expression & lambda);
+
+#endif
@@ -2,16 +2,18 @@
 
 #include <cassert>
 #include <cmath>
+#include <unordered_set>
 
 #include "environment.hpp"
 #include "semantic_error.hpp"
+#include "vector_math.hpp"
 
 /***********************************************************************
 Helper Functions
 **********************************************************************/
 
 // predicate, the number of args is nargs
-bool nargs_equal(const std::vector<Expression> & args, unsigned nargs){
+bool nargs_equal(Arguments args, unsigned nargs){
   return args.size() == nargs;
 }
 
@@ -21,480 +23,806 @@ bool is_num_type(const Expression & e) {
   return a.isComplex() || a.isNumber();
 }
 
+// check if any argument is a list, so the procedure applies elementwise
+bool has_list_arg(Arguments args){
+  for(auto & a : args){
+    if(a.isList()) return true;
+  }
+  return false;
+}
+
+// the length shared by the list arguments, which must all agree
+std::size_t list_length(Arguments args, const std::string & name){
+  std::size_t n = 0;
+  bool found = false;
+  for(auto & a : args){
+    if(a.isList()){
+      if(found && a.tailLength() != n){
+        throw SemanticError("Error: in call to " + name + ", list arguments differ in length");
+      }
+      n = a.tailLength();
+      found = true;
+    }
+  }
+  return n;
+}
+
+// check every argument is a real number or an unboxed list of them
+bool all_real(Arguments args){
+  for(auto & a : args){
+    if(!a.isRealVector() && !(a.isNone() && a.head().isNumber())) return false;
+  }
+  return true;
+}
+
+// the i-th item of a real vector, or the real number itself
+double real_item(const Expression & e, std::size_t i){
+  return e.isRealVector() ? e.realItems()[i] : e.head().asNumber();
+}
+
+// the real vector or real number e as a kernel operand
+vector_math::Operand operand(const Expression & e){
+  if(e.isRealVector()){
+    return vector_math::array(e.realItems().data());
+  }
+  return vector_math::broadcast(e.head().asNumber());
+}
+
+// apply body to the items of the list arguments one index at a time,
+// passing the other arguments unchanged to every call; each call is
+// checked against signature, as the items were not
+Expression elementwise(Arguments args, ProcedureBody body, const Signature & signature,
+                       const std::string & name){
+  Procedure proc(body, signature);
+  std::size_t n = list_length(args, name);
+  std::vector<Expression> results;
+  results.reserve(n);
+  std::vector<Expression> items(args.size());
+  for(std::size_t i = 0; i < n; ++i){
+    for(std::size_t k = 0; k < args.size(); ++k){
+      items[k] = args[k].isList() ? args[k].item(i) : args[k];
+    }
+    results.push_back(proc(items));
+  }
+  return Expression::packList(std::move(results));
+}
+
+// as elementwise, folding the arguments left with op; when they are all
+// real, in the vector_math kernels without boxing a single item
+Expression elementwise_arithmetic(Arguments args, vector_math::Op op, ProcedureBody body,
+                                  const Signature & signature, const std::string & name){
+  std::size_t n = list_length(args, name);
+  if(!all_real(args)){
+    return elementwise(args, body, signature, name);
+  }
+
+  Expression::Reals result(n, 0.0);
+  double * out = result.mutableData();
+  if(nargs_equal(args, 1)){
+    // a lone argument is negated, inverted, or passed through
+    double identity = (op == vector_math::Op::Add || op == vector_math::Op::Sub) ? 0.0 : 1.0;
+    vector_math::apply(op, vector_math::broadcast(identity), operand(args[0]), out, n);
+  }
+  else{
+    vector_math::apply(op, operand(args[0]), operand(args[1]), out, n);
+    for(std::size_t k = 2; k < args.size(); ++k){
+      vector_math::apply(op, vector_math::array(out), operand(args[k]), out, n);
+    }
+  }
+  return Expression(std::move(result));
+}
+
+// apply f to each item of a list of real numbers, or body to each item of
+// any other list
+Expression elementwise_real(const Expression & list, double (*f)(double), ProcedureBody body,
+                            const Signature & signature, const std::string & name){
+  if(!list.isRealVector()){
+    return elementwise(Arguments(&list, 1), body, signature, name);
+  }
+  const Expression::Reals & items = list.realItems();
+  Expression::Reals result(items.size(), 0.0);
+  double * out = result.mutableData();
+  for(std::size_t i = 0; i < items.size(); ++i){
+    out[i] = f(items[i]);
+  }
+  return Expression(std::move(result));
+}
+
+// the real power, as computed for real arguments by the pow procedure
+double real_pow(double x, double y){
+  return std::pow(std::complex<double>(x), std::complex<double>(y)).real();
+}
+
 /***********************************************************************
-Each of the functions below have the signature that corresponds to the
-typedef'd Procedure function pointer.
+Each of the functions below has the signature of a ProcedureBody, and is
+preceded by the Signature its arguments are checked against before it
+runs (see the BUILTINS table below).
 **********************************************************************/
 
+const Signature DEFAULT_SIGNATURE = {0, Signature::Variadic, AnyArgument, AnyArgument, "", ""};
+
 // the default procedure always returns an expresison of type None
-Expression default_proc(const std::vector<Expression> & args){
+Expression default_proc(Arguments args){
   args.size(); // make compiler happy we used this parameter
   return Expression();
 };
 
-Expression add(const std::vector<Expression> & args){
+/***********************************************************************
+The arithmetic procedures are specialized on the kinds of their arguments:
+all real arguments compute in plain doubles, and only complex arguments
+pay for complex arithmetic. Each specialization performs the same IEEE
+operations on the real parts as complex arithmetic would, so the results
+do not depend on which one runs.
+**********************************************************************/
+
+typedef std::complex<double> Complex;
 
-  std::complex<double> result;
-  bool noComplexArgs = true;
-  // check all aruments are numbers, while adding
-  for( auto & a :args){
+// the value of a number Atom as T, a double or a Complex
+template<typename T> T number_as(const Atom & a);
+
+template<> double number_as<double>(const Atom & a){
+  return a.asNumber();
+}
+
+template<> Complex number_as<Complex>(const Atom & a){
+  return a.asComplex();
+}
+
+// check whether any argument is complex
+bool any_complex(Arguments args){
+  for(auto & a : args){
+    if(a.head().isComplex()) return true;
+  }
+  return false;
+}
+
+// the sum of the arguments accumulated in T, which is Complex if any is;
+// real arguments are added as doubles, leaving the imaginary part alone
+template<typename T>
+Expression sum_as(Arguments args){
+  T result = 0.0;
+  for(auto & a : args){
     if(a.head().isNumber()){
       result += a.head().asNumber();
     }
-    else if(a.head().isComplex()){
-      result += a.head().asComplex();
-      noComplexArgs = false;
+    else{
+      result += number_as<T>(a.head());
+    }
+  }
+  return Expression(result);
+}
+
+// the product of the arguments accumulated in T, as sum_as
+template<typename T>
+Expression product_as(Arguments args){
+  T result = 1.0;
+  for(auto & a : args){
+    if(a.head().isNumber()){
+      result *= a.head().asNumber();
     }
     else{
-        throw SemanticError("Error: in call to add, argument not a number");
+      result *= number_as<T>(a.head());
     }
   }
+  return Expression(result);
+}
 
-  if(noComplexArgs){
-    return Expression(result.real());
+// a - b for a of kind L and b of kind R
+template<typename L, typename R>
+struct Difference {
+  static Expression apply(const Atom & a, const Atom & b){
+    return Expression(number_as<L>(a) - number_as<R>(b));
   }
-  else {
-    return Expression(result);
+};
+
+// std::operator- negates b and adds a when only b is complex, which gives
+// a negative zero imaginary part where complex subtraction gives zero
+template<>
+struct Difference<double, Complex> {
+  static Expression apply(const Atom & a, const Atom & b){
+    return Expression(Complex(a.asNumber()) - b.asComplex());
   }
+};
 
+// a / b for a of kind L and b of kind R
+template<typename L, typename R>
+struct Quotient {
+  static Expression apply(const Atom & a, const Atom & b){
+    return Expression(number_as<L>(a) / number_as<R>(b));
+  }
 };
 
-Expression mul(const std::vector<Expression> & args){
+// a ^ b for a of kind L and b of kind R; any complex argument gives a
+// complex power
+template<typename L, typename R>
+struct Power {
+  static Expression apply(const Atom & a, const Atom & b){
+    return Expression(std::pow(number_as<Complex>(a), number_as<Complex>(b)));
+  }
+};
 
-  // check all aruments are numbers, while multiplying
-  std::complex<double> result = 1.0;
-  bool noComplexArgs = true;
+template<>
+struct Power<double, double> {
+  static Expression apply(const Atom & a, const Atom & b){
+    return Expression(real_pow(a.asNumber(), b.asNumber()));
+  }
+};
 
-  for( auto & a :args){
-    if(a.head().isNumber()) {
-      result *= a.head().asNumber();
-    }
-    else if(a.head().isComplex()){
-      noComplexArgs = false;
-      result *= a.head().asComplex();
-    }
-    else{
-      throw SemanticError("Error: in call to mul, argument not a number");
-    }
+// Op<L, R>::apply(a, b), with L and R the kinds of the numbers a and b
+template<template<typename, typename> class Op>
+Expression by_kind(const Atom & a, const Atom & b){
+  if(a.isNumber()){
+    return b.isNumber() ? Op<double, double>::apply(a, b) : Op<double, Complex>::apply(a, b);
   }
+  return b.isNumber() ? Op<Complex, double>::apply(a, b) : Op<Complex, Complex>::apply(a, b);
+}
 
-  // Return a real number if all arguments are real, otherwise return a complex number
-  if(noComplexArgs){
-    return Expression(result.real());
+const Signature ADD_SIGNATURE = {0, Signature::Variadic,
+  NumberArgument | ListArgument, NumberArgument | ListArgument,
+  "", "Error: in call to add, argument not a number"};
+
+Expression add(Arguments args){
+
+  if(has_list_arg(args)){
+    return elementwise_arithmetic(args, vector_math::Op::Add, add, ADD_SIGNATURE, "add");
   }
-  else {
-    return Expression(result);
+
+  // add in the narrowest kind
+  if(any_complex(args)){
+    return sum_as<Complex>(args);
   }
+  return sum_as<double>(args);
 };
 
-Expression subneg(const std::vector<Expression> & args){
+const Signature MUL_SIGNATURE = {0, Signature::Variadic,
+  NumberArgument | ListArgument, NumberArgument | ListArgument,
+  "", "Error: in call to mul, argument not a number"};
 
-  std::complex<double> result = 0;
+Expression mul(Arguments args){
 
-  // preconditions
-  if(nargs_equal(args,1)){
-    if(args[0].head().isNumber()){
-      result = -args[0].head().asNumber();
-      return Expression(result.real());
-    }
-    else if (args[0].head().isComplex()) {
-      result = -args[0].head().asComplex();
-      return Expression(result);
-    }
-    else {
-      throw SemanticError("Error: in call to negate: invalid argument type.");
-    }
+  if(has_list_arg(args)){
+    return elementwise_arithmetic(args, vector_math::Op::Mul, mul, MUL_SIGNATURE, "mul");
   }
-  else if(nargs_equal(args,2)){
-    if(is_num_type(args[0]) && is_num_type(args[1])){
-      result = args[0].head().asComplex() - args[1].head().asComplex();
-    }
-    else{
-      throw SemanticError("Error: in call to subtraction: invalid argument types.");
-    }
-  }
-  else{
-    throw SemanticError("Error: in call to subtraction or negation: invalid number of arguments.");
+
+  // Return a real number if all arguments are real, otherwise return a complex number
+  if(any_complex(args)){
+    return product_as<Complex>(args);
   }
+  return product_as<double>(args);
+};
 
-  if(args[0].head().isComplex()||args[1].head().isComplex()){
-    return Expression(result);
+const Signature SUBNEG_SIGNATURE = {1, 2,
+  NumberArgument | ListArgument, NumberArgument | ListArgument,
+  "Error: in call to subtraction or negation: invalid number of arguments.",
+  "Error: in call to subtraction or negation: invalid argument types."};
+
+Expression subneg(Arguments args){
+
+  if(has_list_arg(args)){
+    return elementwise_arithmetic(args, vector_math::Op::Sub, subneg, SUBNEG_SIGNATURE, "subtraction");
   }
-  else {
-    return Expression(result.real());
+
+  if(nargs_equal(args,1)){
+    if(args[0].head().isNumber()){
+      return Expression(-args[0].head().asNumber());
+    }
+    return Expression(-args[0].head().asComplex());
   }
+  return by_kind<Difference>(args[0].head(), args[1].head());
 };
 
-Expression div(const std::vector<Expression> & args) {
+const Signature DIV_SIGNATURE = {1, 2,
+  NumberArgument | ListArgument, NumberArgument | ListArgument,
+  "Error: in call to division, too many arguments",
+  "Error: in call to division, argument not a number"};
 
-  std::complex<double> result;
-  bool noComplexArgs = true;
+Expression div(Arguments args) {
+
+  if(has_list_arg(args)){
+    return elementwise_arithmetic(args, vector_math::Op::Div, div, DIV_SIGNATURE, "division");
+  }
 
   if(nargs_equal(args,1)){
-	  if (args[0].head().isComplex())
-		  noComplexArgs = false;
-	  result = std::complex<double>(1.0,0) / args[0].head().asComplex();
-  }
-  else if (nargs_equal(args, 2)){
-	  if(is_num_type(args[0]))
-		  result = args[0].head().asComplex() * args[0].head().asComplex();
-	  for (auto & a : args) {
-		  if (a.head().isNumber()) {
-			  result /= a.head().asNumber();
-		  }
-		  else if (a.head().isComplex()) {
-			  noComplexArgs = false;
-			  result /= a.head().asComplex();
-		  }
-		  else {
-			  throw SemanticError("Error: in call to division, argument not a number");
-		  }
-	  }
-  }
-  else {
-    throw SemanticError("Error: in call to division, too many arguments");
-  }
-
-  if (noComplexArgs) {
-	  return Expression(result.real());
-  }
-  else {
-	  return Expression(result);
-  }
-};
-
-Expression sqrt(const std::vector<Expression> & args) {
-	double result = 0;
-  std::complex<double> cresult;
-
-	if (nargs_equal(args, 1)) {
-		if (args[0].head().isNumber() && args[0].head().asNumber() >= 0) {
-			result = std::sqrt(args[0].head().asNumber());
-      return Expression(result);
-		}
-		else if(args[0].head().isComplex() || args[0].head().asNumber() < 0){
-			cresult = std::sqrt(std::complex<double>(args[0].head().asComplex()));
-      return Expression(cresult);
-		}
-    else {
-      throw SemanticError("Error: in call to division: invalid argument(s)");
+    if (args[0].head().isNumber()) {
+      return Expression(1.0 / args[0].head().asNumber());
     }
-	}
-	else {
-		throw SemanticError("Error: in call to division: invalid number of arguments.");
-	}
+    return Expression(Complex(1.0,0) / args[0].head().asComplex());
+  }
+  return by_kind<Quotient>(args[0].head(), args[1].head());
+};
+
+const Signature SQRT_SIGNATURE = {1, 1, NumberArgument, NumberArgument,
+  "Error: in call to sqrt: invalid number of arguments.",
+  "Error: in call to sqrt: invalid argument(s)"};
+
+Expression sqrt(Arguments args) {
+
+  if (args[0].head().isNumber() && args[0].head().asNumber() >= 0) {
+    return Expression(std::sqrt(args[0].head().asNumber()));
+  }
+  return Expression(std::sqrt(args[0].head().asComplex()));
 };
 
-Expression pow(const std::vector<Expression> & args) {
+const Signature POW_SIGNATURE = {2, 2,
+  NumberArgument | ListArgument, NumberArgument | ListArgument,
+  "Error: in call to power function: invalid number of arguments.",
+  "Error: in call to power function: invalid argument."};
 
-	std::complex<double> result(0,0);
+Expression pow(Arguments args) {
 
-	if (nargs_equal(args, 2)) {
-		if(is_num_type(args[0]) && is_num_type(args[1])) {
-			result = std::pow(args[0].head().asComplex(), args[1].head().asComplex());
+	if (has_list_arg(args)) {
+		if (!all_real(args)) {
+			return elementwise(args, pow, POW_SIGNATURE, "power function");
 		}
-		else {
-			throw SemanticError("Error: in call to power function: invalid argument.");
+		std::size_t n = list_length(args, "power function");
+		Expression::Reals result(n, 0.0);
+		double * out = result.mutableData();
+		for (std::size_t i = 0; i < n; ++i) {
+			out[i] = real_pow(real_item(args[0], i), real_item(args[1], i));
 		}
-	}
-	else {
-		throw SemanticError("Error: in call to power function: invalid number of arguments.");
+		return Expression(std::move(result));
 	}
 
-	if(args[0].head().isComplex()||args[1].head().isComplex()){
-    return Expression(result);
-  }
-  else {
-    return Expression(result.real());
-  }
+	return by_kind<Power>(args[0].head(), args[1].head());
 };
 
-Expression ln(const std::vector<Expression> & args) {
-    double result = 0;
+const Signature LN_SIGNATURE = {1, 1,
+  RealArgument | ListArgument, RealArgument | ListArgument,
+  "Error: in call to ln: invalid number of arguments.",
+  "Error: in call to ln: invalid argument."};
 
-    if (nargs_equal(args, 1)) {
-        if (args[0].head().isNumber() && args[0].head().asNumber() > 0) {
-            result = std::log(args[0].head().asNumber());
-        }
-        else {
-            throw SemanticError("Error: in call to ln: invalid argument.");
+Expression ln(Arguments args) {
+
+    if (args[0].isList()) {
+        for (double x : args[0].realItems()) {
+            if (!(x > 0)) {
+                throw SemanticError(LN_SIGNATURE.kindError);
+            }
         }
+        return elementwise_real(args[0], [](double x){ return std::log(x); }, ln, LN_SIGNATURE, "ln");
     }
-    else {
-        throw SemanticError("Error: in call to ln: invalid number of arguments.");
+
+    if (!(args[0].head().asNumber() > 0)) {
+        throw SemanticError(LN_SIGNATURE.kindError);
     }
-    return Expression(result);
+    return Expression(std::log(args[0].head().asNumber()));
 };
 
-Expression sin(const std::vector<Expression> & args) {
-    double result = 0;
+const Signature SIN_SIGNATURE = {1, 1,
+  RealArgument | ListArgument, RealArgument | ListArgument,
+  "Error: in call to sin: invalid number of arguments.",
+  "Error: in call to sin: invalid argument."};
 
-    if (nargs_equal(args, 1)) {
-        if (args[0].head().isNumber()) {
-            result = std::sin(args[0].head().asNumber());
-        }
-        else {
-            throw SemanticError("Error: in call to sin: invalid argument.");
-        }
-    }
-    else {
-        throw SemanticError("Error: in call to sin: invalid number of arguments.");
+Expression sin(Arguments args) {
+
+    if (args[0].isList()) {
+        return elementwise_real(args[0], [](double x){ return std::sin(x); }, sin, SIN_SIGNATURE, "sin");
     }
-    return Expression(result);
+    return Expression(std::sin(args[0].head().asNumber()));
 };
 
-Expression cos(const std::vector<Expression> & args) {
-    double result = 0;
+const Signature COS_SIGNATURE = {1, 1,
+  RealArgument | ListArgument, RealArgument | ListArgument,
+  "Error: in call to cos: invalid number of arguments.",
+  "Error: in call to cos: invalid argument."};
 
-    if (nargs_equal(args, 1)) {
-        if (args[0].head().isNumber()) {
-            result = std::cos(args[0].head().asNumber());
-        }
-        else {
-            throw SemanticError("Error: in call to cos: invalid argument.");
-        }
-    }
-    else {
-        throw SemanticError("Error: in call to cos: invalid number of arguments.");
+Expression cos(Arguments args) {
+
+    if (args[0].isList()) {
+        return elementwise_real(args[0], [](double x){ return std::cos(x); }, cos, COS_SIGNATURE, "cos");
     }
-    return Expression(result);
+    return Expression(std::cos(args[0].head().asNumber()));
 };
 
-Expression tan(const std::vector<Expression> & args) {
-    double result = 0;
+const Signature TAN_SIGNATURE = {1, 1,
+  RealArgument | ListArgument, RealArgument | ListArgument,
+  "Error: in call to tan: invalid number of arguments.",
+  "Error: in call to tan: invalid argument."};
 
-    if (nargs_equal(args, 1)) {
-        if (args[0].head().isNumber()) {
-            result = std::tan(args[0].head().asNumber());
-        }
-        else {
-            throw SemanticError("Error: in call to tan: negative argument.");
-        }
-    }
-    else {
-        throw SemanticError("Error: in call to tan: invalid number of arguments.");
+Expression tan(Arguments args) {
+
+    if (args[0].isList()) {
+        return elementwise_real(args[0], [](double x){ return std::tan(x); }, tan, TAN_SIGNATURE, "tan");
     }
-    return Expression(result);
+    return Expression(std::tan(args[0].head().asNumber()));
 };
 
-Expression real(const std::vector<Expression> & args) {
-  double result = 0;
+const Signature REAL_SIGNATURE = {1, 1, ComplexArgument, ComplexArgument,
+  "Error: in call to real: invalid number of arguments.",
+  "Error: in call to real: not a complex argument."};
 
-  if(nargs_equal(args, 1)) {
-    if (args[0].head().isComplex()) {
-      result = args[0].head().asComplex().real();
-    }
-    else {
-      throw SemanticError("Error: in call to real: not a complex argument.");
-    }
+Expression real(Arguments args) {
+  return Expression(args[0].head().asComplex().real());
+};
+
+const Signature IMAG_SIGNATURE = {1, 1, ComplexArgument, ComplexArgument,
+  "Error: in call to imag: invalid number of arguments.",
+  "Error: in call to imag: not a complex argument."};
+
+Expression imag(Arguments args) {
+  return Expression(args[0].head().asComplex().imag());
+};
+
+const Signature MAG_SIGNATURE = {1, 1, ComplexArgument, ComplexArgument,
+  "Error: in call to mag: invalid number of arguments.",
+  "Error: in call to mag: not a complex argument."};
+
+Expression mag(Arguments args) {
+  return Expression(std::abs(args[0].head().asComplex()));
+};
+
+const Signature ARG_SIGNATURE = {1, 1, ComplexArgument, ComplexArgument,
+  "Error: in call to arg: invalid number of arguments.",
+  "Error: in call to arg: not a complex argument."};
+
+Expression arg(Arguments args) {
+  return Expression(std::arg(args[0].head().asComplex()));
+};
+
+const Signature CONJ_SIGNATURE = {1, 1, ComplexArgument, ComplexArgument,
+  "Error: in call to conj: invalid number of arguments.",
+  "Error: in call to conj: not a complex argument."};
+
+Expression conj(Arguments args) {
+  return Expression(std::conj(args[0].head().asComplex()));
+};
+
+const Signature LIST_SIGNATURE = {0, Signature::Variadic, AnyArgument, AnyArgument, "", ""};
+
+Expression list(Arguments args) {
+	return Expression::packList(std::vector<Expression>(args.begin(), args.end()));
+};
+
+const Signature FIRST_SIGNATURE = {1, 1, ListArgument, ListArgument,
+  "Error: more than one argument in call to first.",
+  "Error: argument to first is not a list."};
+
+Expression first(Arguments args) {
+
+  if (args[0].tailLength() == 0) {
+    throw SemanticError("Error: argument to first is an empty list.");
   }
-  else {
-    throw SemanticError("Error: in call to real: invalid number of arguments.");
+  return args[0].item(0);
+};
+
+const Signature REST_SIGNATURE = {1, 1, ListArgument, ListArgument,
+  "Error: in call to rest: invalid number of arguments.",
+  "Error: in call to rest: not a list argument."};
+
+Expression rest(Arguments args) {
+
+  if(args[0].tailLength() == 0) {
+    throw SemanticError("Error: argument to rest is an empty list.");
   }
+  return args[0].listRest();
+};
 
-  return Expression(result);
+const Signature LENGTH_SIGNATURE = {1, 1, ListArgument, ListArgument,
+  "Error: invalid number of arguments for length.",
+  "Error: argument to length is not a list."};
+
+Expression length(Arguments args) {
+  return Expression(static_cast<double>(args[0].tailLength()));
 };
 
-Expression imag(const std::vector<Expression> & args) {
-  double result;
+const Signature APPEND_SIGNATURE = {2, 2, ListArgument, AnyArgument,
+  "Error: invalid number of arguments for append.",
+  "Error: first argument not a list."};
 
-  if(nargs_equal(args, 1)) {
-    if (args[0].head().isComplex()) {
-      result = args[0].head().asComplex().imag();
-    }
-    else {
-      throw SemanticError("Error: in call to imag: not a complex argument.");
+Expression append(Arguments args) {
+  return args[0].listAppend(args[1]);
+};
+
+const Signature JOIN_SIGNATURE = {2, 2, ListArgument, ListArgument,
+  "Error: invalid number of arguments to join.",
+  "Error: an argument to join not a list."};
+
+Expression join(Arguments args) {
+  return args[0].listJoin(args[1]);
+};
+
+const Signature RANGE_SIGNATURE = {2, 3, RealArgument, RealArgument,
+  "Error: invalid number of arguments for range function.",
+  "Error: an argument is not a number."};
+
+Expression range(Arguments args) {
+
+  double start = args[0].head().asNumber();
+  double stop = args[1].head().asNumber();
+  double step = nargs_equal(args, 3) ? args[2].head().asNumber() : 1.0;
+
+  if (start > stop)
+    throw SemanticError("Error: begin greater than end in range");
+  if (step <= 0)
+    throw SemanticError("Error: negative or zero increment in range");
+
+  std::vector<double> result;
+  result.reserve(static_cast<std::size_t>((stop - start) / step) + 1);
+  for(double i = start; i <= stop; i += step) {
+    result.push_back(i);
+  } 
+  return Expression(Expression::Reals(std::move(result)));
+};
+
+// the items of a list of real numbers as contiguous doubles: those of an
+// unboxed list in place, any other list's copied into scratch
+const double * real_items(const Expression & list, std::vector<double> & scratch,
+                          const std::string & name){
+  if(list.isRealVector()){
+    return list.realItems().data();
+  }
+  scratch.clear();
+  scratch.reserve(list.tailLength());
+  for(std::size_t i = 0; i < list.tailLength(); ++i){
+    Expression item = list.item(i);
+    if(!item.isNone() || !item.head().isNumber()){
+      throw SemanticError("Error: in call to " + name + ": argument not a list of real numbers.");
     }
+    scratch.push_back(item.head().asNumber());
   }
-  else {
-    throw SemanticError("Error: in call to imag: invalid number of arguments.");
+  return scratch.data();
+}
+
+// the items of a non-empty list of real numbers, as real_items
+const double * nonempty_real_items(const Expression & list, std::vector<double> & scratch,
+                                   const std::string & name){
+  if(list.tailLength() == 0){
+    throw SemanticError("Error: in call to " + name + ": empty list.");
   }
+  return real_items(list, scratch, name);
+}
 
-  return Expression(result);
-};
+// the sum of a list of numbers, real unless an item is complex; lists that
+// are not unboxed reals are added with Kahan compensation
+Expression list_sum(const Expression & list, const std::string & name){
 
-Expression mag(const std::vector<Expression> & args) {
-  double result = 0;
+  if(list.isRealVector()){
+    return Expression(vector_math::sum(list.realItems().data(), list.tailLength()));
+  }
 
-  if(nargs_equal(args, 1)) {
-    if (args[0].head().isComplex()) {
-      std::complex<double> n = args[0].head().asComplex();
-      result = std::abs(n);
-    }
-    else {
-      throw SemanticError("Error: in call to mag: not a complex argument.");
+  std::complex<double> total = 0, compensation = 0;
+  bool noComplexArgs = true;
+  for(std::size_t i = 0; i < list.tailLength(); ++i){
+    Expression item = list.item(i);
+    if(!item.isNone() || !is_num_type(item)){
+      throw SemanticError("Error: in call to " + name + ": argument not a list of numbers.");
     }
+    noComplexArgs = noComplexArgs && item.head().isNumber();
+    std::complex<double> y = item.head().asComplex() - compensation;
+    std::complex<double> t = total + y;
+    compensation = (t - total) - y;
+    total = t;
   }
-  else {
-    throw SemanticError("Error: in call to mag: invalid number of arguments.");
-  }
+  return noComplexArgs ? Expression(total.real()) : Expression(total);
+}
 
-  return Expression(result);
+// every reduction takes a single list
+#define REDUCTION_SIGNATURE(name) {1, 1, ListArgument, ListArgument, \
+    "Error: in call to " name ": invalid number of arguments.",        \
+    "Error: in call to " name ": argument is not a list."}
+
+const Signature SUM_SIGNATURE = REDUCTION_SIGNATURE("sum");
+
+Expression sum(Arguments args) {
+  return list_sum(args[0], "sum");
 };
 
-Expression arg(const std::vector<Expression> & args) {
-  double result = 0;
+const Signature PROD_SIGNATURE = REDUCTION_SIGNATURE("prod");
 
-  if(nargs_equal(args, 1)) {
-    if (args[0].head().isComplex()) {
-      std::complex<double> n = args[0].head().asComplex();
-      result = std::arg(n);
-    }
-    else {
-      throw SemanticError("Error: in call to arg: not a complex argument.");
+Expression prod(Arguments args) {
+  const Expression & list = args[0];
+
+  if(list.isRealVector()){
+    double result = 1.0;
+    for(double x : list.realItems()){
+      result *= x;
     }
+    return Expression(result);
   }
-  else {
-    throw SemanticError("Error: in call to arg: invalid number of arguments.");
+
+  std::complex<double> result = 1.0;
+  bool noComplexArgs = true;
+  for(std::size_t i = 0; i < list.tailLength(); ++i){
+    Expression item = list.item(i);
+    if(!item.isNone() || !is_num_type(item)){
+      throw SemanticError("Error: in call to prod: argument not a list of numbers.");
+    }
+    noComplexArgs = noComplexArgs && item.head().isNumber();
+    result *= item.head().asComplex();
   }
-  return Expression(result);
+  return noComplexArgs ? Expression(result.real()) : Expression(result);
 };
 
-Expression conj(const std::vector<Expression> & args) {
-  std::complex<double> result = 0;
+const Signature MEAN_SIGNATURE = REDUCTION_SIGNATURE("mean");
 
-  if(nargs_equal(args, 1)) {
-    if (args[0].head().isComplex()) {
-      std::complex<double> n = args[0].head().asComplex();
-      result = std::conj(n);
-    }
-    else {
-      throw SemanticError("Error: in call to conj: not a complex argument.");
-    }
+Expression mean(Arguments args) {
+  const Expression & list = args[0];
+  if(list.tailLength() == 0){
+    throw SemanticError("Error: in call to mean: empty list.");
   }
-  else {
-    throw SemanticError("Error: in call to conj: invalid number of arguments.");
+
+  Expression total = list_sum(list, "mean");
+  double n = static_cast<double>(list.tailLength());
+  if(total.head().isComplex()){
+    return Expression(total.head().asComplex() / n);
   }
-  return Expression(result);
+  return Expression(total.head().asNumber() / n);
 };
 
-Expression list(const std::vector<Expression> & args) {
-	std::vector<Expression> result = args;
-	return Expression(result);
+const Signature VARIANCE_SIGNATURE = REDUCTION_SIGNATURE("variance");
+
+Expression variance(Arguments args) {
+  std::vector<double> scratch;
+  const double * data = nonempty_real_items(args[0], scratch, "variance");
+
+  // the population variance
+  vector_math::Moments m = vector_math::moments(data, args[0].tailLength());
+  return Expression(m.m2 / m.count);
 };
 
-Expression first(const std::vector<Expression> & args) {
+const Signature MIN_SIGNATURE = REDUCTION_SIGNATURE("min");
 
-	if (nargs_equal(args, 1)) {
-		if(args[0].isList()) {
-			if (args[0].tailLength() > 0) {
-				Expression result = *args[0].tailConstBegin();
-				return Expression(result);
-			}
-			else
-				throw SemanticError("Error: argument to first is an empty list.");
-		}
-		else
-			throw SemanticError("Error: argument to first is not a list.");
-	}
-	else {
-		throw SemanticError("Error: more than one argument in call to first.");
-	}
+Expression min(Arguments args) {
+  std::vector<double> scratch;
+  const double * data = nonempty_real_items(args[0], scratch, "min");
+  return Expression(data[vector_math::argmin(data, args[0].tailLength())]);
 };
 
-Expression rest(const std::vector<Expression> & args) {
-  if(nargs_equal(args, 1)) {
-    if(!args[0].isList())
-      throw SemanticError("Error: in call to rest: not a list argument.");
-    else {
-      if(args[0].tailLength() > 0) {
-        std::vector<Expression> result;
-        auto e = args[0].tailConstBegin();
-        e++;
-        while(e != args[0].tailConstEnd()){
-          result.emplace_back(*e++);
-        }
-        return Expression(result);
-      }
-      else
-        throw SemanticError("Error: argument to rest is an empty list.");
-    }
-  }
-    else
-      throw SemanticError("Error: in call to rest: invalid number of arguments.");
+const Signature MAX_SIGNATURE = REDUCTION_SIGNATURE("max");
+
+Expression max(Arguments args) {
+  std::vector<double> scratch;
+  const double * data = nonempty_real_items(args[0], scratch, "max");
+  return Expression(data[vector_math::argmax(data, args[0].tailLength())]);
 };
 
-Expression length(const std::vector<Expression> & args) {
-  if(nargs_equal(args, 1)) {
-    if(!args[0].isList())
-      throw SemanticError("Error: argument to length is not a list.");
-    else {
-        double len = (double)args[0].tailLength();
-        return Expression(len);
-      }
-  }
-  else
-    throw SemanticError("Error: invalid number of arguments for length.");
+const Signature ARGMIN_SIGNATURE = REDUCTION_SIGNATURE("argmin");
+
+Expression argmin(Arguments args) {
+  std::vector<double> scratch;
+  const double * data = nonempty_real_items(args[0], scratch, "argmin");
+  return Expression(static_cast<double>(vector_math::argmin(data, args[0].tailLength())));
 };
 
-Expression append(const std::vector<Expression> & args) {
-  if(nargs_equal(args, 2)) {
-    if(!args[0].isList())
-      throw SemanticError("Error: first argument not a list.");
-    else {
-      std::vector<Expression> result;
-      for(auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); e++){
-        result.emplace_back(*e);
-      }
-      result.emplace_back(args[1]);
-      return Expression(result);
-    }
-  }
-  else
-    throw SemanticError("Error: invalid number of arguments for append.");
+const Signature ARGMAX_SIGNATURE = REDUCTION_SIGNATURE("argmax");
+
+Expression argmax(Arguments args) {
+  std::vector<double> scratch;
+  const double * data = nonempty_real_items(args[0], scratch, "argmax");
+  return Expression(static_cast<double>(vector_math::argmax(data, args[0].tailLength())));
 };
 
-Expression join(const std::vector<Expression> & args) {
-  if(nargs_equal(args, 2)) {
-    if(!args[0].isList() || !args[1].isList())
-      throw SemanticError("Error: an argument to join not a list.");
-    else {
-      std::vector<Expression> result;
-      for(auto e = args[0].tailConstBegin(); e != args[0].tailConstEnd(); e++){
-        result.emplace_back(*e);
-      }
-      for(auto e = args[1].tailConstBegin(); e != args[1].tailConstEnd(); e++){
-        result.emplace_back(*e);
-      }
-      return Expression(result);
-    }
-  }
-  else
-    throw SemanticError("Error: invalid number of arguments to join.");
+#undef REDUCTION_SIGNATURE
+
+// the graphics constructors accept what the startup.pls lambdas they
+// replace accepted, building an untyped graphic from any other arguments
+
+const Signature MAKE_POINT_SIGNATURE = {2, 2, AnyArgument, AnyArgument,
+  "Error: invalid number of arguments to make-point.",
+  ""};
+
+Expression make_point(Arguments args) {
+  return Expression::makePoint(args[0], args[1]);
+}
+
+const Signature MAKE_LINE_SIGNATURE = {2, 2, AnyArgument, AnyArgument,
+  "Error: invalid number of arguments to make-line.",
+  ""};
+
+Expression make_line(Arguments args) {
+  return Expression::makeLine(args[0], args[1]);
+}
+
+const Signature MAKE_TEXT_SIGNATURE = {1, 1, AnyArgument, AnyArgument,
+  "Error: invalid number of arguments to make-text.",
+  ""};
+
+Expression make_text(Arguments args) {
+  return Expression::makeText(args[0]);
+}
+
+/***********************************************************************
+The registry of built-in procedures: each name with its body and the
+signature its arguments are checked against.
+**********************************************************************/
+
+struct Builtin {
+  const char * name;
+  ProcedureBody body;
+  const Signature & signature;
+};
+
+const Builtin BUILTINS[] = {
+  {"+", add, ADD_SIGNATURE},
+  {"-", subneg, SUBNEG_SIGNATURE},
+  {"*", mul, MUL_SIGNATURE},
+  {"/", div, DIV_SIGNATURE},
+  {"sqrt", sqrt, SQRT_SIGNATURE},
+  {"^", pow, POW_SIGNATURE},
+  {"ln", ln, LN_SIGNATURE},
+  {"sin", sin, SIN_SIGNATURE},
+  {"cos", cos, COS_SIGNATURE},
+  {"tan", tan, TAN_SIGNATURE},
+  {"real", real, REAL_SIGNATURE},
+  {"imag", imag, IMAG_SIGNATURE},
+  {"mag", mag, MAG_SIGNATURE},
+  {"arg", arg, ARG_SIGNATURE},
+  {"conj", conj, CONJ_SIGNATURE},
+  {"list", list, LIST_SIGNATURE},
+  {"first", first, FIRST_SIGNATURE},
+  {"rest", rest, REST_SIGNATURE},
+  {"length", length, LENGTH_SIGNATURE},
+  {"append", append, APPEND_SIGNATURE},
+  {"join", join, JOIN_SIGNATURE},
+  {"range", range, RANGE_SIGNATURE},
+};
+
+// the procedures programs may redefine: those startup.pls used to define,
+// and the reductions, whose names programs commonly use for their own values
+const Builtin LIBRARY_BUILTINS[] = {
+  {"make-point", make_point, MAKE_POINT_SIGNATURE},
+  {"make-line", make_line, MAKE_LINE_SIGNATURE},
+  {"make-text", make_text, MAKE_TEXT_SIGNATURE},
+  {"sum", sum, SUM_SIGNATURE},
+  {"prod", prod, PROD_SIGNATURE},
+  {"mean", mean, MEAN_SIGNATURE},
+  {"variance", variance, VARIANCE_SIGNATURE},
+  {"min", min, MIN_SIGNATURE},
+  {"max", max, MAX_SIGNATURE},
+  {"argmin", argmin, ARGMIN_SIGNATURE},
+  {"argmax", argmax, ARGMAX_SIGNATURE},
 };
 
-Expression range(const std::vector<Expression> & args) {
+ArgumentKind argumentKind(const Expression & e) noexcept {
+  if(e.isList()) return ListArgument;
+  if(e.head().isNumber()) return RealArgument;
+  if(e.head().isComplex()) return ComplexArgument;
+  return OtherArgument;
+}
+
+const std::size_t Signature::Variadic;
+
+bool builtinProcedure(const Atom & sym, Procedure & proc){
 
-  for (auto &arg: args) {
-    if (!arg.head().isNumber()) {
-      throw SemanticError("Error: an argument is not a number.");
+  // built once, from the same table reset() binds
+  static const std::unordered_map<SymbolId, Procedure> fixed = [](){
+    std::unordered_map<SymbolId, Procedure> procedures;
+    for(const Builtin & builtin : BUILTINS){
+      procedures.emplace(SymbolTable::intern(builtin.name), Procedure(builtin.body, builtin.signature));
     }
+    return procedures;
+  }();
+
+  if(!sym.isSymbol()){
+    return false;
   }
-  if (args[0].head().asNumber() > args[1].head().asNumber())
-    throw SemanticError("Error: begin greater than end in range");
+  auto found = fixed.find(sym.symbolId());
+  if(found == fixed.end()){
+    return false;
+  }
+  proc = found->second;
+  return true;
+}
 
-  std::vector<Expression> result;
-  double start, stop, step;
-  start = args[0].head().asNumber();
-  stop = args[1].head().asNumber();
+void Signature::check(Arguments args) const {
 
-  if(nargs_equal(args, 3)) {
-    if (args[2].head().asNumber() <= 0)
-      throw SemanticError("Error: negative or zero increment in range");
-    step = args[2].head().asNumber();
-  }
-  else if (!nargs_equal(args, 2)) {
-    throw SemanticError("Error: invalid number of arguments for range function.");
+  if(!accepts(args.size())){
+    throw SemanticError(arityError);
   }
-  else {
-    step = 1.0;
+  checkKinds(args);
+}
+
+void Signature::checkKinds(Arguments args) const {
+
+  for(std::size_t i = 0; i < args.size(); ++i){
+    std::uint8_t accepted = (i == 0) ? firstKinds : restKinds;
+    if(!(argumentKind(args[i]) & accepted)){
+      throw SemanticError(kindError);
+    }
   }
+}
 
-  for(double i = start; i <= stop; i += step) {
-    result.push_back(Expression(Atom(i)));
-  } 
-  return Expression(result);
-};
+Procedure::Procedure() noexcept: m_body(default_proc), m_signature(&DEFAULT_SIGNATURE), m_redefinable(false) {}
 
 const double PI = std::atan2(0, -1);
 const double EXP = std::exp(1);
@@ -506,170 +834,260 @@ Environment::Environment(){
   reset();
 }
 
-Environment & Environment::operator=(const Environment & a){
+Environment::Environment(std::shared_ptr<Frame> frame, std::shared_ptr<Frame> global):
+  m_frame(std::move(frame)), m_global(std::move(global)) {}
 
-  envmap = a.envmap;
-  return *this;
+std::shared_ptr<Environment::Frame> Environment::copyFrames(const Frame & frame){
+
+  auto result = std::make_shared<Frame>(frame);
+  result->captured = false;
+  if(frame.parent){
+    result->parent = copyFrames(*frame.parent);
+  }
+  return result;
 }
 
-bool Environment::is_known(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
+Environment::Environment(const Environment & a): m_frame(copyFrames(*a.m_frame)) {
 
-  return envmap.find(sym.asString()) != envmap.end();
+  if(a.m_global == a.m_frame){
+    m_global = m_frame;
+  }
+  else if(a.m_global){
+    m_global = copyFrames(*a.m_global);
+  }
 }
 
-void Environment::__shadowing_helper(const Atom & sym, const Expression & new_sym_val){
+Environment & Environment::operator=(const Environment & a){
 
-  if(this->envmap.find(sym.asString()) != this->envmap.end()){
-    this->envmap.erase(sym.asString());
+  if(this != &a){
+    Environment copy(a);
+    m_frame = std::move(copy.m_frame);
+    m_global = std::move(copy.m_global);
   }
-  this->add_exp(sym, new_sym_val);
- }
+  return *this;
+}
 
-bool Environment::is_exp(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
+const Environment::EnvResult * Environment::Frame::find(SymbolId id) const{
 
-  auto result = envmap.find(sym.asString());
-  return (result != envmap.end()) && (result->second.type == ExpressionType);
-}
+  for(auto & binding : locals){
+    if(binding.first == id) return &binding.second;
+  }
 
-Expression Environment::evaluate_an_exp(Expression & e){
-  return e.eval(*this);
-}
+  if(!globals.empty()){
+    auto result = globals.find(id);
+    if(result != globals.end()) return &result->second;
+  }
 
-Expression Environment::get_exp(const Atom & sym) const{
+  return nullptr;
+}
 
-  Expression exp;
+void Environment::Frame::bind(SymbolId id, const EnvResult & value){
 
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asString());
-    if((result != envmap.end()) && (result->second.type == ExpressionType)){
-      exp = result->second.exp;
+  if(!global){
+    for(auto & binding : locals){
+      if(binding.first == id){
+        binding.second = value;
+        return;
+      }
     }
+    locals.emplace_back(id, value);
   }
+  else{
+    globals.erase(id);
+    globals.emplace(id, value);
+  }
+}
 
-  return exp;
+const Environment::EnvResult * Environment::lookup(const Atom & sym) const{
+  if(!sym.isSymbol()) return nullptr;
+
+  // a closure's frames are kept by a global frame while it looks in them
+  const Frame * first = m_frame ? m_frame.get() : m_captured.lock().get();
+  for(const Frame * frame = first; frame != nullptr; frame = frame->parent.get()){
+    const EnvResult * result = frame->find(sym.symbolId());
+    if(result) return result;
+  }
+  if(m_global && m_global != m_frame){
+    return m_global->find(sym.symbolId());
+  }
+
+  return nullptr;
 }
 
-void Environment::add_exp(const Atom & sym, const Expression & exp){
+void Environment::collect(const Expression & result){
 
-    if(!sym.isSymbol()){
-        throw SemanticError("Error: during add_exp: Attempt to add non-symbol to environment");
-    }
+  Frame & global = *m_global;
+  if(global.captures.size() <= 2 * global.kept){
+    return;
+  }
 
-    // error if overwriting symbol map
-    if(envmap.find(sym.asString()) != envmap.end()){
-        envmap.erase(sym.asString());
+  // mark the call frames that lambdas reachable from the globals and the
+  // result close over, and the frames those link to, following the
+  // bindings of each marked frame in turn
+  std::unordered_set<const Frame *> live;
+  std::unordered_set<const void *> seen;
+  std::vector<const Environment *> closures;
+
+  result.findClosures(closures, seen);
+  for(auto & binding : global.globals){
+    if(binding.second.type == ExpressionType){
+      binding.second.exp.findClosures(closures, seen);
+    }
+  }
+  while(!closures.empty()){
+    std::shared_ptr<Frame> frame = closures.back()->m_captured.lock();
+    closures.pop_back();
+    for(const Frame * f = frame.get(); f && live.insert(f).second; f = f->parent.get()){
+      for(auto & binding : f->locals){
+        if(binding.second.type == ExpressionType){
+          binding.second.exp.findClosures(closures, seen);
+        }
+      }
     }
+  }
 
-    envmap.emplace(sym.asString(), EnvResult(ExpressionType, exp));
+  // the frames left unmarked go when nothing else holds them; moving them
+  // out first keeps the list whole while their bindings are released
+  std::vector<std::shared_ptr<Frame>> kept, dropped;
+  for(auto & frame : global.captures){
+    (live.count(frame.get()) ? kept : dropped).push_back(std::move(frame));
+  }
+  global.captures = std::move(kept);
+  global.kept = global.captures.size();
+  dropped.clear();
 }
 
-bool Environment::is_proc(const Atom & sym) const{
-  if(!sym.isSymbol()) return false;
+Environment Environment::callScope(const Environment * closure) const{
 
-  auto result = envmap.find(sym.asString());
-  return (result != envmap.end()) && (result->second.type == ProcedureType);
+  auto frame = std::make_shared<Frame>();
+  if(closure){
+    frame->parent = closure->m_frame ? closure->m_frame : closure->m_captured.lock();
+    if(!frame->parent){
+      throw SemanticError("Error: during apply: the scope the lambda was defined in no longer exists.");
+    }
+  }
+
+  return Environment(std::move(frame), m_global);
 }
 
-Procedure Environment::get_proc(const Atom & sym) const{
+std::shared_ptr<const Environment> Environment::capture() const{
 
-  Procedure proc = default_proc;
+  if(isGlobal()) return nullptr;
 
-  if(sym.isSymbol()){
-    auto result = envmap.find(sym.asString());
-    if((result != envmap.end()) && (result->second.type == ProcedureType)){
-      return result->second.proc;
-    }
+  // the global frame owns the frames, the closure only refers to them
+  if(!m_frame->captured){
+    m_frame->captured = true;
+    m_global->captures.push_back(m_frame);
   }
+  std::shared_ptr<Environment> closure(new Environment(nullptr, nullptr));
+  closure->m_captured = m_frame;
+  return closure;
+}
 
-  return default_proc;
+bool Environment::isGlobal() const noexcept{
+  return m_frame && m_frame == m_global;
 }
 
-/*
-Reset the environment to the default state. First remove all entries and
-then re-add the default ones.
- */
-void Environment::reset(){
+bool Environment::is_known(const Atom & sym) const{
 
-  envmap.clear();
+  return lookup(sym) != nullptr;
+}
 
-  // Built-In value of pi
-  envmap.emplace("pi", EnvResult(ExpressionType, Expression(PI)));
+bool Environment::is_exp(const Atom & sym) const{
 
-  // Built-In value of e
-  envmap.emplace("e", EnvResult(ExpressionType, Expression(EXP)));
+  const EnvResult * result = lookup(sym);
+  return result && (result->type == ExpressionType);
+}
 
-  // Built-In value of i
-  envmap.emplace("I", EnvResult(ExpressionType, Expression(IMG)));
+void Environment::__shadowing_helper(const Atom & sym, const Expression & new_sym_val){
+  add_exp(sym, new_sym_val);
+}
 
-  // Built-In value of -i
-  envmap.emplace("-I", EnvResult(ExpressionType, Expression(NEG_IMG)));
+Expression Environment::evaluate_an_exp(Expression & e){
+  return e.eval(*this);
+}
 
-  // Procedure: add;
-  envmap.emplace("+", EnvResult(ProcedureType, add));
+Expression Environment::get_exp(const Atom & sym) const{
 
-  // Procedure: subneg;
-  envmap.emplace("-", EnvResult(ProcedureType, subneg));
+  Expression exp;
+
+  const EnvResult * result = lookup(sym);
+  if(result && (result->type == ExpressionType)){
+    exp = result->exp;
+  }
 
-  // Procedure: mul;
-  envmap.emplace("*", EnvResult(ProcedureType, mul));
+  return exp;
+}
 
-  // Procedure: div;
-  envmap.emplace("/", EnvResult(ProcedureType, div));
+const Expression * Environment::find_exp(const Atom & sym) const{
 
-  // Procedure: sqrt;
-  envmap.emplace("sqrt", EnvResult(ProcedureType, sqrt));
+  const EnvResult * result = lookup(sym);
+  return (result && (result->type == ExpressionType)) ? &result->exp : nullptr;
+}
 
-  // Procedure: pow;
-  envmap.emplace("^", EnvResult(ProcedureType, pow));
+void Environment::add_exp(const Atom & sym, const Expression & exp){
 
-  // Procedure: ln;
-  envmap.emplace("ln", EnvResult(ProcedureType, ln));
+    if(!sym.isSymbol()){
+        throw SemanticError("Error: during add_exp: Attempt to add non-symbol to environment");
+    }
 
-  // Procedure: sin;
-  envmap.emplace("sin", EnvResult(ProcedureType, sin));
+    // overwrite any existing mapping in the innermost frame
+    m_frame->bind(sym.symbolId(), EnvResult(ExpressionType, exp));
+}
 
-  // Procedure: cos;
-  envmap.emplace("cos", EnvResult(ProcedureType, cos));
+bool Environment::is_proc(const Atom & sym) const{
 
-  // Procedure: tan;
-  envmap.emplace("tan", EnvResult(ProcedureType, tan));
+  const EnvResult * result = lookup(sym);
+  return result && (result->type == ProcedureType);
+}
 
-  // Procedure: real;
-  envmap.emplace("real", EnvResult(ProcedureType, real));
+bool Environment::is_fixed_proc(const Atom & sym) const{
 
-  // Procedure: imag;
-  envmap.emplace("imag", EnvResult(ProcedureType, imag));
+  const EnvResult * result = lookup(sym);
+  return result && (result->type == ProcedureType) && !result->proc.redefinable();
+}
 
-  // Procedure: mag;
-  envmap.emplace("mag", EnvResult(ProcedureType, mag));
+Procedure Environment::get_proc(const Atom & sym) const{
 
-  // Procedure: arg;
-  envmap.emplace("arg", EnvResult(ProcedureType, arg));
+  const EnvResult * result = lookup(sym);
+  if(result && (result->type == ProcedureType)){
+    return result->proc;
+  }
 
-  // Procedure: conj;
-  envmap.emplace("conj", EnvResult(ProcedureType, conj));
+  return Procedure();
+}
 
-  // Procedure: list as procedure;
-  envmap.emplace("list", EnvResult(ProcedureType, list));
+/*
+Reset the environment to the default state. Start a new global frame and
+then re-add the default ones.
+ */
+void Environment::reset(){
 
-  // Procedure: first;
-  envmap.emplace("first", EnvResult(ProcedureType, first));
+  m_frame = std::make_shared<Frame>();
+  m_frame->global = true;
+  m_global = m_frame;
+  std::unordered_map<SymbolId, EnvResult> & envmap = m_frame->globals;
 
-  // Procedure: rest;
-  envmap.emplace("rest", EnvResult(ProcedureType, rest));
+  // Built-In value of pi
+  envmap.emplace(SymbolTable::intern("pi"), EnvResult(ExpressionType, Expression(PI)));
 
-  // Procedure: length;
-  envmap.emplace("length", EnvResult(ProcedureType, length));
+  // Built-In value of e
+  envmap.emplace(SymbolTable::intern("e"), EnvResult(ExpressionType, Expression(EXP)));
 
-  // Procedure: append;
-  envmap.emplace("append", EnvResult(ProcedureType, append));
+  // Built-In value of i
+  envmap.emplace(SymbolTable::intern("I"), EnvResult(ExpressionType, Expression(IMG)));
 
-  // Procedure: join;
-  envmap.emplace("join", EnvResult(ProcedureType, join));
+  // Built-In value of -i
+  envmap.emplace(SymbolTable::intern("-I"), EnvResult(ExpressionType, Expression(NEG_IMG)));
 
-  // Procedure: range;
-  envmap.emplace("range", EnvResult(ProcedureType, range));
+  // Built-In procedures, each checked against its signature
+  for(const Builtin & builtin : BUILTINS){
+    envmap.emplace(SymbolTable::intern(builtin.name),
+                   EnvResult(ProcedureType, Procedure(builtin.body, builtin.signature)));
+  }
+  for(const Builtin & builtin : LIBRARY_BUILTINS){
+    envmap.emplace(SymbolTable::intern(builtin.name),
+                   EnvResult(ProcedureType, Procedure(builtin.body, builtin.signature, true)));
+  }
 
 }
@@ -11,17 +11,174 @@ needed.
 #define ENVIRONMENT_HPP
 
 // system includes
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 // module includes
 #include "atom.hpp"
 #include "expression.hpp"
 
-/*! \typedef Procedure
-\brief A Procedure is a C++ function pointer taking a vector of
-       Expressions as arguments and returning an Expression.
+/*! \class Arguments
+\brief A read-only view of the arguments to a procedure call.
+
+The view points into storage the caller owns, such as its operand stack or
+a vector of evaluated arguments, so passing arguments never copies them. It
+is valid for the duration of the call.
+ */
+class Arguments {
+public:
+
+  typedef const Expression * ConstIteratorType;
+
+  /// construct a view of no arguments
+  Arguments() noexcept: m_first(nullptr), m_size(0) {}
+
+  /// construct a view of the size arguments starting at first
+  Arguments(const Expression * first, std::size_t size) noexcept: m_first(first), m_size(size) {}
+
+  /// construct a view of the items of a vector
+  Arguments(const std::vector<Expression> & items) noexcept: m_first(items.data()), m_size(items.size()) {}
+
+  /// not a view of a braced list, whose array may be gone before the view
+  /// is used; call a Procedure with the list instead
+  Arguments(std::initializer_list<Expression> items) = delete;
+
+  ConstIteratorType begin() const noexcept { return m_first; }
+  ConstIteratorType end() const noexcept { return m_first + m_size; }
+
+  std::size_t size() const noexcept { return m_size; }
+  bool empty() const noexcept { return m_size == 0; }
+
+  /// return the i-th argument, unchecked
+  const Expression & operator[](std::size_t i) const noexcept { return m_first[i]; }
+
+private:
+  const Expression * m_first;
+  std::size_t m_size;
+};
+
+/*! \enum ArgumentKind
+\brief The kinds of argument a procedure accepts, as bit flags.
+ */
+enum ArgumentKind : std::uint8_t {
+  RealArgument = 1,
+  ComplexArgument = 2,
+  ListArgument = 4,
+  OtherArgument = 8,  //< symbols, strings, lambdas and plots
+  NumberArgument = RealArgument | ComplexArgument,
+  AnyArgument = NumberArgument | ListArgument | OtherArgument
+};
+
+/// the kind of the argument e
+ArgumentKind argumentKind(const Expression & e) noexcept;
+
+/*! \struct Signature
+\brief The arity and argument kinds a built-in procedure accepts.
+
+A Procedure checks its arguments against its Signature before running its
+body, so the body itself only handles arguments it accepts.
+ */
+struct Signature {
+  /// the maxArgs of a procedure that takes any number of arguments
+  static const std::size_t Variadic = static_cast<std::size_t>(-1);
+
+  std::size_t minArgs;
+  std::size_t maxArgs;
+  std::uint8_t firstKinds; //< ArgumentKind flags accepted for the first argument
+  std::uint8_t restKinds;  //< ArgumentKind flags accepted for the others
+  const char * arityError;
+  const char * kindError;
+
+  /*! Check the arguments to a call.
+    \param args the arguments
+    \throws SemanticError with arityError or kindError if they do not match
+   */
+  void check(Arguments args) const;
+
+  /// true if a call with count arguments has an arity this signature accepts
+  bool accepts(std::size_t count) const noexcept {
+    return count >= minArgs && count <= maxArgs;
+  }
+
+  /*! Check the kinds of the arguments to a call whose arity is accepted.
+    \param args the arguments
+    \throws SemanticError with kindError if they do not match
+   */
+  void checkKinds(Arguments args) const;
+};
+
+/*! \typedef ProcedureBody
+\brief The body of a built-in procedure: a C++ function pointer taking a
+       view of arguments already checked against its Signature.
 */
-typedef Expression (*Procedure)(const std::vector<Expression> & args);
+typedef Expression (*ProcedureBody)(Arguments args);
+
+/*! \class Procedure
+\brief A built-in procedure: a body and the Signature guarding it.
+
+Calling a Procedure checks the arguments, then runs the body on them. Most
+built-in procedures may not be redefined; those that replace definitions
+the startup program used to make may be, as those definitions could.
+ */
+class Procedure {
+public:
+
+  /// construct the default procedure, which accepts anything and returns
+  /// an Expression of type None
+  Procedure() noexcept;
+
+  /// construct a procedure running body on arguments that match signature
+  Procedure(ProcedureBody body, const Signature & signature, bool redefinable = false) noexcept:
+    m_body(body), m_signature(&signature), m_redefinable(redefinable) {}
+
+  /// check args against the signature, then run the body on them
+  Expression operator()(Arguments args) const {
+    m_signature->check(args);
+    return m_body(args);
+  }
+
+  /// check the items of a braced list, which outlives the call, then run
+  /// the body on them
+  Expression operator()(std::initializer_list<Expression> args) const {
+    return (*this)(Arguments(args.begin(), args.size()));
+  }
+
+  /// run the body on args whose count was checked when the call was
+  /// compiled, checking only their kinds
+  Expression callResolved(Arguments args) const {
+    m_signature->checkKinds(args);
+    return m_body(args);
+  }
+
+  const Signature & signature() const noexcept { return *m_signature; }
+
+  /// true if a definition may replace the procedure
+  bool redefinable() const noexcept { return m_redefinable; }
+
+  bool operator==(const Procedure & p) const noexcept {
+    return m_body == p.m_body && m_signature == p.m_signature;
+  }
+
+private:
+  ProcedureBody m_body;
+  const Signature * m_signature;
+  bool m_redefinable;
+};
+
+/*! Find the built-in procedure a symbol names in every Environment.
+  \param sym the symbol
+  \param proc set to the procedure if there is one
+  \return true if sym names a built-in procedure that may not be redefined
+
+  Such a symbol names the same procedure wherever it is not bound as a
+  lambda parameter, as no definition may replace it.
+ */
+bool builtinProcedure(const Atom & sym, Procedure & proc);
 
 /*! \class Environment
 \brief A class representing the interpreter environment.
@@ -36,6 +193,20 @@ return you can obtain
 the mapped-to value using get_exp or get_proc.
 
 To add an symbol to expression mapping use the add_exp member function.
+
+An Environment is a chain of reference-counted frames. The global frame
+holds the built-ins and top-level definitions; a lambda call runs in a
+call scope holding only its parameters (see callScope), linked to the
+frame the lambda was defined in rather than copying it, and then to the
+global frame. Copying an Environment copies every frame, so copies never
+affect each other.
+
+A lambda created inside a call refers to the frame it was defined in, but
+does not own it: the global frame owns every call frame a lambda has
+captured, and a closure only holds its frame weakly. Values therefore
+never own frames, and a frame binding a lambda that closes over it forms
+no cycle. collect frees the captured frames no value reachable from the
+globals refers to.
  */
 class Environment {
 public:
@@ -43,10 +214,54 @@ public:
    * definitions. */
   Environment();
 
+  /*! Copy construct an environment, copying every frame. */
+  Environment(const Environment & a);
+
+  /*! Move construct an environment, taking over its frames. */
+  Environment(Environment && a) noexcept = default;
+
   /*! Assignment operator for an expression
    * definitions. */
   Environment & operator=(const Environment & a);
 
+  /*! Move assign an environment, taking over its frames. */
+  Environment & operator=(Environment && a) noexcept = default;
+
+  /*! Create the scope a lambda call runs in.
+    \param closure the scope the lambda closed over, or nullptr
+    \return an environment with a new, empty innermost frame linked to the
+    frames of closure, or to this environment's global frame if there is
+    no closure; the linked frames are shared rather than copied
+    \throws SemanticError if collect has freed the frames of closure
+   */
+  Environment callScope(const Environment * closure = nullptr) const;
+
+  /*! Capture the scope a lambda created here is defined in.
+    \return an environment referring to this one's frames, or nullptr at
+    global scope
+
+    The frames are linked, not copied, so the lambda sees bindings made in
+    them after it was created, such as a local procedure defined after the
+    one that calls it. The global frame keeps them until collect finds
+    nothing refers to them.
+   */
+  std::shared_ptr<const Environment> capture() const;
+
+  /*! Free the captured call frames that no lambda reachable from the
+    global bindings or from result closes over, directly or through the
+    frames it links to. Call it on the global environment when no call is
+    running, so every other value still in use is reachable from result.
+    \param result the value the evaluation returned
+
+    Lambdas are found through list items and properties as well as
+    bindings. To keep the cost in proportion, the globals are only traced
+    once the captured frames have doubled since the last collection.
+   */
+  void collect(const Expression & result);
+
+  /*! Determine if this is the global scope, rather than a call scope. */
+  bool isGlobal() const noexcept;
+
   /*! Determine if a symbol is known to the environment.
     \param sym the sumbol to lookup
     \return true if the symbol has been defined in the environment
@@ -60,7 +275,13 @@ public:
    */
   bool is_exp(const Atom &sym) const;
 
+  /*! Bind sym to new_sym in the innermost frame, replacing any binding it
+    has there; the same as add_exp.
+   */
   void __shadowing_helper(const Atom & sym, const Expression & new_sym);
+
+  /*! Evaluate an expression in this environment; the same as e.eval(*this).
+   */
   Expression evaluate_an_exp(Expression & e);
 
   /*! Get the Expression the argument symbol maps to.
@@ -69,6 +290,13 @@ public:
   */
   Expression get_exp(const Atom &sym) const;
 
+  /*! Find the Expression the argument symbol maps to, without copying it.
+    \param sym the symbol to lookup
+    \return the expression the symbol maps to, or nullptr if the symbol is
+    not defined as an expression; valid until the environment next changes
+  */
+  const Expression * find_exp(const Atom &sym) const;
+
   /*! Add a mapping from sym argument to the exp argument within the environment.
     \param sym the symbol to add
     \param exp the expression the symbol should map to
@@ -81,6 +309,12 @@ public:
    */
   bool is_proc(const Atom &sym) const;
 
+  /*! Determine if a symbol names a procedure a definition may not replace
+    \param sym the symbol to lookup
+    \return true if the symbol maps to a procedure that is not redefinable
+   */
+  bool is_fixed_proc(const Atom &sym) const;
+
   /*! Get the Procedure the argument symbol maps to
     \param sym the symbol to lookup
     \return the procedure it maps to
@@ -109,8 +343,42 @@ private:
     EnvResult(EnvResultType t, Procedure p) : type(t), proc(p){};
   };
 
-  // the environment map
-  std::map<std::string, EnvResult> envmap;
+  // One scope of bindings, keyed by interned symbol ID. The global frame
+  // has many bindings and hashes them; a call frame has a handful and keeps
+  // them in a flat vector, so creating one is a single allocation.
+  struct Frame {
+    std::unordered_map<SymbolId, EnvResult> globals; // global frame only
+    std::vector<std::pair<SymbolId, EnvResult>> locals; // call frames only
+    std::shared_ptr<Frame> parent; // the enclosing call frame, if any
+    bool global = false; // true for the global frame
+    bool captured = false; // true once a lambda closes over the call frame
+
+    // global frame only: the call frames lambdas have closed over, and how
+    // many of them the last collection kept
+    std::vector<std::shared_ptr<Frame>> captures;
+    std::size_t kept = 0;
+
+    const EnvResult * find(SymbolId id) const;
+    void bind(SymbolId id, const EnvResult & value);
+  };
+
+  Environment(std::shared_ptr<Frame> frame, std::shared_ptr<Frame> global);
+
+  // copy a chain of frames, so the copy never shares a binding
+  static std::shared_ptr<Frame> copyFrames(const Frame & frame);
+
+  // the innermost binding of sym, or nullptr
+  const EnvResult * lookup(const Atom & sym) const;
+
+  // the innermost frame; null for a closure
+  std::shared_ptr<Frame> m_frame;
+
+  // the global frame, which ends every lookup; null for a closure, which
+  // sees the globals of each caller instead of holding its own
+  std::shared_ptr<Frame> m_global;
+
+  // the frame a closure refers to, owned by a global frame
+  std::weak_ptr<Frame> m_captured;
 };
 
 #endif
@@ -0,0 +1,212 @@
+#include "bench.hpp"
+
+#include <sstream>
+
+#include "environment.hpp"
+#include "interpreter.hpp"
+#include "vector_math.hpp"
+
+// an interpreter with n globals, each a short list, and a one-argument lambda
+static Interpreter session(std::size_t n, Interpreter::EvaluationMode mode){
+
+  Interpreter interp;
+  interp.setEvaluationMode(mode);
+
+  std::ostringstream program;
+  program << "(begin (define f (lambda (x) (* x x)))";
+  for(std::size_t i = 0; i < n; ++i){
+    program << " (define g" << i << " (list 1 2 3 4 5 6 7 8))";
+  }
+  program << ")";
+
+  std::istringstream iss(program.str());
+  interp.parseStream(iss);
+  interp.evaluate();
+  return interp;
+}
+
+static void lambda_call(){
+
+  const std::size_t N = 20000;
+
+  for(std::size_t globals : {0, 100, 10000}){
+    for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+      Interpreter interp = session(globals, mode);
+      std::istringstream iss("(f 3)");
+      interp.parseStream(iss);
+
+      double ns = bench::time_ns(N, [&](){
+        Expression result = interp.evaluate();
+        bench::keep(&result);
+      });
+      bench::report(std::string(mode == Interpreter::TreeWalk ? "tree-walk" : "bytecode") +
+                    ", " + std::to_string(globals) + " globals", ns, "(f 3)");
+    }
+  }
+
+  // what every call paid before frames: a copy of the whole environment
+  Environment env;
+  for(std::size_t i = 0; i < 10000; ++i){
+    env.add_exp(Atom("g" + std::to_string(i)), Expression(std::vector<Expression>(8, Expression(1.))));
+  }
+  bench::report("copy environment, 10000 globals", bench::time_ns(200, [&](){
+    Environment copy = env;
+    bench::keep(&copy);
+  }));
+}
+BENCHMARK(lambda_call, "lambda call");
+
+static void list_builtins(){
+
+  const std::size_t N = 200;
+
+  Environment env;
+  std::vector<Expression> big = {Expression(0.), Expression(9999.)};
+  Expression list = env.get_proc(Atom("range"))(big);
+
+  for(auto name : {"rest", "append", "join"}){
+    Procedure proc = env.get_proc(Atom(name));
+    std::vector<Expression> args = {list};
+    if(std::string(name) != "rest"){
+      args.push_back(list);
+    }
+    // every call after the first extends the same list again, so append
+    // and join copy it; see SharedSlice
+    bench::report(name, bench::time_ns(N, [&](){
+      Expression result = proc(args);
+      bench::keep(&result);
+    }), std::string(name) == "rest" ? "10000 items" : "10000 items, already extended");
+  }
+}
+BENCHMARK(list_builtins, "list builtins");
+
+static void build_list(){
+
+  // linear building shows as a flat cost per item
+  for(std::size_t n : {1000, 10000, 100000, 1000000}){
+    Interpreter interp;
+    interp.setEvaluationMode(Interpreter::TreeWalk);
+    std::istringstream define("(define l (list))");
+    interp.parseStream(define);
+    interp.evaluate();
+
+    std::istringstream step("(define l (append l 1))");
+    interp.parseStream(step);
+
+    double ns = bench::time_ns(n, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    bench::report(std::to_string(n) + " appends", ns, "(define l (append l 1))");
+  }
+}
+BENCHMARK(build_list, "build a list by append");
+
+static void elementwise_series(){
+
+  const std::size_t N = 5;
+
+  // a million-point series, transformed by a builtin and by map with a lambda
+  Interpreter interp;
+  std::istringstream define("(begin (define xs (range 0 999999)) (define f (lambda (x) (+ (* 2 x) 1))))");
+  interp.parseStream(define);
+  interp.evaluate();
+
+  for(auto program : {"(+ (* 2 xs) 1)", "(sin xs)", "(map f xs)"}){
+    std::istringstream iss(program);
+    interp.parseStream(iss);
+    double ns = bench::time_ns(N, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    bench::report(program, ns, "1000000 items");
+  }
+
+  // the kernels alone, on each supported instruction set
+  std::vector<double> a(1000000, 1.5), out(a.size());
+  for(auto isa : {vector_math::Isa::Scalar, vector_math::Isa::SSE2, vector_math::Isa::AVX2}){
+    if(!vector_math::supported(isa)) continue;
+    const char * names[] = {"scalar", "sse2", "avx2"};
+    bench::report(std::string("mul kernel, ") + names[static_cast<int>(isa)], bench::time_ns(200, [&](){
+      vector_math::apply(isa, vector_math::Op::Mul, vector_math::array(a.data()),
+                         vector_math::broadcast(2.0), out.data(), out.size());
+      bench::keep(out.data());
+    }), "1000000 items");
+  }
+}
+BENCHMARK(elementwise_series, "elementwise arithmetic");
+
+static void reductions(){
+
+  const std::size_t N = 5;
+
+  Interpreter interp;
+  std::istringstream define("(define xs (range 0 999999))");
+  interp.parseStream(define);
+  interp.evaluate();
+
+  for(auto program : {"(apply + xs)", "(sum xs)", "(max xs)", "(variance xs)"}){
+    std::istringstream iss(program);
+    interp.parseStream(iss);
+    double ns = bench::time_ns(N, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    bench::report(program, ns, "1000000 items");
+  }
+}
+BENCHMARK(reductions, "reductions");
+
+static void arithmetic_kinds(){
+
+  const std::size_t N = 1000000;
+
+  Environment env;
+  Expression real(2.5), complex(std::complex<double>(2.5, 1.0));
+  std::vector<std::pair<const char *, std::vector<Expression>>> kinds = {
+    {"real-real", {real, real}},
+    {"real-complex", {real, complex}},
+    {"complex-complex", {complex, complex}},
+  };
+
+  for(auto op : {"+", "-", "*", "/", "^"}){
+    Procedure proc = env.get_proc(Atom(op));
+    for(auto & kind : kinds){
+      bench::report(std::string("(") + op + ") " + kind.first, bench::time_ns(N, [&](){
+        Expression result = proc(kind.second);
+        bench::keep(&result);
+      }));
+    }
+  }
+}
+BENCHMARK(arithmetic_kinds, "arithmetic by argument kind");
+
+static void procedure_calls(){
+
+  const std::size_t N = 1000000;
+
+  Environment env;
+  Procedure add = env.get_proc(Atom("+"));
+  Expression a(1.0), b(2.0);
+  std::vector<Expression> stack = {a, b};
+
+  bench::report("(+ 1 2) on caller storage", bench::time_ns(N, [&](){
+    Expression result = add(Arguments(stack.data(), stack.size()));
+    bench::keep(&result);
+  }));
+
+  bench::report("(+ 1 2) into a fresh vector", bench::time_ns(N, [&](){
+    std::vector<Expression> args = {a, b};
+    Expression result = add(args);
+    bench::keep(&result);
+  }));
+
+  Interpreter interp = session(0, Interpreter::EvaluationMode::Bytecode);
+  std::istringstream iss("(+ (sqrt 4) (- 3 1) (* 2 2))");
+  interp.parseStream(iss);
+  bench::report("builtin calls in bytecode", bench::time_ns(N / 10, [&](){
+    Expression result = interp.evaluate();
+    bench::keep(&result);
+  }), "3 nested calls");
+}
+BENCHMARK(procedure_calls, "procedure calls");
@@ -4,6 +4,8 @@
 #include "semantic_error.hpp"
 
 #include <cmath>
+#include <initializer_list>
+#include <type_traits>
 
 TEST_CASE( "Test default constructor", "[environment]" ) {
 
@@ -55,6 +57,11 @@ TEST_CASE( "Test get expression", "[environment]" ) {
 
   REQUIRE(env.get_exp(Atom("pi")) == Expression(std::atan2(0, -1)));
   REQUIRE(env.get_exp(Atom("hi")) == Expression());
+
+  REQUIRE(env.find_exp(Atom("pi")) != nullptr);
+  REQUIRE(*env.find_exp(Atom("pi")) == Expression(std::atan2(0, -1)));
+  REQUIRE(env.find_exp(Atom("hi")) == nullptr);
+  REQUIRE(env.find_exp(Atom("+")) == nullptr);
 }
 
 TEST_CASE( "Test add expression", "[environment]" ) {
@@ -106,6 +113,11 @@ TEST_CASE( "Test get built-in procedure", "[environment]" ) {
 
 	INFO("add semantic error")
 	REQUIRE_THROWS_AS(padd(std::vector<Expression>{ Expression(std::string("not_valid_input")) }), SemanticError);
+
+	INFO("a braced list is passed to the call, never kept in a view");
+	static_assert(!std::is_constructible<Arguments, std::initializer_list<Expression>>::value,
+	              "Arguments must not view a braced list");
+	REQUIRE(padd({Expression(1.0), Expression(2.0)}) == Expression(3.0));
 }
 
 TEST_CASE( "Test reset", "[environment]" ) {
@@ -125,6 +137,55 @@ TEST_CASE( "Test reset", "[environment]" ) {
   REQUIRE(env.get_exp(Atom("hi")) == Expression());
 }
 
+TEST_CASE( "Test call scopes", "[environment]" ) {
+  Environment env;
+  env.add_exp(Atom("x"), Expression(1.0));
+  env.add_exp(Atom("y"), Expression(2.0));
+  REQUIRE(env.isGlobal());
+  REQUIRE(env.capture() == nullptr);
+
+  Environment scope = env.callScope();
+  REQUIRE(!scope.isGlobal());
+
+  // globals are visible and built-ins still resolve
+  REQUIRE(scope.get_exp(Atom("y")) == Expression(2.0));
+  REQUIRE(scope.is_proc(Atom("+")));
+
+  // a binding in the call frame hides the global one, without changing it
+  scope.add_exp(Atom("x"), Expression(10.0));
+  REQUIRE(scope.get_exp(Atom("x")) == Expression(10.0));
+  REQUIRE(env.get_exp(Atom("x")) == Expression(1.0));
+  scope.add_exp(Atom("+"), Expression(3.0));
+  REQUIRE(!scope.is_proc(Atom("+")));
+  REQUIRE(env.is_proc(Atom("+")));
+
+  // the global frame is shared, not copied
+  env.add_exp(Atom("z"), Expression(4.0));
+  REQUIRE(scope.get_exp(Atom("z")) == Expression(4.0));
+
+  // a capture shares the call frames of the scope, but not the globals
+  std::shared_ptr<const Environment> closure = scope.capture();
+  REQUIRE(closure != nullptr);
+  REQUIRE(closure->get_exp(Atom("x")) == Expression(10.0));
+  REQUIRE(!closure->is_known(Atom("y")));
+
+  // a call scope made from a closure is linked to its frames
+  Environment inner = env.callScope(closure.get());
+  REQUIRE(inner.get_exp(Atom("x")) == Expression(10.0));
+  REQUIRE(inner.get_exp(Atom("y")) == Expression(2.0));
+  scope.add_exp(Atom("u"), Expression(7.0));
+  REQUIRE(inner.get_exp(Atom("u")) == Expression(7.0));
+  inner.add_exp(Atom("x"), Expression(11.0));
+  REQUIRE(scope.get_exp(Atom("x")) == Expression(10.0));
+
+  // copying a call scope copies the global frame too
+  Environment copy = scope;
+  copy.add_exp(Atom("w"), Expression(5.0));
+  REQUIRE(!scope.is_known(Atom("w")));
+  env.add_exp(Atom("v"), Expression(6.0));
+  REQUIRE(!copy.is_known(Atom("v")));
+}
+
 TEST_CASE( "Test enviorment class operators", "[environment]" ) {
   Environment env;
 
@@ -508,6 +569,42 @@ TEST_CASE("Testing join procedure", "[environment]") {
     REQUIRE_THROWS_AS(pjoin(too_many_args), SemanticError);
 }
 
+TEST_CASE("Testing list procedures share structure", "[environment]") {
+
+    Environment env;
+    Procedure pappend = env.get_proc(Atom("append"));
+    Procedure prest = env.get_proc(Atom("rest"));
+    Procedure pjoin = env.get_proc(Atom("join"));
+    Procedure pfirst = env.get_proc(Atom("first"));
+    Procedure plength = env.get_proc(Atom("length"));
+
+    // build a list one item at a time, keeping every version
+    std::vector<Expression> versions = { Expression(std::vector<Expression>{}) };
+    for(int i = 0; i < 100; ++i){
+        versions.push_back(pappend({versions.back(), Expression(i)}));
+    }
+    for(std::size_t n = 0; n < versions.size(); ++n){
+        REQUIRE(plength({versions[n]}) == Expression(double(n)));
+    }
+    REQUIRE(*(versions[100].tailConstEnd() - 1) == Expression(99.));
+
+    // appending to an old version does not disturb newer ones
+    Expression branch = pappend({versions[50], Expression(-1)});
+    REQUIRE(*(branch.tailConstEnd() - 1) == Expression(-1.));
+    REQUIRE(*(versions[51].tailConstEnd() - 1) == Expression(50.));
+
+    // rest shares the items of its argument
+    Expression rest = prest({versions[100]});
+    REQUIRE(&*rest.tailConstBegin() == &*versions[100].tailConstBegin() + 1);
+    REQUIRE(pfirst({rest}) == Expression(1.));
+    REQUIRE(plength({rest}) == Expression(99.));
+
+    Expression joined = pjoin({rest, versions[3]});
+    REQUIRE(plength({joined}) == Expression(102.));
+    REQUIRE(*(joined.tailConstEnd() - 1) == Expression(2.));
+    REQUIRE(plength({rest}) == Expression(99.));
+}
+
 TEST_CASE("Testing range procedure", "[environment]") {
 
     Environment env;
@@ -532,4 +629,226 @@ TEST_CASE("Testing range procedure", "[environment]") {
 
     std::vector<Expression> two_arg = { Expression(1), Expression(3) };
     REQUIRE(prange(two_arg) == Expression(resultList));
-}
\ No newline at end of file
+}
+TEST_CASE("Testing numeric lists are stored unboxed", "[environment]") {
+
+    Environment env;
+    Procedure prange = env.get_proc(Atom("range"));
+    Procedure plist = env.get_proc(Atom("list"));
+    Procedure pfirst = env.get_proc(Atom("first"));
+    Procedure prest = env.get_proc(Atom("rest"));
+    Procedure plength = env.get_proc(Atom("length"));
+    Procedure pappend = env.get_proc(Atom("append"));
+
+    Expression numbers = prange({Expression(0), Expression(9)});
+    REQUIRE(numbers.isRealVector());
+    REQUIRE(plist({Expression(1), Expression(2)}).isRealVector());
+    REQUIRE(!plist({Expression(1), Expression(Atom("a"))}).isRealVector());
+
+    // the list procedures see the same items either way
+    REQUIRE(plength({numbers}) == Expression(10.));
+    REQUIRE(pfirst({numbers}) == Expression(0.));
+    REQUIRE(pfirst({prest({numbers})}) == Expression(1.));
+    REQUIRE(prest({numbers}).isRealVector());
+    REQUIRE(pappend({numbers, Expression(10)}).isRealVector());
+    REQUIRE(pappend({numbers, numbers}).tailLength() == 11);
+    REQUIRE(!pappend({numbers, numbers}).isRealVector());
+}
+
+TEST_CASE("Testing arithmetic applies elementwise to lists", "[environment]") {
+
+    Environment env;
+    Procedure padd = env.get_proc(Atom("+"));
+    Procedure psub = env.get_proc(Atom("-"));
+    Procedure pmul = env.get_proc(Atom("*"));
+    Procedure pdiv = env.get_proc(Atom("/"));
+    Procedure ppow = env.get_proc(Atom("^"));
+    Procedure plist = env.get_proc(Atom("list"));
+
+    Expression a = plist({Expression(1), Expression(2), Expression(3)});
+    Expression b = plist({Expression(4), Expression(5), Expression(6)});
+
+    REQUIRE(padd({a, b}) == plist({Expression(5), Expression(7), Expression(9)}));
+    REQUIRE(padd({a, b}).isRealVector());
+    REQUIRE(padd({a, Expression(1), b}) == plist({Expression(6), Expression(8), Expression(10)}));
+    REQUIRE(padd({a}) == a);
+    REQUIRE(psub({b, a}) == plist({Expression(3), Expression(3), Expression(3)}));
+    REQUIRE(psub({a}) == plist({Expression(-1), Expression(-2), Expression(-3)}));
+    REQUIRE(psub({Expression(10), a}) == plist({Expression(9), Expression(8), Expression(7)}));
+    REQUIRE(pmul({a, Expression(2)}) == plist({Expression(2), Expression(4), Expression(6)}));
+    REQUIRE(pdiv({b, Expression(2)}) == plist({Expression(2), Expression(2.5), Expression(3)}));
+    REQUIRE(pdiv({Expression(0), a}) == plist({Expression(0), Expression(0), Expression(0)}));
+    REQUIRE(pdiv({plist({Expression(2), Expression(4)})}) == plist({Expression(0.5), Expression(0.25)}));
+    REQUIRE(ppow({a, Expression(2)}) == plist({ppow({Expression(1), Expression(2)}),
+                                               ppow({Expression(2), Expression(2)}),
+                                               ppow({Expression(3), Expression(2)})}));
+
+    // the result matches applying the procedure to each item
+    for(std::size_t i = 0; i < 3; ++i){
+        REQUIRE(pdiv({a, b}).item(i) == pdiv({a.item(i), b.item(i)}));
+        REQUIRE(ppow({b, a}).item(i) == ppow({b.item(i), a.item(i)}));
+    }
+
+    // complex items, and lists of lists, are handled one item at a time
+    std::complex<double> i(0, 1);
+    Expression complexes = plist({Expression(i), Expression(2.*i)});
+    REQUIRE(padd({complexes, Expression(1)}) == plist({Expression(1. + i), Expression(1. + 2.*i)}));
+    REQUIRE(pmul({plist({a, b}), Expression(2)}) ==
+            plist({pmul({a, Expression(2)}), pmul({b, Expression(2)})}));
+
+    REQUIRE_THROWS_AS(padd({a, plist({Expression(1)})}), SemanticError);
+    REQUIRE_THROWS_AS(padd({a, plist({Expression(1), Expression(2), Expression(Atom("x"))})}), SemanticError);
+    REQUIRE_THROWS_AS(psub({a, a, a}), SemanticError);
+    REQUIRE_THROWS_AS(pdiv({a, a, a}), SemanticError);
+
+    REQUIRE(pdiv({Expression(0), Expression(5)}) == Expression(0));
+}
+
+TEST_CASE("Testing math functions apply elementwise to lists", "[environment]") {
+
+    Environment env;
+    Procedure plist = env.get_proc(Atom("list"));
+    Expression angles = plist({Expression(0), Expression(1), Expression(2)});
+
+    for(std::string name : {"sin", "cos", "tan"}){
+        Procedure proc = env.get_proc(Atom(name));
+        Expression result = proc({angles});
+        REQUIRE(result.isRealVector());
+        REQUIRE(result.tailLength() == 3);
+        for(std::size_t i = 0; i < 3; ++i){
+            REQUIRE(result.item(i) == proc({angles.item(i)}));
+        }
+    }
+
+    Procedure pln = env.get_proc(Atom("ln"));
+    Expression positive = plist({Expression(1), Expression(std::exp(1))});
+    REQUIRE(pln({positive}) == plist({Expression(0), Expression(1)}));
+    REQUIRE_THROWS_AS(pln({angles}), SemanticError);
+
+    Procedure psin = env.get_proc(Atom("sin"));
+    REQUIRE_THROWS_AS(psin({plist({Expression(std::complex<double>(0, 1))})}), SemanticError);
+}
+
+TEST_CASE("Testing reduction procedures", "[environment]") {
+
+    Environment env;
+    Procedure plist = env.get_proc(Atom("list"));
+    Procedure prange = env.get_proc(Atom("range"));
+    auto reduce = [&](const std::string & name, const Expression & list){
+        return env.get_proc(Atom(name))({list});
+    };
+
+    Expression numbers = plist({Expression(3), Expression(-1), Expression(4), Expression(-1), Expression(5)});
+    REQUIRE(reduce("sum", numbers) == Expression(10));
+    REQUIRE(reduce("prod", numbers) == Expression(60));
+    REQUIRE(reduce("mean", numbers) == Expression(2));
+    REQUIRE(reduce("variance", numbers) == Expression(6.4));
+    REQUIRE(reduce("min", numbers) == Expression(-1));
+    REQUIRE(reduce("max", numbers) == Expression(5));
+    REQUIRE(reduce("argmin", numbers) == Expression(1));
+    REQUIRE(reduce("argmax", numbers) == Expression(4));
+
+    Expression big = prange({Expression(1), Expression(100000)});
+    REQUIRE(reduce("sum", big) == Expression(5000050000.));
+    REQUIRE(reduce("mean", big) == Expression(50000.5));
+
+    // lists that are not unboxed give the same answers
+    Expression tagged(4.);
+    tagged.setProperty("note", Expression(Atom("\"x\"")));
+    Expression boxed = plist({Expression(3), tagged});
+    REQUIRE(!boxed.isRealVector());
+    REQUIRE(reduce("sum", boxed) == Expression(7));
+    Expression boxed_numbers(std::vector<Expression>{Expression(3), Expression(4)});
+    REQUIRE(reduce("sum", boxed_numbers) == Expression(7));
+    REQUIRE(reduce("max", boxed_numbers) == Expression(4));
+    REQUIRE(reduce("variance", boxed_numbers) == Expression(0.25));
+
+    // sums, products and means of complex numbers are complex
+    std::complex<double> i(0, 1);
+    Expression complexes = plist({Expression(i), Expression(1.)});
+    REQUIRE(reduce("sum", complexes) == Expression(1. + i));
+    REQUIRE(reduce("prod", complexes) == Expression(i));
+    REQUIRE(reduce("mean", complexes) == Expression((1. + i) / 2.));
+    REQUIRE_THROWS_AS(reduce("min", complexes), SemanticError);
+    REQUIRE_THROWS_AS(reduce("variance", complexes), SemanticError);
+
+    // the empty list has a sum and a product, but no extremes or mean
+    Expression empty = plist({});
+    REQUIRE(reduce("sum", empty) == Expression(0));
+    REQUIRE(reduce("prod", empty) == Expression(1));
+    for(std::string name : {"mean", "variance", "min", "max", "argmin", "argmax"}){
+        REQUIRE_THROWS_AS(reduce(name, empty), SemanticError);
+    }
+
+    REQUIRE_THROWS_AS(reduce("sum", Expression(1)), SemanticError);
+    REQUIRE_THROWS_AS(env.get_proc(Atom("sum"))({numbers, numbers}), SemanticError);
+    REQUIRE_THROWS_AS(reduce("sum", plist({Expression(Atom("a"))})), SemanticError);
+}
+
+TEST_CASE("Testing arithmetic result kinds", "[environment]") {
+
+    Environment env;
+    Expression real(3.), complex(std::complex<double>(3., 0.));
+
+    // any complex argument gives a complex result, even with no imaginary part
+    for(std::string op : {"+", "-", "*", "/", "^"}){
+        Procedure proc = env.get_proc(Atom(op));
+        REQUIRE(proc({real, real}).head().isNumber());
+        REQUIRE(proc({real, complex}).head().isComplex());
+        REQUIRE(proc({complex, real}).head().isComplex());
+        REQUIRE(proc({complex, complex}).head().isComplex());
+    }
+
+    // a real minus a complex is computed as complex subtraction
+    Procedure psub = env.get_proc(Atom("-"));
+    REQUIRE(!std::signbit(psub({real, complex}).head().asComplex().imag()));
+
+    Procedure pdiv = env.get_proc(Atom("/"));
+    REQUIRE(pdiv({Expression(4.)}) == Expression(0.25));
+    REQUIRE(pdiv({Expression(std::complex<double>(0., 2.))}) == Expression(std::complex<double>(0., -0.5)));
+}
+
+TEST_CASE("Testing procedure signatures", "[environment]") {
+
+    Environment env;
+    Expression real(2.), complex(std::complex<double>(1., 1.)), text(Atom("text"));
+    Expression list = env.get_proc(Atom("list"))({real, real});
+
+    INFO("argument kinds");
+    REQUIRE(argumentKind(real) == RealArgument);
+    REQUIRE(argumentKind(complex) == ComplexArgument);
+    REQUIRE(argumentKind(list) == ListArgument);
+    REQUIRE(argumentKind(Expression()) == OtherArgument);
+    REQUIRE(argumentKind(text) == OtherArgument);
+
+    INFO("arguments view caller storage");
+    std::vector<Expression> items = {real, complex};
+    Arguments view(items);
+    REQUIRE(view.size() == 2);
+    REQUIRE(&view[0] == items.data());
+    REQUIRE(Arguments().empty());
+
+    INFO("signatures are checked before the body runs");
+    Procedure psqrt = env.get_proc(Atom("sqrt"));
+    REQUIRE(psqrt.signature().minArgs == 1);
+    REQUIRE(psqrt.signature().maxArgs == 1);
+    REQUIRE_THROWS_WITH(psqrt({}), psqrt.signature().arityError);
+    REQUIRE_THROWS_WITH(psqrt({real, real}), psqrt.signature().arityError);
+    REQUIRE_THROWS_WITH(psqrt({list}), psqrt.signature().kindError);
+
+    Procedure pappend = env.get_proc(Atom("append"));
+    REQUIRE_THROWS_WITH(pappend({real, list}), pappend.signature().kindError);
+    REQUIRE(pappend({list, text}).tailLength() == 3);
+
+    Procedure padd = env.get_proc(Atom("+"));
+    REQUIRE(padd.signature().maxArgs == Signature::Variadic);
+    REQUIRE(padd({}) == Expression(0.));
+    REQUIRE_THROWS_AS(padd({real, text}), SemanticError);
+
+    INFO("list items are checked as each elementwise call is made");
+    Expression mixed = env.get_proc(Atom("list"))({real, text});
+    REQUIRE_THROWS_AS(padd({mixed, real}), SemanticError);
+
+    INFO("a lone non-number is no longer taken for a complex number");
+    REQUIRE_THROWS_AS(env.get_proc(Atom("/"))({text}), SemanticError);
+}
@@ -1,158 +1,603 @@
 #include "expression.hpp"
 
-#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
 #include <list>
+#include <sstream>
+#include <vector>
 
 #include "environment.hpp"
 #include "semantic_error.hpp"
+#include "vector_math.hpp"
 
-Expression::Expression(): m_type(ExpType::None)
+Expression::Node::Node(): refs(1), type(ExpType::None), form(SpecialForm::Lookup),
+                          storage(Storage::Boxed), tail()
 {}
 
-// Basic constructor
-Expression::Expression(const Atom & a): m_head(a), m_type(ExpType::Singleton)
+// shallow copy, the tail and properties share their nodes
+Expression::Node::Node(const Node & a): refs(1), head(a.head), type(a.type),
+                                        form(a.form), storage(Storage::Boxed), tail(),
+                                        graphic(a.graphic ? new Graphic(*a.graphic) : nullptr),
+                                        properties(a.properties),
+                                        code(a.code), closure(a.closure)
+{
+  switch(a.storage){
+    case Storage::Real:
+      setTail(Reals(a.reals));
+      break;
+    case Storage::Complex:
+      setTail(SharedSlice<std::complex<double>>(a.complexes));
+      break;
+    default:
+      tail = a.tail;
+  }
+}
+
+Expression::Node::~Node(){
+  setTail(Tail());
+  tail.~Tail();
+}
+
+const Graphic & Expression::Node::graphicFields() const noexcept{
+  static const Graphic none;
+  return graphic ? *graphic : none;
+}
+
+void Expression::Node::setGraphic(const Graphic & g){
+  if(g.kind == GraphicKind::None){
+    graphic.reset();
+  }
+  else if(graphic){
+    *graphic = g;
+  }
+  else{
+    graphic.reset(new Graphic(g));
+  }
+}
+
+std::size_t Expression::Node::size() const noexcept{
+  switch(storage){
+    case Storage::Real:
+      return reals.size();
+    case Storage::Complex:
+      return complexes.size();
+    default:
+      return tail.size();
+  }
+}
+
+Expression Expression::Node::item(std::size_t i) const{
+  switch(storage){
+    case Storage::Real:
+      return Expression(reals[i]);
+    case Storage::Complex:
+      return Expression(complexes[i]);
+    default:
+      return tail[i];
+  }
+}
+
+const Expression::Tail & Expression::Node::items() const noexcept{
+  assert(storage == Storage::Boxed);
+  return tail;
+}
+
+Expression::Tail Expression::Node::boxedItems() const{
+
+  if(storage == Storage::Boxed){
+    return tail;
+  }
+
+  std::vector<Expression> exps;
+  exps.reserve(size());
+  for(std::size_t i = 0; i < size(); ++i){
+    exps.push_back(item(i));
+  }
+  return Tail(std::move(exps));
+}
+
+void Expression::Node::setTail(Tail && items) noexcept{
+  if(storage == Storage::Boxed){
+    tail = std::move(items);
+    return;
+  }
+  if(storage == Storage::Real){
+    reals.~Reals();
+  }
+  else{
+    complexes.~SharedSlice();
+  }
+  new(&tail) Tail(std::move(items));
+  storage = Storage::Boxed;
+}
+
+void Expression::Node::setTail(Reals && values) noexcept{
+  if(storage == Storage::Real){
+    reals = std::move(values);
+    return;
+  }
+  setTail(Tail());
+  tail.~Tail();
+  new(&reals) Reals(std::move(values));
+  storage = Storage::Real;
+}
+
+void Expression::Node::setTail(SharedSlice<std::complex<double>> && values) noexcept{
+  if(storage == Storage::Complex){
+    complexes = std::move(values);
+    return;
+  }
+  setTail(Tail());
+  tail.~Tail();
+  new(&complexes) SharedSlice<std::complex<double>>(std::move(values));
+  storage = Storage::Complex;
+}
+
+void Expression::Node::box(){
+
+  if(storage != Storage::Boxed){
+    setTail(boxedItems());
+  }
+}
+
+const Expression::Node & Expression::node() const noexcept{
+
+  // the empty Expression has no node of its own
+  static const Node none;
+  return m_node ? *m_node : none;
+}
+
+Expression::Node & Expression::mutableNode(){
+
+  if(!m_node){
+    m_node = new Node();
+  }
+  else if(m_node->refs.load(std::memory_order_acquire) != 1){
+    // copy on write: detach from the other owners first
+    Node * copy = new Node(*m_node);
+    release(m_node);
+    m_node = copy;
+  }
+  return *m_node;
+}
+
+void Expression::release(Node * node) noexcept{
+
+  if(!node || node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1){
+    return;
+  }
+
+  // Deleting a node releases its items, which may be deleted in turn. Those
+  // nodes are queued here and deleted by the outermost release, so a deep
+  // tree is freed in a loop rather than by recursion. A dead node's count is
+  // never read again, so it holds the link to the next node in the queue.
+  static thread_local Node * queued = nullptr;
+  static thread_local bool deleting = false;
+
+  node->refs.store(reinterpret_cast<std::uintptr_t>(queued), std::memory_order_relaxed);
+  queued = node;
+  if(deleting){
+    return;
+  }
+
+  deleting = true;
+  while(queued){
+    Node * next = queued;
+    queued = reinterpret_cast<Node *>(next->refs.load(std::memory_order_relaxed));
+    delete next;
+  }
+  deleting = false;
+}
+
+Expression::Expression(): m_node(nullptr)
 {}
 
-// recursive copy
-Expression::Expression(const Expression & a) {
+// Basic constructor
+Expression::Expression(const Atom & a): m_node(new Node()) {
+  m_node->head = a;
+  m_node->type = ExpType::Singleton;
+  m_node->form = resolveForm(a, true);
+}
 
-  m_type = a.m_type;
-  m_head = a.m_head;
-  m_properties = a.m_properties;
-  for(auto e : a.m_tail){
-    m_tail.push_back(e);
+// share the node, constant time
+Expression::Expression(const Expression & a) noexcept: m_node(a.m_node) {
+  if(m_node){
+    m_node->refs.fetch_add(1, std::memory_order_relaxed);
   }
 }
 
+Expression::Expression(Expression && a) noexcept: m_node(a.m_node) {
+  a.m_node = nullptr;
+}
+
 // Constructor for lists
-Expression::Expression(const std::vector<Expression> & items) {
-  m_type = ExpType::List;
-  m_tail = items;
+Expression::Expression(const std::vector<Expression> & items):
+  Expression(std::vector<Expression>(items))
+{}
+
+Expression::Expression(std::vector<Expression> && items): m_node(new Node()) {
+  m_node->type = ExpType::List;
+  m_node->tail = Tail(std::move(items));
+  m_node->form = resolveForm(m_node->head, m_node->tail.empty());
+}
+
+Expression::Expression(const Atom & a, std::vector<Expression> && items): m_node(new Node()) {
+  m_node->head = a;
+  m_node->type = ExpType::Singleton;
+  m_node->tail = Tail(std::move(items));
+  m_node->form = resolveForm(a, m_node->tail.empty());
+}
+
+Expression::Expression(const Atom & a, Expression * first, Expression * last): m_node(new Node()) {
+  m_node->head = a;
+  m_node->type = ExpType::Singleton;
+  m_node->tail = Tail(std::make_move_iterator(first), std::make_move_iterator(last));
+  m_node->form = resolveForm(a, m_node->tail.empty());
 }
 
 //Constructor for Lambda functions
-Expression::Expression(const std::vector<Expression> & args, Expression & func) {
+Expression::Expression(const std::vector<Expression> & args, const Expression & func):
+  Expression(std::vector<Expression>(args), Expression(func))
+{}
+
+Expression::Expression(std::vector<Expression> && args, Expression && func): m_node(new Node()) {
 
-  m_type = ExpType::Lambda;
-  m_tail.push_back(args);
-  m_tail.push_back(func);
+  m_node->type = ExpType::Lambda;
+  m_node->form = SpecialForm::Call;
+  std::vector<Expression> tail;
+  tail.reserve(2);
+  tail.emplace_back(std::move(args));
+  tail.emplace_back(std::move(func));
+  m_node->tail = Tail(std::move(tail));
 }
 
 // Constructor for plots
-Expression::Expression(std::string type, const std::vector<Expression> & data) {
+Expression::Expression(std::string type, const std::vector<Expression> & data):
+  Expression(std::move(type), std::vector<Expression>(data))
+{}
+
+Expression::Expression(std::string type, std::vector<Expression> && data): m_node(new Node()) {
+
+  m_node->type = ExpType::Plot;
+  if(type == "DP" || type == "CP"){
+    Graphic g;
+    g.kind = GraphicKind::Plot;
+    g.fields = TypeField;
+    g.plot = PlotGraphic{type == "DP" ? PlotKind::Discrete : PlotKind::Continuous, 0, 0};
+    m_node->setGraphic(g);
+  }
+  else{
+    m_node->properties.set(TypeProperty, Expression(Atom(type)));
+  }
+  m_node->tail = Tail(std::move(data));
+  m_node->form = resolveForm(m_node->head, m_node->tail.empty());
+}
+
+// Constructors for unboxed numeric lists
+Expression::Expression(Reals values): m_node(new Node()) {
+  m_node->type = ExpType::List;
+  m_node->setTail(std::move(values));
+  m_node->form = resolveForm(m_node->head, m_node->reals.empty());
+}
+
+Expression::Expression(SharedSlice<std::complex<double>> values): m_node(new Node()) {
+  m_node->type = ExpType::List;
+  m_node->setTail(std::move(values));
+  m_node->form = resolveForm(m_node->head, m_node->complexes.empty());
+}
+
+bool Expression::isPlainNumber(const Expression & e, bool complex) noexcept{
+  const Atom & head = e.node().head;
+  return isPlainAtom(e) && (complex ? head.isComplex() : head.isNumber());
+}
+
+Expression Expression::packList(std::vector<Expression> && items){
+
+  if(items.empty() || (!items[0].head().isNumber() && !items[0].head().isComplex())){
+    return Expression(std::move(items));
+  }
+
+  bool complex = items[0].head().isComplex();
+  for(auto & e : items){
+    if(!isPlainNumber(e, complex)){
+      return Expression(std::move(items));
+    }
+  }
+
+  if(complex){
+    std::vector<std::complex<double>> values;
+    values.reserve(items.size());
+    for(auto & e : items){
+      values.push_back(e.head().asComplex());
+    }
+    return Expression(SharedSlice<std::complex<double>>(std::move(values)));
+  }
+
+  std::vector<double> values;
+  values.reserve(items.size());
+  for(auto & e : items){
+    values.push_back(e.head().asNumber());
+  }
+  return Expression(Reals(std::move(values)));
+}
 
-  m_type = ExpType::Plot;
-  m_properties["type"] = Expression(Atom(type));
-  m_tail = data;
+Expression::~Expression(){
+  release(m_node);
 }
 
 Expression & Expression::operator=(const Expression & a){
 
-  // prevent self-assignment
-  if(this != &a){
-      m_type = a.m_type;
-      m_head = a.m_head;
-      m_properties = a.m_properties;
-      m_tail.clear();
-      for(auto e : a.m_tail)
-        m_tail.push_back(e);
+  // share the node, releasing the old one last in case it owns a
+  Node * old = m_node;
+  m_node = a.m_node;
+  if(m_node){
+    m_node->refs.fetch_add(1, std::memory_order_relaxed);
   }
+  release(old);
+
+  return *this;
+}
+
+Expression & Expression::operator=(Expression && a) noexcept{
+
+  Node * old = m_node;
+  m_node = a.m_node;
+  a.m_node = nullptr;
+  release(old);
 
   return *this;
 }
 
 
 Atom & Expression::head(){
-  return m_head;
+  Node & n = mutableNode();
+  // the caller may change the head, re-resolve on the next eval
+  n.form = SpecialForm::Unresolved;
+  return n.head;
 }
 
 const Atom & Expression::head() const{
-  return m_head;
+  return node().head;
 }
 
 bool Expression::isNone() const noexcept {
-	return m_type == ExpType::Singleton;
+	return node().type == ExpType::Singleton;
 }
 
 bool Expression::isList() const noexcept {
-	return (m_type == ExpType::List);
+	return (node().type == ExpType::List);
 }
 
 bool Expression::isLambda() const noexcept {
-  return (m_type == ExpType::Lambda);
+  return (node().type == ExpType::Lambda);
 }
 
 bool Expression::isEmpty() const noexcept {
-  return m_type == ExpType::None;
+  return node().type == ExpType::None;
 }
 
 bool Expression::isDP() const noexcept {
 
-  std::string target = "type";
-  if (m_properties.find(target) != m_properties.end()) {
-    return m_properties.at(target) == Expression(Atom("DP"));
+  const Graphic & g = node().graphicFields();
+  if(g.kind == GraphicKind::Plot){
+    return g.plot.kind == PlotKind::Discrete;
   }
 
-  return m_type == ExpType::Plot;
+  const Expression * type = node().properties.find(TypeProperty);
+  if (type) {
+    return *type == Expression(Atom("DP"));
+  }
+
+  return node().type == ExpType::Plot;
 }
 
 bool Expression::isCP() const noexcept {
-  for(auto &p : m_properties){
-    if(p.first.compare("type")){
-      return p.second == Expression(Atom("CP"));
-    }
+
+  const Graphic & g = node().graphicFields();
+  if(g.kind == GraphicKind::Plot){
+    return g.plot.kind == PlotKind::Continuous;
   }
-  return false;
+
+  const Expression * type = node().properties.find(TypeProperty);
+  return type && *type == Expression(Atom("CP"));
 }
 
 void Expression::append(const Atom & a){
-  m_tail.emplace_back(a);
+  append(Expression(a));
+}
+
+void Expression::append(const Expression & item){
+  Node & n = mutableNode();
+  demote(n);
+  n.box();
+  n.tail.push_back(item);
+  n.form = resolveForm(n.head, false);
+}
+
+SpecialForm Expression::form() const noexcept{
+  const Node & n = node();
+  if(n.form == SpecialForm::Unresolved){
+    return resolveForm(n.head, n.size() == 0);
+  }
+  return n.form;
 }
 
 Expression * Expression::tail(){
   Expression * ptr = nullptr;
 
-  if(m_tail.size() > 0){
-    ptr = &m_tail.back();
+  if(tailLength() > 0){
+    Node & n = mutableNode();
+    demote(n);
+    n.box();
+    ptr = n.tail.mutableData() + n.tail.size() - 1;
   }
 
   return ptr;
 }
 
-std::vector<Expression> Expression::contents() const noexcept {
-  return m_tail;
+Expression::TailView Expression::tailView() const {
+  const Node & n = node();
+  if(n.storage != Node::Storage::Boxed){
+    return TailView(n.boxedItems());
+  }
+  return TailView(n.tail.data(), n.tail.size());
+}
+
+Expression Expression::item(std::size_t i) const{
+  return node().item(i);
+}
+
+bool Expression::isRealVector() const noexcept{
+  return node().storage == Node::Storage::Real;
+}
+
+bool Expression::isComplexVector() const noexcept{
+  return node().storage == Node::Storage::Complex;
+}
+
+const Expression::Reals & Expression::realItems() const noexcept{
+  static const Reals none;
+  return isRealVector() ? node().reals : none;
+}
+
+const SharedSlice<std::complex<double>> & Expression::complexItems() const noexcept{
+  static const SharedSlice<std::complex<double>> none;
+  return isComplexVector() ? node().complexes : none;
+}
+
+Expression Expression::makeList(Tail && items){
+
+  Expression result;
+  Node & n = result.mutableNode();
+  n.type = ExpType::List;
+  n.setTail(std::move(items));
+  n.form = resolveForm(n.head, n.tail.empty());
+  return result;
+}
+
+Expression Expression::listRest() const{
+
+  const Node & n = node();
+  switch(n.storage){
+    case Node::Storage::Real:
+      return Expression(n.reals.drop(1));
+    case Node::Storage::Complex:
+      return Expression(n.complexes.drop(1));
+    default:
+      return makeList(n.tail.drop(1));
+  }
+}
+
+Expression Expression::listAppend(const Expression & item) const{
+
+  const Node & n = node();
+  if(n.storage == Node::Storage::Real && isPlainNumber(item, false)){
+    return Expression(n.reals.append(item.head().asNumber()));
+  }
+  if(n.storage == Node::Storage::Complex && isPlainNumber(item, true)){
+    return Expression(n.complexes.append(item.head().asComplex()));
+  }
+  // an unboxed list gaining a non-number is boxed into the new list only
+  return makeList(n.boxedItems().append(item));
+}
+
+Expression Expression::listJoin(const Expression & other) const{
+
+  const Node & n = node();
+  const Node & o = other.node();
+  if(n.storage == Node::Storage::Real && o.storage == Node::Storage::Real){
+    return Expression(n.reals.append(o.reals.begin(), o.reals.end()));
+  }
+  if(n.storage == Node::Storage::Complex && o.storage == Node::Storage::Complex){
+    return Expression(n.complexes.append(o.complexes.begin(), o.complexes.end()));
+  }
+  Tail items = o.boxedItems();
+  return makeList(n.boxedItems().append(items.begin(), items.end()));
 }
 
 size_t Expression::tailLength() const noexcept{
-  return m_tail.size();
+  return node().size();
 }
 
-Expression::ConstIteratorType Expression::tailConstBegin() const noexcept{
-  return m_tail.cbegin();
+Expression::ConstIteratorType Expression::tailConstBegin() const{
+  const Node & n = node();
+  return n.storage == Node::Storage::Boxed ? n.tail.cbegin() : nullptr;
 }
 
-Expression::ConstIteratorType Expression::tailConstEnd() const noexcept{
-  return m_tail.cend();
+Expression::ConstIteratorType Expression::tailConstEnd() const{
+  const Node & n = node();
+  return n.storage == Node::Storage::Boxed ? n.tail.cend() : nullptr;
 }
 
-Expression apply(const Atom & op, const std::vector<Expression> & args, const Environment & env){
+const std::shared_ptr<const Chunk> & Expression::code() const noexcept{
+  return node().code;
+}
 
-  if ( env.get_exp(op).isLambda() ) {
-    Environment inner_scope = env;
+void Expression::setCode(const std::shared_ptr<const Chunk> & code) noexcept{
+  mutableNode().code = code;
+}
+
+const std::shared_ptr<const Environment> & Expression::closure() const noexcept{
+  return node().closure;
+}
 
-    Expression lambda = inner_scope.get_exp(op);
-    Expression arg_template = *lambda.tailConstBegin();
+void Expression::setClosure(const std::shared_ptr<const Environment> & scope) noexcept{
+  mutableNode().closure = scope;
+}
+
+void Expression::findClosures(std::vector<const Environment *> & found,
+                              std::unordered_set<const void *> & seen) const{
+
+  // in a loop rather than by recursion, as a list may be nested deeply
+  std::vector<const Node *> pending;
+  if(m_node){
+    pending.push_back(m_node);
+  }
+  while(!pending.empty()){
+    const Node * n = pending.back();
+    pending.pop_back();
+    if(!seen.insert(n).second){
+      continue;
+    }
+    if(n->closure){
+      found.push_back(n->closure.get());
+    }
+    if(n->storage == Node::Storage::Boxed){
+      for(const Expression & item : n->items()){
+        if(item.m_node) pending.push_back(item.m_node);
+      }
+    }
+    for(const auto & entry : n->properties){
+      if(entry.value.m_node) pending.push_back(entry.value.m_node);
+    }
+  }
+}
+
+std::size_t Expression::useCount() const noexcept{
+  return m_node ? m_node->refs.load(std::memory_order_acquire) : 0;
+}
+
+Expression apply(const Atom & op, Arguments args, const Environment & env){
+
+  Expression lambda = env.get_exp(op);
+  if ( lambda.isLambda() ) {
+
+    const Expression & arg_template = *lambda.tailConstBegin();
 
     if(args.size() != arg_template.tailLength()){
       throw SemanticError("Error: during apply: Error in call to procedure: invalid number of arguments.");
     }
 
+    // a fresh frame for the parameters, the globals are shared not copied
+    Environment inner_scope = env.callScope(lambda.closure().get());
+
     size_t count = 0;
     for(auto p = arg_template.tailConstBegin(); p != arg_template.tailConstEnd(); p++){
-      inner_scope.__shadowing_helper(p->head(), args[count++]);
+      inner_scope.add_exp(p->head(), args[count++]);
     }
 
-    return lambda.tail()->eval(inner_scope);
+    return lambda.tailConstBegin()[1].eval(inner_scope);
   }
 
   // head must be a symbol
@@ -172,12 +617,17 @@ Expression apply(const Atom & op, const std::vector<Expression> & args, const En
   return proc(args);
 }
 
-Expression Expression::handle_lookup(const Atom & head, const Environment & env){
+Expression Expression::handle_lookup(Environment & env) const{
 
+    const Atom & head = node().head;
     if(head.isSymbol()) { // if symbol is in env return value
       if(env.is_exp(head)) {
 	      return env.get_exp(head);
       }
+      else if(env.is_proc(head) && !env.get_proc(head).signature().accepts(0)) {
+	      // a call with no arguments to a procedure that needs some
+	      throw SemanticError(env.get_proc(head).signature().arityError);
+      }
       else {
 	      throw SemanticError("Error during handle lookup: unknown symbol " + head.asString());
       }
@@ -190,10 +640,10 @@ Expression Expression::handle_lookup(const Atom & head, const Environment & env)
     }
 }
 
-Expression Expression::handle_begin(Environment & env){
+Expression Expression::handle_begin(Environment & env) const{
 
   Expression result;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
+  for(auto it = node().items().cbegin(); it != node().items().cend(); ++it){
     result = it->eval(env);
   }
 
@@ -201,139 +651,147 @@ Expression Expression::handle_begin(Environment & env){
   return result;
 }
 
-Expression Expression::handle_define(Environment & env){
+Expression Expression::handle_define(Environment & env) const{
 
   // check expected tail size
-  if(m_tail.size() != 2){
+  if(node().items().size() != 2){
     throw SemanticError("Error during handle define: invalid number of arguments to define");
   }
 
   // tail[0] must be symbol
-  if(!m_tail[0].head().isSymbol()){
+  if(!node().items()[0].head().isSymbol()){
     throw SemanticError("Error during handle define: first argument to define not symbol");
   }
 
   // but tail[0] must not be a special-form or procedure
-  std::string s = m_tail[0].head().asSymbol();
-  if((s == "define") || (s == "begin") || (s == "lambda") || (s == "list")) {
+  SymbolId s = node().items()[0].head().symbolId();
+  if((s == DefineSymbol) || (s == BeginSymbol) || (s == LambdaSymbol) || (s == ListSymbol)) {
     throw SemanticError("Error during handle define: attempt to redefine a special-form");
   }
-  else if(env.is_proc(m_tail[0].head())) {
+  else if(env.is_fixed_proc(node().items()[0].head())) {
     throw SemanticError("Error during handle define: attempt to redefine a built-in procedure");
   }
-  else if((s=="pi"||(s=="e")||s=="I")) {
+  else if((s == PiSymbol) || (s == ESymbol) || (s == ISymbol)) {
     throw SemanticError("Error during handle define: attempt to redefine a built-in symbol");
   }
   else {
     // eval tail[1]
-    Expression result = m_tail[1].eval(env);
+    Expression result = node().items()[1].eval(env);
 
     //and add to env
-    env.add_exp(m_tail[0].head(), result);
+    env.add_exp(node().items()[0].head(), result);
 
     return result;
   }
 }
 
-Expression Expression::handle_list(Environment & env){
+Expression Expression::handle_list(Environment & env) const{
 
   std::vector<Expression> listItems;
-  for(auto e = m_tail.begin(); e != m_tail.end(); e++){
+  listItems.reserve(tailLength());
+  for(auto e = node().items().begin(); e != node().items().end(); e++){
     listItems.push_back(e->eval(env));
   }
 
-  return Expression(listItems);
+  return packList(std::move(listItems));
 }
 
-Expression Expression::handle_lambda(Environment & env) {
+Expression Expression::handle_lambda(Environment & env) const{
+
+  if(node().items().size() != 2){
+    throw SemanticError("Error during handle lambda: invalid number of arguments to lambda");
+  }
 
   std::vector<Expression> argument_template;
-  argument_template.emplace_back(Expression(m_tail[0].head()));
-  for(auto e = m_tail[0].tailConstBegin(); e!=m_tail[0].tailConstEnd(); e++){
+  argument_template.reserve(node().items()[0].tailLength() + 1);
+  argument_template.emplace_back(Expression(node().items()[0].head()));
+  for(auto e = node().items()[0].tailConstBegin(); e!=node().items()[0].tailConstEnd(); e++){
     argument_template.emplace_back(Expression(*e));
   }
 
-  Expression return_exp = Expression(argument_template, m_tail[1]);
+  Expression return_exp = Expression(std::move(argument_template), Expression(node().items()[1]));
+  if(!env.isGlobal()){
+    return_exp.setClosure(env.capture());
+  }
   return return_exp;
 }
 
-Expression Expression::handle_apply(Environment & env){
+Expression Expression::handle_apply(Environment & env) const{
 
-  if(m_tail.size() != 2){
+  if(node().items().size() != 2){
     throw SemanticError("Error during apply: invalid number of arguments");
   }
 
-  Atom op =  m_tail[0].head();
+  Atom op =  node().items()[0].head();
   if ( env.get_exp(op).isLambda() ) {
   }
   else {
-    if(!env.is_proc(op) || m_tail[0].tailLength() > 0){ 
+    if(!env.is_proc(op) || node().items()[0].tailLength() > 0){ 
       throw SemanticError("Error: first argument to apply not a procedure");
     }
   }
 
-  Expression arguments = m_tail[1].eval(env);
+  Expression arguments = node().items()[1].eval(env);
   if(!arguments.isList()){
     throw SemanticError("Error: second argument to apply not a list");
   }
 
+  // pass the items of a boxed list in place; only unboxed numbers are boxed
+  if(!arguments.isRealVector() && !arguments.isComplexVector()){
+    TailView items = arguments.tailView();
+    return apply(op, Arguments(items.begin(), items.size()), env);
+  }
+
   std::vector<Expression> list_args;
-  for(auto e = arguments.tailConstBegin(); e != arguments.tailConstEnd(); e++){
-    list_args.push_back(*e);
+  list_args.reserve(arguments.tailLength());
+  for(std::size_t i = 0; i < arguments.tailLength(); ++i){
+    list_args.push_back(arguments.item(i));
   }
 
   return apply(op, list_args, env);
 }
 
-Expression Expression::handle_map(Environment & env){
+Expression Expression::handle_map(Environment & env) const{
 
-  if(m_tail.size() != 2){
+  if(node().items().size() != 2){
     throw SemanticError("Error during map: invalid number of arguments");
   }
 
-  Atom op =  m_tail[0].head();
+  Atom op =  node().items()[0].head();
   if ( env.get_exp(op).isLambda() ) {
   }
   else {
-    if(!env.is_proc(op) || m_tail[0].tailLength() > 0){ 
+    if(!env.is_proc(op) || node().items()[0].tailLength() > 0){ 
       throw SemanticError("Error: first argument to map not a procedure");
     }
   }
 
 
-  Expression list_evaled = m_tail[1].eval(env);
+  Expression list_evaled = node().items()[1].eval(env);
   if(!list_evaled.isList()){
     throw SemanticError("Error: second argument to apply not a list");
   }
 
   std::vector<Expression> return_args;
-  std::vector<Expression> temp;
-  Expression temp_e;
-
-  for(auto e = list_evaled.tailConstBegin(); e != list_evaled.tailConstEnd(); e++){
-    temp.emplace_back(*e);
-    temp_e = apply(m_tail[0].head(), temp, env);
-    return_args.push_back(temp_e);
-    temp.clear();
+  return_args.reserve(list_evaled.tailLength());
+  for(std::size_t i = 0; i < list_evaled.tailLength(); ++i){
+    Expression item = list_evaled.item(i);
+    return_args.push_back(apply(node().items()[0].head(), Arguments(&item, 1), env));
   }
 
-  return Expression(return_args);
+  return packList(std::move(return_args));
 }
 
-Expression Expression::handle_set_property(Environment & env) {
+Expression Expression::handle_set_property(Environment & env) const{
 
   Expression result;
 
-   if(m_tail.size()==3) {
-    if(m_tail[0].head().isString()) {
+   if(node().items().size()==3) {
+    if(node().items()[0].head().isString()) {
 
-      result = m_tail[2].eval(env);
-      std::string key = m_tail[0].head().asString();
-      if(result.m_properties.find(key) != result.m_properties.end()){
-        result.m_properties.erase(key);
-      }
-      Expression value = m_tail[1].eval(env);
-      result.m_properties[key] = value;
+      result = node().items()[2].eval(env);
+      Expression value = node().items()[1].eval(env);
+      result.setProperty(node().items()[0].head().propertyKey(), value);
     }
     else{
       throw SemanticError("Error: first argument to set-property not a string.");
@@ -346,13 +804,12 @@ Expression Expression::handle_set_property(Environment & env) {
   return result;
 }
 
-Expression Expression::handle_get_property(Environment & env){
+Expression Expression::handle_get_property(Environment & env) const{
   Expression target, result;
-  if(m_tail.size()==2) {
-    target = m_tail[1].eval(env);
-    if(m_tail[0].head().isString()){
-      std::string key = m_tail[0].head().asString();
-      return target.__getProperty(key);
+  if(node().items().size()==2) {
+    target = node().items()[1].eval(env);
+    if(node().items()[0].head().isString()){
+      return target.property(node().items()[0].head().propertyKey());
     }
     else{
       throw SemanticError("Error: first argument to get-property not a string.");
@@ -363,22 +820,383 @@ Expression Expression::handle_get_property(Environment & env){
   }
 }
 
-Expression Expression::__getProperty(std::string key) const {
+/*
+A graphic keeps the properties that describe it in the typed fields of its
+Graphic rather than in the properties map, so building and drawing one
+never touches the map. property and setProperty translate: a value a field
+cannot hold exactly moves the graphic's fields back to the map, and setting
+a property on a list or string whose object-name describes a well-formed
+graphic moves its properties into fields.
+ */
+
+namespace {
+
+// a property that a Graphic of kind holds in field
+struct GraphicKey {
+  GraphicKind kind;
+  std::uint16_t field;
+  SymbolId key;
+};
+
+const GraphicKey GRAPHIC_KEYS[] = {
+  {GraphicKind::Point, NameField, ObjectNameProperty},
+  {GraphicKind::Point, SizeField, SizeProperty},
+  {GraphicKind::Line, NameField, ObjectNameProperty},
+  {GraphicKind::Line, ThicknessField, ThicknessProperty},
+  {GraphicKind::Text, NameField, ObjectNameProperty},
+  {GraphicKind::Text, PositionField, PositionProperty},
+  {GraphicKind::Text, ScaleField, TextScaleProperty},
+  {GraphicKind::Text, RotationField, TextRotationProperty},
+  {GraphicKind::Plot, TypeField, TypeProperty},
+  {GraphicKind::Plot, PointsField, NumPointsProperty},
+  {GraphicKind::Plot, OptionsField, NumOptionsProperty},
+};
+
+// the field holding property key of a graphic of kind, or 0
+std::uint16_t graphicField(GraphicKind kind, SymbolId key) noexcept {
+  if(kind == GraphicKind::None){
+    return 0;
+  }
+  for(const GraphicKey & k : GRAPHIC_KEYS){
+    if(k.kind == kind && k.key == key){
+      return k.field;
+    }
+  }
+  return 0;
+}
 
-  if(m_properties.find(key) != m_properties.end()){
-    return m_properties.at(key);
+// the property key of field, the same for every kind holding it
+SymbolId graphicKey(std::uint16_t field) noexcept {
+  for(const GraphicKey & k : GRAPHIC_KEYS){
+    if(k.field == field){
+      return k.key;
+    }
   }
-  return Expression();
+  return ObjectNameProperty;
+}
+
+// the object-name of a point, line or text
+const Expression & graphicName(GraphicKind kind){
+  static const Expression point(Atom("\"point\""));
+  static const Expression line(Atom("\"line\""));
+  static const Expression text(Atom("\"text\""));
+  switch(kind){
+    case GraphicKind::Point:
+      return point;
+    case GraphicKind::Line:
+      return line;
+    default:
+      return text;
+  }
+}
+
+}
+
+bool Expression::isPlainAtom(const Expression & e) noexcept{
+  const Node & n = e.node();
+  return n.type == ExpType::Singleton && n.size() == 0 && n.properties.empty() &&
+    n.graphicFields().kind == GraphicKind::None;
+}
+
+Expression Expression::graphicProperty(const Node & n, std::uint16_t field){
+
+  const Graphic & g = n.graphicFields();
+  if(!(g.fields & field)){
+    return Expression();
+  }
+
+  switch(field){
+    case NameField:
+      return graphicName(g.kind);
+    case SizeField:
+      return Expression(g.point.size);
+    case ThicknessField:
+      return Expression(g.line.thickness);
+    case PositionField:
+      {
+        Expression position = makePoint(g.text.position.x, g.text.position.y);
+        position.m_node->graphic->point.size = g.text.position.size;
+        return position;
+      }
+    case ScaleField:
+      return Expression(g.text.scale);
+    case RotationField:
+      return Expression(g.text.rotation);
+    case TypeField:
+      return Expression(Atom(g.plot.kind == PlotKind::Discrete ? "DP" : "CP"));
+    case PointsField:
+      return Expression(Atom(static_cast<double>(g.plot.numPoints)));
+    case OptionsField:
+      return Expression(Atom(static_cast<double>(g.plot.numOptions)));
+    default:
+      return Expression();
+  }
+}
+
+bool Expression::storeGraphicProperty(Graphic & graphic, std::uint16_t field, const Expression & value){
+
+  switch(field){
+    case NameField:
+      return isPlainAtom(value) && value.head() == graphicName(graphic.kind).head();
+    case TypeField:
+      if(isPlainAtom(value) && value.head().isSymbol() &&
+         (value.head().asSymbol() == "DP" || value.head().asSymbol() == "CP")){
+        graphic.plot.kind = value.head().asSymbol() == "DP" ? PlotKind::Discrete : PlotKind::Continuous;
+        return true;
+      }
+      return false;
+    case PositionField:
+      {
+        // a point with no other properties, which reads back the same
+        const Node & p = value.node();
+        if(p.graphicFields().kind != GraphicKind::Point || !(p.graphicFields().fields & SizeField) ||
+           !p.properties.empty()){
+          return false;
+        }
+        graphic.text.position = p.graphicFields().point;
+        return true;
+      }
+    default:
+      break;
+  }
+
+  if(!isPlainNumber(value, false)){
+    return false;
+  }
+  double x = value.head().asNumber();
+  switch(field){
+    case SizeField:
+      graphic.point.size = x;
+      return true;
+    case ThicknessField:
+      graphic.line.thickness = x;
+      return true;
+    case ScaleField:
+      graphic.text.scale = x;
+      return true;
+    case RotationField:
+      graphic.text.rotation = x;
+      return true;
+    case PointsField:
+    case OptionsField:
+      {
+        // counts only, which read back as the same number
+        if(!(x >= 0) || x != std::floor(x)){
+          return false;
+        }
+        std::size_t & count = (field == PointsField) ? graphic.plot.numPoints : graphic.plot.numOptions;
+        count = static_cast<std::size_t>(x);
+        return true;
+      }
+    default:
+      return false;
+  }
+}
+
+void Expression::demote(Node & n){
+
+  if(n.graphicFields().kind == GraphicKind::None){
+    return;
+  }
+  for(std::uint16_t field = NameField; field <= OptionsField; field <<= 1){
+    if(n.graphicFields().fields & field){
+      n.properties.set(graphicKey(field), graphicProperty(n, field));
+    }
+  }
+  n.graphic.reset();
+}
+
+void Expression::promote(Node & n){
+
+  const Expression * name = n.properties.find(ObjectNameProperty);
+  if(n.graphicFields().kind != GraphicKind::None || !name || !isPlainAtom(*name)){
+    return;
+  }
+
+  Graphic g;
+  for(GraphicKind kind : {GraphicKind::Point, GraphicKind::Line, GraphicKind::Text}){
+    if(name->head() == graphicName(kind).head()){
+      g.kind = kind;
+    }
+  }
+
+  // the shape of each kind, with the defaults of the fields not set
+  switch(g.kind){
+    case GraphicKind::Point:
+      if(n.type != ExpType::List || n.size() != 2 ||
+         !isPlainNumber(n.item(0), false) || !isPlainNumber(n.item(1), false)){
+        return;
+      }
+      g.point = PointGraphic{n.item(0).head().asNumber(), n.item(1).head().asNumber(), -1};
+      break;
+    case GraphicKind::Line:
+      if(n.type != ExpType::List || n.size() != 2 ||
+         n.item(0).graphic().kind != GraphicKind::Point || n.item(1).graphic().kind != GraphicKind::Point){
+        return;
+      }
+      g.line = LineGraphic{n.item(0).graphic().point, n.item(1).graphic().point, -1};
+      break;
+    case GraphicKind::Text:
+      if(n.type != ExpType::Singleton || n.size() != 0 || !n.head.isString()){
+        return;
+      }
+      g.text = TextGraphic{PointGraphic{0, 0, 0}, 1, 0};
+      break;
+    default:
+      return;
+  }
+  g.fields = NameField;
+
+  // every other property of the kind must fit its field
+  for(const GraphicKey & k : GRAPHIC_KEYS){
+    const Expression * p = n.properties.find(k.key);
+    if(k.kind != g.kind || k.field == NameField || !p){
+      continue;
+    }
+    if(!storeGraphicProperty(g, k.field, *p)){
+      return;
+    }
+    g.fields |= k.field;
+  }
+
+  for(const GraphicKey & k : GRAPHIC_KEYS){
+    if(k.kind == g.kind){
+      n.properties.erase(k.key);
+    }
+  }
+  n.setGraphic(g);
+}
+
+const Graphic & Expression::graphic() const noexcept{
+  return node().graphicFields();
+}
+
+bool Expression::hasProperty(const std::string & key) const{
+  return hasProperty(SymbolTable::intern(key));
+}
+
+bool Expression::hasProperty(SymbolId key) const noexcept{
+  const Node & n = node();
+  std::uint16_t field = graphicField(n.graphicFields().kind, key);
+  return field ? (n.graphicFields().fields & field) != 0 : n.properties.count(key);
+}
+
+Expression Expression::property(const std::string & key) const {
+  return property(SymbolTable::intern(key));
+}
+
+Expression Expression::property(SymbolId key) const {
+
+  const Node & n = node();
+  std::uint16_t field = graphicField(n.graphicFields().kind, key);
+  if(field){
+    return graphicProperty(n, field);
+  }
+
+  const Expression * result = n.properties.find(key);
+  return result ? *result : Expression();
+}
+
+void Expression::setProperty(const std::string & key, const Expression & value){
+  setProperty(SymbolTable::intern(key), value);
 }
 
-Expression Expression::handle_discrete_plot(Environment & env){
+void Expression::setProperty(SymbolId key, const Expression & value){
 
-  if(m_tail.size() != 2){
+  Node & n = mutableNode();
+  std::uint16_t field = graphicField(n.graphicFields().kind, key);
+  if(field){
+    if(storeGraphicProperty(*n.graphic, field, value)){
+      n.graphic->fields |= field;
+      return;
+    }
+    demote(n);
+  }
+
+  n.properties.set(key, value);
+  promote(n);
+}
+
+/*
+The graphics constructors build the same values as the make-point,
+make-line and make-text lambdas they replace, with their properties in
+typed fields.
+ */
+Expression Expression::makePoint(double x, double y){
+
+  const double xy[] = {x, y};
+  Expression point(Reals(xy, xy + 2));
+  Graphic g;
+  g.kind = GraphicKind::Point;
+  g.fields = NameField | SizeField;
+  g.point = PointGraphic{x, y, 0};
+  point.m_node->setGraphic(g);
+  return point;
+}
+
+Expression Expression::makePoint(const Expression & x, const Expression & y){
+
+  if(isPlainNumber(x, false) && isPlainNumber(y, false)){
+    return makePoint(x.head().asNumber(), y.head().asNumber());
+  }
+
+  // not a well-formed point, so its properties stay in the map
+  Expression point = packList(std::vector<Expression>{x, y});
+  point.setProperty(ObjectNameProperty, graphicName(GraphicKind::Point));
+  point.setProperty(SizeProperty, Expression(0.0));
+  return point;
+}
+
+Expression Expression::makeLine(const Expression & p1, const Expression & p2){
+
+  if(p1.graphic().kind == GraphicKind::Point && p2.graphic().kind == GraphicKind::Point){
+    const Expression ends[] = {p1, p2};
+    Expression line = makeList(Tail(ends, ends + 2));
+    Graphic g;
+    g.kind = GraphicKind::Line;
+    g.fields = NameField | ThicknessField;
+    g.line = LineGraphic{p1.graphic().point, p2.graphic().point, 1};
+    line.m_node->setGraphic(g);
+    return line;
+  }
+
+  // not a well-formed line, so its properties stay in the map
+  Expression line = packList(std::vector<Expression>{p1, p2});
+  line.setProperty(ObjectNameProperty, graphicName(GraphicKind::Line));
+  line.setProperty(ThicknessProperty, Expression(1.0));
+  return line;
+}
+
+Expression Expression::makeText(const Expression & str){
+
+  Expression text(str);
+  if(isPlainAtom(str) && str.head().isString()){
+    Graphic g;
+    g.kind = GraphicKind::Text;
+    g.fields = NameField | PositionField;
+    g.text = TextGraphic{PointGraphic{0, 0, 0}, 1, 0};
+    text.mutableNode().setGraphic(g);
+  }
+  else{
+    text.setProperty(ObjectNameProperty, graphicName(GraphicKind::Text));
+    text.setProperty(PositionProperty, makePoint(0, 0));
+  }
+  return text;
+}
+
+// the i-th coordinate of a data point, read in place from an unboxed point
+static double coordinate(const Expression & point, std::size_t i){
+  return point.isRealVector() ? point.realItems()[i] : point.item(i).head().asNumber();
+}
+
+Expression Expression::handle_discrete_plot(Environment & env) const{
+
+  if(node().items().size() != 2){
     throw SemanticError("Error: invalid number of arguments for discrete-plot");
   }
 
-  Expression DATA = m_tail[0].eval(env);
-  Expression OPTIONS = m_tail[1].eval(env);
+  Expression DATA = node().items()[0].eval(env);
+  Expression OPTIONS = node().items()[1].eval(env);
 
   if (! DATA.isList() || ! OPTIONS.isList() ) {
     throw SemanticError("Error: An argument to discrete-plot is not a list");
@@ -386,18 +1204,25 @@ Expression Expression::handle_discrete_plot(Environment & env){
   
   std::vector<Expression> result;
   size_t numpoints = DATA.tailLength();
+  result.reserve(2 * numpoints + 10 + OPTIONS.tailLength());
+
+  // Find the max and min values of x and y inside DATA, never inside
+  // the default box of -999 to 999
+  double xmax = -999, xmin = 999, ymax = -999, ymin = 999;
+  if(numpoints > 0){
+    std::vector<double> xs, ys;
+    xs.reserve(numpoints);
+    ys.reserve(numpoints);
+    for(std::size_t i = 0; i < numpoints; ++i){
+      Expression p = DATA.item(i);
+      xs.push_back(coordinate(p, 0));
+      ys.push_back(coordinate(p, 1));
+    }
 
-  // Find the max and min values of x and y inside DATA
-  double xmax = -999, xmin = 999, ymax = -999, ymin = 999, xval, yval;
-  for(auto & p : DATA.m_tail){
-
-    xval = p.m_tail[0].head().asNumber();
-    xmax = std::max(xval, xmax);
-    xmin = std::min(xval, xmin);
-
-    yval = p.m_tail[1].head().asNumber();
-    ymax = std::max(yval, ymax);
-    ymin = std::min(yval, ymin);
+    xmax = std::max(xmax, xs[vector_math::argmax(xs.data(), numpoints)]);
+    xmin = std::min(xmin, xs[vector_math::argmin(xs.data(), numpoints)]);
+    ymax = std::max(ymax, ys[vector_math::argmax(ys.data(), numpoints)]);
+    ymin = std::min(ymin, ys[vector_math::argmin(ys.data(), numpoints)]);
   }
 
   // Create scale factors using the max and min edges of the data
@@ -410,21 +1235,21 @@ Expression Expression::handle_discrete_plot(Environment & env){
 
   // Make an expression for each point of the bounding box
   Expression topLeft, topMid, topRight, midLeft, midMid, midRight, botLeft, botMid, botRight;
-  topLeft = apply(Atom("make-point"), {Expression(xmin), Expression(ymax)}, env);
-  topMid = apply(Atom("make-point"), {Expression(xmiddle), Expression(ymax)}, env);
-  topRight = apply(Atom("make-point"), {Expression(xmax), Expression(ymax)}, env);
-  midLeft = apply(Atom("make-point"), {Expression(xmin), Expression(ymiddle)}, env);
-  midMid = apply(Atom("make-point"), {Expression(xmiddle), Expression(ymiddle)}, env);
-  midRight = apply(Atom("make-point"), {Expression(xmax), Expression(ymiddle)}, env);
-  botLeft = apply(Atom("make-point"), {Expression(xmin), Expression(ymin)}, env);
-  botMid = apply(Atom("make-point"), {Expression(xmiddle), Expression(ymin)}, env);
-  botRight = apply(Atom("make-point"), {Expression(xmax), Expression(ymin)}, env);
+  topLeft = makePoint(xmin, ymax);
+  topMid = makePoint(xmiddle, ymax);
+  topRight = makePoint(xmax, ymax);
+  midLeft = makePoint(xmin, ymiddle);
+  midMid = makePoint(xmiddle, ymiddle);
+  midRight = makePoint(xmax, ymiddle);
+  botLeft = makePoint(xmin, ymin);
+  botMid = makePoint(xmiddle, ymin);
+  botRight = makePoint(xmax, ymin);
 
   // Make an expression to hold each line of the bounding rect 
-  Expression leftLine = apply(Atom("make-line"), {topLeft, botLeft}, env);
-  Expression rightLine = apply(Atom("make-line"), {topRight, botRight}, env);
-  Expression topLine = apply(Atom("make-line"), {topLeft, topRight}, env);
-  Expression botLine = apply(Atom("make-line"), {botLeft, botRight}, env);
+  Expression leftLine = makeLine(topLeft, botLeft);
+  Expression rightLine = makeLine(topRight, botRight);
+  Expression topLine = makeLine(topLeft, topRight);
+  Expression botLine = makeLine(botLeft, botRight);
   assert(leftLine.checkProperty("object-name", "line"));
 
   // Add bounding box lines to the resulting expression
@@ -440,8 +1265,8 @@ Expression Expression::handle_discrete_plot(Environment & env){
   result.push_back(Expression(Atom("\""+ std::to_string(OU) +"\"")));
 
   // Add each option to the output
-  for(auto &opt : OPTIONS.m_tail){
-    result.push_back(opt.m_tail[1]);
+  for(auto &opt : OPTIONS.tailView()){
+    result.push_back(opt.item(1));
   }
   size_t numoptions = OPTIONS.tailLength();
 
@@ -452,14 +1277,14 @@ Expression Expression::handle_discrete_plot(Environment & env){
   draw the stemlines down to the bottom line only */
   double stembottomy = std::max(0.0, ymin) * -1;
 
-  for(auto & point : DATA.m_tail){
-    double x = point.m_tail[0].head().asNumber();
-    double y = point.m_tail[1].head().asNumber() * -1;
+  for(auto & point : DATA.tailView()){
+    double x = coordinate(point, 0);
+    double y = coordinate(point, 1) * -1;
 
-    new_point = apply(Atom("make-point"), {Expression(x), Expression(y)}, env);
-    stem_bottom = apply(Atom("make-point"), {Expression(x), Expression(stembottomy)}, env);
+    new_point = makePoint(x, y);
+    stem_bottom = makePoint(x, stembottomy);
 
-    stemline = apply(Atom("make-line"), {new_point, stem_bottom}, env);
+    stemline = makeLine(new_point, stem_bottom);
     result.push_back(new_point);
     result.push_back(stemline);
   }
@@ -467,35 +1292,35 @@ Expression Expression::handle_discrete_plot(Environment & env){
   // Add draw axis lines if either zero line is within the boundaries
   if(0 < OU || 0 > OL){
     Expression xAxisStart, xAxisEnd, xaxis;
-    xAxisStart = apply(Atom("make-point"), {Expression(xmax), Expression(0.0)}, env);
-    xAxisEnd = apply(Atom("make-point"), {Expression(xmin), Expression(0.0)}, env);
-    xaxis = apply(Atom("make-line"), {xAxisStart, xAxisEnd}, env);
+    xAxisStart = makePoint(xmax, 0.0);
+    xAxisEnd = makePoint(xmin, 0.0);
+    xaxis = makeLine(xAxisStart, xAxisEnd);
     result.push_back(xaxis);
   }
 
   if(0 < AU || 0 > AL){
     Expression yAxisStart, yAxisEnd, yaxis;
-    yAxisStart = apply(Atom("make-point"), {Expression(0.0), Expression(ymax)}, env);
-    yAxisEnd = apply(Atom("make-point"), {Expression(0.0), Expression(ymin)}, env);
+    yAxisStart = makePoint(0.0, ymax);
+    yAxisEnd = makePoint(0.0, ymin);
 
-    yaxis = apply(Atom("make-line"), {yAxisStart, yAxisEnd}, env);
+    yaxis = makeLine(yAxisStart, yAxisEnd);
     result.push_back(yaxis);
   }
 
-  Expression dp = Expression("DP", result);
-  dp.m_properties["numpoints"] = Expression(Atom(numpoints));
-  dp.m_properties["numoptions"] = Expression(Atom(numoptions));
+  Expression dp = Expression("DP", std::move(result));
+  dp.setProperty(NumPointsProperty, Expression(Atom(static_cast<double>(numpoints))));
+  dp.setProperty(NumOptionsProperty, Expression(Atom(static_cast<double>(numoptions))));
   return dp;
 }
 
-Expression Expression::handle_cont_plot(Environment & env){
-  if(m_tail.size() != 2 && m_tail.size() != 3){
+Expression Expression::handle_cont_plot(Environment & env) const{
+  if(node().items().size() != 2 && node().items().size() != 3){
     throw SemanticError("Error: invalid number of arguments for continuous plot");
   }
 
   std::vector<Expression> result;
-  Expression FUNC = m_tail[0];
-  Expression BOUNDS = m_tail[1];
+  Expression FUNC = node().items()[0];
+  Expression BOUNDS = node().items()[1];
 
   if(!FUNC.eval(env).isLambda()) {
     throw SemanticError("Error: first argument to continuous plot not a lambda");
@@ -503,7 +1328,7 @@ Expression Expression::handle_cont_plot(Environment & env){
   if(!BOUNDS.eval(env).isList()){
     throw SemanticError("Error: second argument to continuous plot not a list");
   }
-  if(m_tail.size() == 3 && !m_tail[2].eval(env).isList()){
+  if(node().items().size() == 3 && !node().items()[2].eval(env).isList()){
     throw SemanticError("Error: third argument to continuous plot not a list");
   }
 
@@ -684,125 +1509,231 @@ Expression Expression::handle_cont_plot(Environment & env){
 
 sig_atomic_t global_status_flag = 0;
 
-Expression Expression::eval(Environment & env){
+const Expression::Handler Expression::FORM_HANDLERS[] = {
+  nullptr, // Unresolved, never dispatched
+  &Expression::handle_lookup,
+  &Expression::handle_call,
+  &Expression::handle_list,
+  &Expression::handle_begin,
+  &Expression::handle_define,
+  &Expression::handle_lambda,
+  &Expression::handle_apply,
+  &Expression::handle_map,
+  &Expression::handle_set_property,
+  &Expression::handle_get_property,
+  &Expression::handle_discrete_plot,
+  &Expression::handle_cont_plot
+};
+
+Expression Expression::eval(Environment & env) const{
+
+  static_assert(sizeof(FORM_HANDLERS) / sizeof(FORM_HANDLERS[0]) ==
+                static_cast<std::size_t>(SpecialForm::Count),
+                "FORM_HANDLERS out of step with SpecialForm");
 
   if(global_status_flag > 0){
     throw SemanticError("Error: interpreter kernal interupted");
   }
 
-  if (m_head.asSymbol() == "list") {
-    return handle_list(env);   
-  }
-  if(m_tail.empty()){
-    return handle_lookup(m_head, env);
-  }
-  if(m_head.asSymbol() == "begin"){
-    return handle_begin(env);
-  }
-  if(m_head.asSymbol() == "define"){
-    return handle_define(env);
-  }
-  if(m_head.asSymbol() == "lambda"){
-    return handle_lambda(env);
-  }
-  else if(m_head.asSymbol() == "apply"){
-    return handle_apply(env);
-  }
-  if(m_head.asSymbol() == "map"){
-    return handle_map(env);
-  }
-  if(m_head.asSymbol() == "set-property"){
-    return handle_set_property(env);
-  }
-  if(m_head.asSymbol() == "get-property"){
-    return handle_get_property(env);
-  }
-  if(m_head.asSymbol() == "discrete-plot"){
-    return handle_discrete_plot(env);
-  }
-  if(m_head.asSymbol() == "continuous-plot"){
-    return handle_cont_plot(env);
+  return (this->*FORM_HANDLERS[static_cast<std::size_t>(form())])(env);
+}
+
+// calls with at most this many arguments evaluate them into a buffer on the
+// stack, so passing them allocates nothing
+const std::size_t SMALL_CALL_ARGS = 8;
+
+Expression Expression::handle_call(Environment & env) const{
+
+  const Tail & items = node().items();
+  if(items.size() <= SMALL_CALL_ARGS){
+    Expression results[SMALL_CALL_ARGS];
+    for(std::size_t i = 0; i < items.size(); ++i){
+      results[i] = items[i].eval(env);
+    }
+    return apply(node().head, Arguments(results, items.size()), env);
   }
 
   std::vector<Expression> results;
-  for(Expression::IteratorType it = m_tail.begin(); it != m_tail.end(); ++it){
+  results.reserve(items.size());
+  for(auto it = items.cbegin(); it != items.cend(); ++it){
     results.push_back(it->eval(env));
   } 
-  return apply(m_head, results, env);
+  return apply(node().head, results, env);
 }
 
 std::ostream & operator<<(std::ostream & out, const Expression & exp){
 
-  if(exp.isEmpty()){
+  // print the opening of e, returning true if its items and closing follow
+  auto open = [&out](const Expression & e){
+    if(e.isEmpty()){
       out << "NONE";
-  }
-  else {
-    if(!exp.head().isComplex()) {
+      return false;
+    }
+    if(!e.head().isComplex()){
       out << "(";
     }
-
-    if (exp.isNone()) {
-      out << exp.head().asString();
+    if(e.isNone()){
+      out << e.head().asString();
+    }
+    return true;
+  };
+  auto close = [&out](const Expression & e){
+    if(!e.head().isComplex()){
+      out << ")";
+    }
+  };
+
+  // the expressions whose items are being printed, innermost last, kept
+  // here rather than on the call stack so nesting is limited only by memory
+  struct Open {
+    const Expression * exp;
+    std::size_t next;
+  };
+  std::vector<Open> stack;
+
+  if(open(exp)){
+    stack.push_back(Open{&exp, 0});
+  }
+  while(!stack.empty()){
+    const Expression & e = *stack.back().exp;
+    std::size_t i = stack.back().next++;
+    if(i == e.tailLength()){
+      close(e);
+      stack.pop_back();
+      continue;
     }
 
-    for(auto e = exp.tailConstBegin(); e != exp.tailConstEnd(); ++e){
-      out << *e;
-      if((e + 1) != exp.tailConstEnd()){
-        out << " ";
-      }
+    if(i > 0){
+      out << " ";
     }
-    if(!exp.head().isComplex()) {
-      out << ")";
+    if(e.isRealVector() || e.isComplexVector()){
+      // index rather than iterate, so unboxed lists print without boxing;
+      // their items are numbers, which have no items of their own
+      Expression item = e.item(i);
+      open(item);
+      close(item);
+    }
+    else{
+      const Expression & item = e.tailView()[i];
+      if(open(item)){
+        stack.push_back(Open{&item, 0});
+      }
     }
   }
   return out;
 }
 
-bool Expression::operator==(const Expression & exp) const noexcept{
+bool Expression::matchNodes(const Node & left, const Node & right, bool & descend) noexcept{
 
-  bool result = (m_head == exp.m_head);
+  descend = false;
+  if(!(left.head == right.head) || left.size() != right.size()){
+    return false;
+  }
 
-  result = result && (m_tail.size() == exp.m_tail.size());
+  if(left.storage == Node::Storage::Boxed && right.storage == Node::Storage::Boxed){
+    descend = (left.size() > 0);
+    return true;
+  }
 
-  if(result){
-    for(auto lefte = m_tail.begin(), righte = exp.m_tail.begin();
-	(lefte != m_tail.end()) && (righte != exp.m_tail.end());
-	++lefte, ++righte){
-      result = result && (*lefte == *righte);
+  bool result = true;
+  if(left.storage == Node::Storage::Real && right.storage == Node::Storage::Real){
+    for(std::size_t i = 0; result && i < left.reals.size(); ++i){
+      result = (Atom(left.reals[i]) == Atom(right.reals[i]));
+    }
+  }
+  else{
+    // mixed storage compares item by item, as if both were boxed; one side
+    // is numbers, so this is never more than one level deep
+    for(std::size_t i = 0; result && i < left.size(); ++i){
+      result = (left.item(i) == right.item(i));
     }
   }
-
   return result;
 }
 
+bool Expression::operator==(const Expression & exp) const noexcept{
+
+  // copies share a node
+  if(m_node == exp.m_node){
+    return true;
+  }
+
+  bool descend;
+  if(!matchNodes(node(), exp.node(), descend)){
+    return false;
+  }
+
+  // pairs of boxed nodes whose items are being compared, innermost last,
+  // kept here rather than on the call stack
+  struct Pair {
+    const Node * left;
+    const Node * right;
+    std::size_t next;
+  };
+  std::vector<Pair> stack;
+  if(descend){
+    stack.push_back(Pair{&node(), &exp.node(), 0});
+  }
+
+  while(!stack.empty()){
+    Pair & p = stack.back();
+    if(p.next == p.left->tail.size()){
+      stack.pop_back();
+      continue;
+    }
+
+    const Expression & lefte = p.left->tail[p.next];
+    const Expression & righte = p.right->tail[p.next];
+    ++p.next;
+    if(lefte.m_node == righte.m_node){
+      continue;
+    }
+    if(!matchNodes(lefte.node(), righte.node(), descend)){
+      return false;
+    }
+    if(descend){
+      stack.push_back(Pair{&lefte.node(), &righte.node(), 0});
+    }
+  }
+  return true;
+}
+
 bool operator!=(const Expression & left, const Expression & right) noexcept{
 
   return !(left == right);
 }
 
 bool Expression::checkProperty(std::string key, std::string value) const noexcept {
-  std::string left = "\"" + key + "\"";
   std::string right = "\"" + value + "\"";
-  return __getProperty(left) == Expression(Atom(right));
+  return property(SymbolTable::intern("\"" + key + "\"")) == Expression(Atom(right));
 }
 
 std::tuple<double, double, double, double> Expression::getTextProperties() const noexcept{
+
+  const Graphic & g = node().graphicFields();
+  if(g.kind == GraphicKind::Text){
+    if(!(g.fields & PositionField)){
+      return std::make_tuple(0., 0., 1., 0.);
+    }
+    return std::make_tuple(g.text.position.x, g.text.position.y, std::max(g.text.scale, 1.), g.text.rotation);
+  }
+
   double x, y;
   double sf = 1, rot = 0;
 
-  if(m_properties.find("\"text-scale\"") != m_properties.end()) {
-    sf = m_properties.at("\"text-scale\"").head().asNumber();
+  const PropertyList<Expression> & properties = node().properties;
+  if(const Expression * scale = properties.find(TextScaleProperty)) {
+    sf = scale->head().asNumber();
     if(sf < 1)
       sf = 1;
   }
 
-  if(m_properties.find("\"text-rotation\"") != m_properties.end()) {
-    rot = m_properties.at("\"text-rotation\"").head().asNumber();
+  if(const Expression * rotation = properties.find(TextRotationProperty)) {
+    rot = rotation->head().asNumber();
   }
 
-  if(m_properties.find("\"position\"") != m_properties.end()){
-    Expression point = m_properties.at("\"position\"");
-    std::vector<Expression> cor = point.contents();
+  if(const Expression * position = properties.find(PositionProperty)){
+    TailView cor = position->tailView();
     x = cor[0].head().asNumber();
     y = cor[1].head().asNumber();
     return {x, y, sf, rot};
@@ -814,31 +1745,31 @@ std::tuple<double, double, double, double> Expression::getTextProperties() const
 
 double Expression::getNumericalProperty(std::string prop) const noexcept {
   double size_value = -1;
-  if(m_properties.find(prop) != m_properties.end()){
-    Expression point_size = m_properties.at(prop);
-    size_value = point_size.head().asNumber();
+  SymbolId key = SymbolTable::intern(prop);
+  if(hasProperty(key)){
+    size_value = property(key).head().asNumber();
   }
   return size_value;
 }
 
 void Expression::setLineThickness(double val) noexcept{
-  if(m_properties.find("\"thickness\"")!=m_properties.end()){
-    m_properties["\"thickness\""] = Expression(Atom(val));
+  if(hasProperty(ThicknessProperty)){
+    setProperty(ThicknessProperty, Expression(Atom(val)));
   }
 }
 
 void Expression::setPointSize(double uWu) noexcept{
-  if(m_properties.find("\"size\"")!=m_properties.end()){
-    m_properties["\"size\""] = Expression(uWu);
+  if(hasProperty(SizeProperty)){
+    setProperty(SizeProperty, Expression(uWu));
   }
 }
 
 void Expression::setTextPosition(Expression point, double rot) noexcept{
-  if(m_properties.find("\"position\"")!=m_properties.end()){
+  if(hasProperty(PositionProperty)){
     assert(point.checkProperty("object-name", "point"));
-    m_properties["\"position\""] = point;
+    setProperty(PositionProperty, point);
   }
-  if(m_properties.find("\"text-rotation\"")!=m_properties.end()){
-    m_properties["\"text-rotation\""] = Expression(rot * std::atan(1)*4 / 180);
+  if(hasProperty(TextRotationProperty)){
+    setProperty(TextRotationProperty, Expression(rot * std::atan(1)*4 / 180));
   }
 }
@@ -4,13 +4,22 @@ Defines the Expression type and assiciated functions.
 #ifndef EXPRESSION_HPP
 #define EXPRESSION_HPP
 
+#include <complex>
+#include <cstdint>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "token.hpp"
 #include "atom.hpp"
+#include "special_forms.hpp"
+#include "shared_slice.hpp"
+#include "property_list.hpp"
+#include "graphic.hpp"
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <utility>
 #include <algorithm>
 #include <iostream>
@@ -23,16 +32,34 @@ extern sig_atomic_t global_status_flag;
 // forward declare Environment
 class Environment;
 
+// forward declare Chunk (see bytecode.hpp)
+class Chunk;
+
 /*! \class Expression
 \brief An expression is a tree of Atoms.
 
 An expression is an atom called the head followed by a (possibly empty)
 list of expressions called the tail.
+
+Expressions are values backed by shared, reference-counted nodes: copying
+one is constant time, and the mutators copy a node that is shared before
+changing it (copy-on-write), so no copy ever observes another's changes.
+Comparing, printing and destroying an expression keep their own stacks
+rather than recursing, so its depth is limited only by memory.
+
+A list whose items are all plain real (or all plain complex) numbers may
+store them unboxed, as a contiguous array of doubles; it behaves exactly
+like the same list of Expressions.
  */
 class Expression {
 public:
 
-  typedef std::vector<Expression>::const_iterator ConstIteratorType;
+  typedef const Expression * ConstIteratorType;
+
+  /// the storage of an unboxed list of reals; two, a point, fit in the node
+  typedef SharedSlice<double, 2> Reals;
+
+  class TailView;
 
   /// Default construct and Expression, whose type in NoneType
   Expression();
@@ -42,21 +69,58 @@ public:
   */
   Expression(const Atom & a);
 
-  /// deep-copy construct an expression (recursive)
-  Expression(const Expression & a);
+  /// copy construct an expression, sharing its node (constant time)
+  Expression(const Expression & a) noexcept;
+
+  /// move construct an expression, leaving a empty
+  Expression(Expression && a) noexcept;
 
   /// constructor for list
   Expression(const std::vector<Expression> & listItems);
 
+  /// constructor for list, taking the items without copying them
+  Expression(std::vector<Expression> && listItems);
+
+  /// construct the expression with head a and tail items, as appending each would
+  Expression(const Atom & a, std::vector<Expression> && items);
+
+  /// construct the expression with head a, moving the items in [first, last) into its tail
+  Expression(const Atom & a, Expression * first, Expression * last);
+
   /// constructor for lambda functions
-  Expression(const std::vector<Expression> & args, Expression & func);
+  Expression(const std::vector<Expression> & args, const Expression & func);
+
+  /// constructor for lambda functions, taking the arguments without copying them
+  Expression(std::vector<Expression> && args, Expression && func);
 
   /// Constructor for plots
   Expression(std::string type, const std::vector<Expression> & back);
 
-  /// deep-copy assign an expression  (recursive)
+  /// Constructor for plots, taking the items without copying them
+  Expression(std::string type, std::vector<Expression> && back);
+
+  /// constructor for a list of real numbers, stored unboxed
+  explicit Expression(Reals values);
+
+  /// constructor for a list of complex numbers, stored unboxed
+  explicit Expression(SharedSlice<std::complex<double>> values);
+
+  /*! Construct a list, storing the items unboxed when they are all plain
+    real numbers, or all plain complex numbers.
+    \param items the items of the list
+    \return the list, which compares and prints the same either way
+  */
+  static Expression packList(std::vector<Expression> && items);
+
+  /// release this expression's node
+  ~Expression();
+
+  /// copy assign an expression, sharing its node (constant time)
   Expression & operator=(const Expression & a);
 
+  /// move assign an expression, leaving a empty
+  Expression & operator=(Expression && a) noexcept;
+
   /// return a reference to the head Atom
   Atom & head();
 
@@ -66,20 +130,52 @@ public:
   /// append Atom to tail of the expression
   void append(const Atom & a);
 
+  /// append an expression to the tail, sharing its node
+  void append(const Expression & item);
+
   /// return a pointer to the last expression in the tail, or nullptr
   Expression * tail();
 
-  /// return a vector of the items in the Expression's tail
-  std::vector<Expression> contents() const noexcept;
+  /// return a view of the items in the Expression's tail, without copying
+  /// them unless they are unboxed numbers, which the view boxes and owns
+  TailView tailView() const;
+
+  /// return the i-th item in the tail, unchecked, without boxing an unboxed list
+  Expression item(std::size_t i) const;
+
+  /// member which determines if the expression is a list of unboxed real numbers
+  bool isRealVector() const noexcept;
+
+  /// member which determines if the expression is a list of unboxed complex numbers
+  bool isComplexVector() const noexcept;
+
+  /// return the numbers of a real vector, or an empty slice
+  const Reals & realItems() const noexcept;
+
+  /// return the numbers of a complex vector, or an empty slice
+  const SharedSlice<std::complex<double>> & complexItems() const noexcept;
+
+  /// return a list of all but the first item in the tail, sharing its storage
+  Expression listRest() const;
+
+  /// return a list of the items in the tail followed by item, sharing their
+  /// storage; copies them if this list was already extended (see SharedSlice)
+  Expression listAppend(const Expression & item) const;
+
+  /// return a list of the items in the tail followed by those of other;
+  /// copies them too if this list was already extended
+  Expression listJoin(const Expression & other) const;
 
   /// return the number of items in the tail vector
   size_t tailLength() const noexcept;
 
-  /// return a const-iterator to the beginning of tail
-  ConstIteratorType tailConstBegin() const noexcept;
+  /// return a const-iterator to the beginning of a boxed tail; an unboxed
+  /// list has no Expressions to point to, so its range is empty: use
+  /// tailView or item for it
+  ConstIteratorType tailConstBegin() const;
 
-  /// return a const-iterator to the tail end
-  ConstIteratorType tailConstEnd() const noexcept;
+  /// return a const-iterator to the end of a boxed tail
+  ConstIteratorType tailConstEnd() const;
 
   /// member when determines if the expression has no type
   bool isNone() const noexcept;
@@ -100,20 +196,78 @@ public:
   bool isCP() const noexcept;
 
   /// Evaluate expression using a post-order traversal (recursive)
-  Expression eval(Environment & env);
+  Expression eval(Environment & env) const;
+
+  /// the tag eval dispatches this node on
+  SpecialForm form() const noexcept;
 
-  /// equality comparison for two expressions (recursive)
+  /// equality comparison for two expressions, of any depth
   bool operator==(const Expression & exp) const noexcept;
 
+  /// return the compiled body of a Lambda, or nullptr if it has none
+  const std::shared_ptr<const Chunk> & code() const noexcept;
+
+  /// attach a compiled body to a Lambda
+  void setCode(const std::shared_ptr<const Chunk> & code) noexcept;
+
+  /// return the local bindings a Lambda closed over, or nullptr if it has none
+  const std::shared_ptr<const Environment> & closure() const noexcept;
+
+  /// attach the local bindings a Lambda closes over
+  void setClosure(const std::shared_ptr<const Environment> & scope) noexcept;
+
+  /*! Find the closures of the Lambdas reachable from this expression
+    through list items and properties.
+    \param found the closures are appended here
+    \param seen the nodes already searched, which are skipped; the nodes
+    searched now are added
+   */
+  void findClosures(std::vector<const Environment *> & found,
+                    std::unordered_set<const void *> & seen) const;
+
+  /// return the number of Expressions sharing this one's node, 0 if it has none
+  std::size_t useCount() const noexcept;
+
+  /// return the property stored under key, or the empty Expression
+  Expression property(const std::string & key) const;
+
+  /// return the property stored under the interned key, or the empty Expression
+  Expression property(SymbolId key) const;
+
+  /// store value as the property key, replacing any previous value
+  void setProperty(const std::string & key, const Expression & value);
+
+  /// store value as the property with the interned key
+  void setProperty(SymbolId key, const Expression & value);
+
+  /// true if the property key has been set
+  bool hasProperty(const std::string & key) const;
+
+  /// true if the property with the interned key has been set
+  bool hasProperty(SymbolId key) const noexcept;
+
+  /// return the plain data of a point, line, text or plot; its kind is None
+  /// for any other Expression
+  const Graphic & graphic() const noexcept;
+
+  /// construct a point at (x, y), as the make-point procedure does
+  static Expression makePoint(double x, double y);
+
+  /// construct a point of any two Expressions, as the make-point procedure does
+  static Expression makePoint(const Expression & x, const Expression & y);
+
+  /// construct a line from point p1 to point p2, as the make-line procedure does
+  static Expression makeLine(const Expression & p1, const Expression & p2);
+
+  /// construct text showing str at the origin, as the make-text procedure does
+  static Expression makeText(const Expression & str);
+
   /// helper methods for output widget
   bool checkProperty(std::string key, std::string value) const noexcept;
   double getNumericalProperty(std::string) const noexcept;
   std::tuple<double, double, double, double> getTextProperties() const noexcept;
-  Atom getProperty(std::string p) {
-    if (m_properties.find(p) != m_properties.end()) {
-      return m_properties.at(p).head();
-    }
-    return Atom();
+  Atom getProperty(std::string p) const {
+    return property(p).head();
   };
 
   void setLineThickness(double ) noexcept;
@@ -122,44 +276,182 @@ public:
 
 private:
 
-  // the head of the expression
-  Atom m_head;
-
-  std::vector<Expression> m_tail;
-
   // state variable of the expression
   enum class ExpType {None, Singleton, List, Lambda, Graphic, Plot};
-  ExpType m_type;
-
-  // list of the expression's properties
-  std::map<std::string, Expression> m_properties;
-
-  // convenience typedef
-  typedef std::vector<Expression>::iterator IteratorType;
-
-  // internal helper methods
-  Expression handle_lookup(const Atom & head, const Environment & env);
-  Expression handle_define(Environment & env);
-  Expression handle_begin(Environment & env);
-  Expression handle_list(Environment & env);
-  Expression handle_lambda(Environment & env);
-  Expression handle_apply(Environment & env);
-  Expression handle_map(Environment & env);
-  Expression handle_set_property(Environment & env);
-  Expression handle_get_property(Environment & env);
-  Expression handle_discrete_plot(Environment & env);
-  Expression handle_cont_plot(Environment & env);
-
-  /* Returns the matching Expression from the interal properties map
-  or the empty Expression if not found
-  @param key The string to search for */
-  Expression __getProperty(std::string key) const ;
+
+  // the items of a node: most nodes have at most three, which are held in
+  // the node itself, and longer tails are shared buffers
+  typedef SharedSlice<Expression, 3> Tail;
+
+  // The contents of an Expression, shared by every copy of it. A Node is
+  // only changed while a single Expression refers to it.
+  struct Node {
+    std::atomic<std::size_t> refs;
+
+    // the head of the expression
+    Atom head;
+
+    ExpType type;
+
+    // how eval handles this node, resolved from the head and tail when they
+    // change so dispatch never inspects the head's name
+    SpecialForm form;
+
+    // how the items of the tail are stored: as Expressions in tail, or as
+    // unboxed numbers in reals or complexes
+    enum class Storage : std::uint8_t {Boxed, Real, Complex};
+    Storage storage;
+
+    // the items, shared with the lists this one was built from by rest,
+    // append or join; storage says which member is live
+    union {
+      Tail tail;
+      Reals reals;
+      SharedSlice<std::complex<double>> complexes;
+    };
+
+    // the typed fields of a graphic, null unless the expression is one, so
+    // only graphics pay for them; the properties they hold are never also in
+    // the properties map
+    std::unique_ptr<Graphic> graphic;
+
+    // the expression's properties, by interned key; null if it has none
+    PropertyList<Expression> properties;
+
+    // compiled body, set for Lambdas created by the bytecode compiler
+    std::shared_ptr<const Chunk> code;
+
+    // the call scope a Lambda created inside a call was defined in; Lambdas
+    // created at global scope have none and see the caller's globals
+    std::shared_ptr<const Environment> closure;
+
+    Node();
+    Node(const Node & a);
+    ~Node();
+
+    // the number of items in the tail
+    std::size_t size() const noexcept;
+
+    // the i-th item of the tail
+    Expression item(std::size_t i) const;
+
+    // the items of a boxed tail, which every node of a program has
+    const Tail & items() const noexcept;
+
+    // the items of the tail as Expressions, sharing them if they are boxed
+    // and boxing them into a new slice if not
+    Tail boxedItems() const;
+
+    // replace the tail with items, stored as given
+    void setTail(Tail && items) noexcept;
+    void setTail(Reals && values) noexcept;
+    void setTail(SharedSlice<std::complex<double>> && values) noexcept;
+
+    // convert an unboxed tail to Expressions in place
+    void box();
+
+    // the typed fields of the graphic, or a Graphic of kind None
+    const Graphic & graphicFields() const noexcept;
+
+    // set the typed fields, dropping them if g is of kind None
+    void setGraphic(const Graphic & g);
+  };
+
+  // the shared node, nullptr for the empty Expression
+  Node * m_node;
+
+  // the node to read, never null
+  const Node & node() const noexcept;
+
+  // the node to write, copied first if it is shared
+  Node & mutableNode();
+
+  // construct a list whose tail is items
+  static Expression makeList(Tail && items);
+
+  // true if e is a bare atom, with no tail, properties or graphic fields
+  static bool isPlainAtom(const Expression & e) noexcept;
+
+  // true if e is a bare real (or complex) number, which unboxes without loss
+  static bool isPlainNumber(const Expression & e, bool complex) noexcept;
+
+  // the value of the graphic property field of n, or the empty Expression
+  static Expression graphicProperty(const Node & n, std::uint16_t field);
+
+  // store value in the field of graphic, if it can hold it exactly
+  static bool storeGraphicProperty(Graphic & graphic, std::uint16_t field, const Expression & value);
+
+  // move the typed fields of n into its properties map, leaving it untyped
+  static void demote(Node & n);
+
+  // move the properties of n into typed fields, if they describe a graphic
+  static void promote(Node & n);
+
+  // drop one reference to node, deleting it with the last
+  static void release(Node * node) noexcept;
+
+  // true if two nodes have equal heads and sizes, and equal items unless
+  // both are boxed; descend is set if their boxed items remain to compare
+  static bool matchNodes(const Node & left, const Node & right, bool & descend) noexcept;
+
+  // internal helper methods, one per SpecialForm
+  Expression handle_lookup(Environment & env) const;
+  Expression handle_call(Environment & env) const;
+  Expression handle_define(Environment & env) const;
+  Expression handle_begin(Environment & env) const;
+  Expression handle_list(Environment & env) const;
+  Expression handle_lambda(Environment & env) const;
+  Expression handle_apply(Environment & env) const;
+  Expression handle_map(Environment & env) const;
+  Expression handle_set_property(Environment & env) const;
+  Expression handle_get_property(Environment & env) const;
+  Expression handle_discrete_plot(Environment & env) const;
+  Expression handle_cont_plot(Environment & env) const;
+
+  // jump table of the helpers above, indexed by SpecialForm
+  typedef Expression (Expression::*Handler)(Environment & env) const;
+  static const Handler FORM_HANDLERS[];
+};
+
+/*! \class Expression::TailView
+\brief A read-only view of the tail of an Expression.
+
+A view of a boxed tail points into it, and is valid while the Expression it
+came from, or a copy of it, is alive and unchanged. A view of an unboxed
+tail holds the items boxed for it, and is valid while the view is.
+ */
+class Expression::TailView {
+public:
+
+  typedef const Expression * ConstIteratorType;
+
+  /// construct a view of the size items starting at first
+  TailView(const Expression * first, std::size_t size) noexcept: m_first(first), m_size(size) {}
+
+  /// construct a view owning items
+  explicit TailView(Tail && items) noexcept: m_items(std::move(items)), m_first(nullptr), m_size(m_items.size()) {}
+
+  ConstIteratorType begin() const noexcept { return m_first ? m_first : m_items.data(); }
+  ConstIteratorType end() const noexcept { return begin() + m_size; }
+
+  std::size_t size() const noexcept { return m_size; }
+  bool empty() const noexcept { return m_size == 0; }
+
+  /// return the i-th item, unchecked
+  const Expression & operator[](std::size_t i) const noexcept { return begin()[i]; }
+
+private:
+  // the items of an unboxed tail, boxed for this view; read through
+  // m_items rather than a pointer, as inline items move with the view
+  Tail m_items;
+  const Expression * m_first;
+  std::size_t m_size;
 };
 
 /// Render expression to output stream
 std::ostream & operator<<(std::ostream & out, const Expression & exp);
 
-/// inequality comparison for two expressions (recursive)
+/// inequality comparison for two expressions
 bool operator!=(const Expression & left, const Expression & right) noexcept;
 
 #endif
@@ -0,0 +1,333 @@
+#include "bench.hpp"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "bytecode.hpp"
+#include "expression.hpp"
+#include "interpreter.hpp"
+#include "parse.hpp"
+#include "syntax_tree.hpp"
+#include "vm.hpp"
+
+// the special-form test chain Expression::eval used before tags were cached
+static int string_chain_dispatch(const Expression & exp){
+
+  const Atom & head = exp.head();
+  if(head.asSymbol() == "list") return 1;
+  if(exp.tailLength() == 0) return 2;
+  if(head.asSymbol() == "begin") return 3;
+  if(head.asSymbol() == "define") return 4;
+  if(head.asSymbol() == "lambda") return 5;
+  if(head.asSymbol() == "apply") return 6;
+  if(head.asSymbol() == "map") return 7;
+  if(head.asSymbol() == "set-property") return 8;
+  if(head.asSymbol() == "get-property") return 9;
+  if(head.asSymbol() == "discrete-plot") return 10;
+  if(head.asSymbol() == "continuous-plot") return 11;
+  return 0;
+}
+
+static Expression parse_program(const std::string & program){
+  std::istringstream iss(program);
+  return parse(tokenize(iss));
+}
+
+static void special_form_dispatch(){
+
+  // a procedure call is the worst case for the chain: every test fails
+  Expression call = parse_program("(+ a b)");
+  Expression define = parse_program("(define a b)");
+  const std::size_t N = 2000000;
+
+  int sum = 0;
+  bench::report("string chain, procedure call",
+                bench::time_ns(N, [&](){ sum += string_chain_dispatch(call); }));
+  bench::report("string chain, define",
+                bench::time_ns(N, [&](){ sum += string_chain_dispatch(define); }));
+  bench::report("cached tag, procedure call",
+                bench::time_ns(N, [&](){ sum += static_cast<int>(call.form()); }));
+  bench::report("cached tag, define",
+                bench::time_ns(N, [&](){ sum += static_cast<int>(define.form()); }));
+  bench::keep(&sum);
+}
+BENCHMARK(special_form_dispatch, "special-form dispatch");
+
+static void evaluate_call(){
+
+  const std::size_t N = 200000;
+  std::string program = "(+ (* 2 3) (- 10 4) (/ 8 2))";
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    Interpreter interp;
+    interp.setEvaluationMode(mode);
+    std::istringstream iss(program);
+    interp.parseStream(iss);
+
+    double ns = bench::time_ns(N, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    bench::report(mode == Interpreter::TreeWalk ? "tree-walk" : "bytecode", ns, program);
+  }
+}
+BENCHMARK(evaluate_call, "evaluate nested arithmetic");
+
+static void lookup_large_list(){
+
+  const std::size_t N = 2000;
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    Interpreter interp;
+    interp.setEvaluationMode(mode);
+    std::istringstream define("(define big (range 0 100000))");
+    interp.parseStream(define);
+    interp.evaluate();
+
+    std::istringstream lookup("(big)");
+    interp.parseStream(lookup);
+
+    double ns = bench::time_ns(N, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    bench::report(mode == Interpreter::TreeWalk ? "tree-walk" : "bytecode", ns, "100001 items");
+  }
+}
+BENCHMARK(lookup_large_list, "look up a large list");
+
+static void numeric_list_storage(){
+
+  const std::size_t items = 100000;
+  const std::size_t N = 50;
+
+  std::vector<double> values(items);
+  for(std::size_t i = 0; i < items; ++i){
+    values[i] = static_cast<double>(i);
+  }
+
+  // the same numbers as one Expression node each, and unboxed
+  std::vector<Expression> exps(values.begin(), values.end());
+  Expression boxed(exps);
+  Expression unboxed{Expression::Reals(std::vector<double>(values))};
+
+  bench::report("build boxed", bench::time_ns(N, [&](){
+    Expression list(std::vector<Expression>(values.begin(), values.end()));
+    bench::keep(&list);
+  }), "100000 items");
+  bench::report("build unboxed", bench::time_ns(N, [&](){
+    Expression list{Expression::Reals(std::vector<double>(values))};
+    bench::keep(&list);
+  }), "100000 items");
+
+  double sum = 0;
+  bench::report("sum boxed", bench::time_ns(N, [&](){
+    for(auto & e : boxed.tailView()){
+      sum += e.head().asNumber();
+    }
+  }), "100000 items");
+  bench::report("sum unboxed", bench::time_ns(N, [&](){
+    for(double x : unboxed.realItems()){
+      sum += x;
+    }
+  }), "100000 items");
+  bench::keep(&sum);
+}
+BENCHMARK(numeric_list_storage, "numeric list storage");
+
+static void discrete_plot(){
+
+  const std::size_t N = 10;
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    Interpreter interp;
+    interp.setEvaluationMode(mode);
+    std::istringstream setup("(begin (define f (lambda (x) (list x (* 2 x)))) (define data (map f (range 0 99999))))");
+    interp.parseStream(setup);
+    interp.evaluate();
+
+    std::istringstream plot("(discrete-plot data (list (list \"title\" \"The Title\")))");
+    interp.parseStream(plot);
+    double ns = bench::time_ns(N, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    bench::report(mode == Interpreter::TreeWalk ? "tree-walk" : "bytecode", ns, "100000 points");
+  }
+}
+BENCHMARK(discrete_plot, "discrete-plot");
+
+static void property_lookup(){
+
+  const std::size_t N = 1000000;
+
+  Expression e(Atom(1.0));
+  e.setProperty("\"color\"", Expression(Atom("\"red\"")));
+  e.setProperty("\"label\"", Expression(Atom("\"a point\"")));
+  e.setProperty("\"weight\"", Expression(Atom(2.0)));
+  SymbolId key = SymbolTable::intern("\"label\"");
+
+  double ns = bench::time_ns(N, [&](){
+    Expression value = e.property(key);
+    bench::keep(&value);
+  });
+  bench::report("interned key", ns, "3 properties");
+
+  ns = bench::time_ns(N, [&](){
+    Expression value = e.property("\"label\"");
+    bench::keep(&value);
+  });
+  bench::report("string key", ns, "3 properties");
+}
+BENCHMARK(property_lookup, "property lookup");
+
+// operator== before it kept its own stack: one call per level
+static bool equal_recursive(const Expression & left, const Expression & right){
+
+  if(!(left.head() == right.head()) || left.tailLength() != right.tailLength()){
+    return false;
+  }
+  for(std::size_t i = 0; i < left.tailLength(); ++i){
+    if(!equal_recursive(left.item(i), right.item(i))){
+      return false;
+    }
+  }
+  return true;
+}
+
+// operator<< before it kept its own stack: one call per level
+static void print_recursive(std::ostream & out, const Expression & exp){
+
+  if(exp.isEmpty()){
+    out << "NONE";
+    return;
+  }
+  if(!exp.head().isComplex()){
+    out << "(";
+  }
+  if(exp.isNone()){
+    out << exp.head().asString();
+  }
+  for(std::size_t i = 0; i < exp.tailLength(); ++i){
+    if(i > 0){
+      out << " ";
+    }
+    print_recursive(out, exp.item(i));
+  }
+  if(!exp.head().isComplex()){
+    out << ")";
+  }
+}
+
+// a tree of the given depth whose nodes each have width items
+static Expression tree(std::size_t depth, std::size_t width){
+
+  const Atom f("f");
+  std::vector<Expression> level(width, Expression(Atom(1.)));
+  for(std::size_t d = 0; d < depth; ++d){
+    std::vector<Expression> next;
+    for(std::size_t i = 0; i < width; ++i){
+      next.push_back(Expression(f, std::vector<Expression>(level)));
+    }
+    level = std::move(next);
+  }
+  return Expression(f, std::move(level));
+}
+
+static void deep_expressions(){
+
+  const std::size_t N = 20;
+
+  // the recursive versions need a depth the call stack can hold
+  struct Shape {
+    std::size_t depth, width;
+    const char * note;
+  };
+  for(const Shape & shape : {Shape{10000, 1, "10000 deep"}, Shape{4, 10, "4 deep, 10 wide"}}){
+    Expression left = tree(shape.depth, shape.width);
+    Expression right = tree(shape.depth, shape.width);
+
+    bool same = false;
+    bench::report("compare, recursive", bench::time_ns(N, [&](){
+      same = equal_recursive(left, right);
+    }), shape.note);
+    bench::report("compare, own stack", bench::time_ns(N, [&](){
+      same = (left == right);
+    }), shape.note);
+    bench::keep(&same);
+
+    bench::report("print, recursive", bench::time_ns(N, [&](){
+      std::ostringstream os;
+      print_recursive(os, left);
+      bench::keep(&os);
+    }), shape.note);
+    bench::report("print, own stack", bench::time_ns(N, [&](){
+      std::ostringstream os;
+      os << left;
+      bench::keep(&os);
+    }), shape.note);
+  }
+
+  const std::size_t depth = 1000000;
+  std::vector<Expression> trees;
+  for(std::size_t i = 0; i < 3; ++i){
+    trees.push_back(tree(depth, 1));
+  }
+  bench::report("destroy", bench::time_ns(trees.size(), [&](){
+    trees.pop_back();
+  }), "1000000 deep");
+}
+BENCHMARK(deep_expressions, "deep expressions");
+
+static void tail_allocations(){
+
+  // allocations per node when parsing to Expressions
+  struct Script {
+    std::string program;
+    const char * note;
+  };
+  std::string code = "(begin";
+  std::string data = "(begin (define data (list";
+  for(int i = 0; i < 10000; ++i){
+    std::string n = std::to_string(i);
+    code += " (define v" + n + " (+ (* " + n + " 2) (- " + n + " 1)))";
+    data += " (list " + n + " " + n + ")";
+  }
+  code += ")";
+  data += ")))";
+
+  for(const Script & script : {Script{code, "definitions"}, Script{data, "data points"}}){
+    TokenViewSequenceType tokens = tokenize(script.program.data(), script.program.data() + script.program.size());
+    SyntaxTree tree = parseTree(tokens);
+
+    std::size_t before = bench::allocations();
+    Expression exp;
+    double ns = bench::time_ns(1, [&](){ exp = tree.toExpression(); });
+    double per = static_cast<double>(bench::allocations() - before) / tree.size();
+    bench::report("syntax tree to Expression", ns,
+                  std::string(script.note) + ", " + std::to_string(per).substr(0, 4) + " allocations a node");
+  }
+
+  // allocations per call of a lambda returning a short list, when evaluating
+  const std::size_t calls = 10000;
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    Interpreter interp;
+    interp.setEvaluationMode(mode);
+    std::istringstream setup("(define f (lambda (x) (list x (* 2 x))))");
+    interp.parseStream(setup);
+    interp.evaluate();
+    std::istringstream program("(map f (range 1 10000))");
+    interp.parseStream(program);
+
+    std::size_t before = bench::allocations();
+    double ns = bench::time_ns(1, [&](){
+      Expression result = interp.evaluate();
+      bench::keep(&result);
+    });
+    double per = static_cast<double>(bench::allocations() - before) / calls;
+    bench::report(mode == Interpreter::TreeWalk ? "tree-walk" : "bytecode", ns,
+                  "(map f ...), " + std::to_string(per).substr(0, 4) + " allocations a call of f");
+  }
+}
+BENCHMARK(tail_allocations, "tail allocations");
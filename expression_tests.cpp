@@ -1,5 +1,7 @@
 #include "catch.hpp"
 #include "expression.hpp"
+#include "parse.hpp"
+#include <sstream>
 
 TEST_CASE( "Test default expression", "[expression]" ) {
 
@@ -77,3 +79,381 @@ TEST_CASE( "Test constructor plots", "[expression]") {
   REQUIRE(a.isDP());
 }
 
+TEST_CASE( "Test graphics constructors", "[expression]") {
+  Expression point = Expression::makePoint(1, -2);
+  REQUIRE(point == Expression(std::vector<Expression>{Expression(1.), Expression(-2.)}));
+  REQUIRE(point.checkProperty("object-name", "point"));
+  REQUIRE(point.getNumericalProperty("\"size\"") == 0);
+
+  Expression line = Expression::makeLine(point, Expression::makePoint(3, 4));
+  REQUIRE(line.tailLength() == 2);
+  REQUIRE(line.item(0) == point);
+  REQUIRE(line.checkProperty("object-name", "line"));
+  REQUIRE(line.getNumericalProperty("\"thickness\"") == 1);
+
+  Expression text = Expression::makeText(Expression(Atom("\"label\"")));
+  REQUIRE(text.head() == Atom("\"label\""));
+  REQUIRE(text.checkProperty("object-name", "text"));
+  REQUIRE(text.property("\"position\"") == Expression::makePoint(0, 0));
+
+  // graphics share their property values but never each other's changes
+  Expression other = Expression::makePoint(5, 6);
+  point.setPointSize(3);
+  REQUIRE(other.getNumericalProperty("\"size\"") == 0);
+}
+
+TEST_CASE( "Test graphics keep their properties in typed fields", "[expression]") {
+  Expression point = Expression::makePoint(1, -2);
+  REQUIRE(point.graphic().kind == GraphicKind::Point);
+  REQUIRE(point.graphic().point.x == 1);
+  REQUIRE(point.graphic().point.y == -2);
+  REQUIRE(point.graphic().point.size == 0);
+
+  INFO("setting a typed property updates the field");
+  point.setProperty("\"size\"", Expression(4.));
+  REQUIRE(point.graphic().point.size == 4);
+  REQUIRE(point.property("\"size\"") == Expression(4.));
+
+  INFO("other properties sit alongside the fields");
+  point.setProperty("\"color\"", Expression(Atom("\"red\"")));
+  REQUIRE(point.graphic().kind == GraphicKind::Point);
+  REQUIRE(point.property("\"color\"") == Expression(Atom("\"red\"")));
+
+  INFO("a value no field can hold moves the fields back to the map");
+  Expression big = point;
+  big.setProperty("\"size\"", Expression(Atom("\"big\"")));
+  REQUIRE(big.graphic().kind == GraphicKind::None);
+  REQUIRE(big.property("\"size\"") == Expression(Atom("\"big\"")));
+  REQUIRE(big.checkProperty("object-name", "point"));
+  REQUIRE(point.graphic().point.size == 4);
+
+  INFO("and a valid value moves them back into fields");
+  big.setProperty("\"size\"", Expression(2.));
+  REQUIRE(big.graphic().kind == GraphicKind::Point);
+  REQUIRE(big.graphic().point.size == 2);
+  REQUIRE(big.property("\"color\"") == Expression(Atom("\"red\"")));
+
+  INFO("a list named as a point becomes one");
+  Expression list(std::vector<Expression>{Expression(3.), Expression(4.)});
+  list.setProperty("\"object-name\"", Expression(Atom("\"point\"")));
+  REQUIRE(list.graphic().kind == GraphicKind::Point);
+  REQUIRE(list.getNumericalProperty("\"size\"") == -1);
+  list.setProperty("\"object-name\"", Expression(Atom("\"line\"")));
+  REQUIRE(list.graphic().kind == GraphicKind::None);
+  REQUIRE(list.checkProperty("object-name", "line"));
+
+  INFO("lines and text copy the plain data of their points");
+  Expression line = Expression::makeLine(Expression::makePoint(0, 1), point);
+  REQUIRE(line.graphic().kind == GraphicKind::Line);
+  REQUIRE(line.graphic().line.p1.y == 1);
+  REQUIRE(line.graphic().line.p2.size == 4);
+  REQUIRE(line.graphic().line.thickness == 1);
+
+  Expression text = Expression::makeText(Expression(Atom("\"label\"")));
+  text.setProperty("\"position\"", Expression::makePoint(1, -2));
+  text.setProperty("\"text-scale\"", Expression(0.5));
+  REQUIRE(text.graphic().kind == GraphicKind::Text);
+  REQUIRE(text.graphic().text.position.x == 1);
+  REQUIRE(text.getTextProperties() == std::make_tuple(1., -2., 1., 0.));
+  REQUIRE(text.property("\"text-scale\"") == Expression(0.5));
+  REQUIRE(!text.hasProperty("\"text-rotation\""));
+  text.setProperty("\"position\"", point);
+  REQUIRE(text.graphic().kind == GraphicKind::None);
+  REQUIRE(text.property("\"position\"") == point);
+
+  INFO("plots are typed by their kind");
+  Expression dp("DP", std::vector<Expression>{});
+  Expression cp("CP", std::vector<Expression>{});
+  REQUIRE(dp.isDP());
+  REQUIRE(!dp.isCP());
+  REQUIRE(cp.isCP());
+  REQUIRE(!cp.isDP());
+  REQUIRE(dp.property("type") == Expression(Atom("DP")));
+  dp.setProperty("numpoints", Expression(12.));
+  REQUIRE(dp.graphic().plot.numPoints == 12);
+  REQUIRE(dp.getProperty("numpoints") == Atom(12.));
+}
+
+
+TEST_CASE( "Test special form resolution", "[expression]") {
+
+  Expression leaf(Atom("x"));
+  REQUIRE(leaf.form() == SpecialForm::Lookup);
+
+  Expression emptyList(Atom("list"));
+  REQUIRE(emptyList.form() == SpecialForm::List);
+
+  Expression call(Atom("+"));
+  call.append(Atom(1.0));
+  REQUIRE(call.form() == SpecialForm::Call);
+
+  Expression define(Atom("define"));
+  define.append(Atom("x"));
+  define.append(Atom(1.0));
+  REQUIRE(define.form() == SpecialForm::Define);
+
+  // changing the head re-resolves the node
+  define.head() = Atom("map");
+  REQUIRE(define.form() == SpecialForm::Map);
+
+  // strings never name special forms
+  Expression quoted(Atom("\"begin\""));
+  quoted.append(Atom(1.0));
+  REQUIRE(quoted.form() == SpecialForm::Call);
+}
+
+TEST_CASE( "Test copies share nodes until written", "[expression]") {
+
+  Expression original(Atom("+"));
+  original.append(Atom(1.0));
+  original.append(Atom(2.0));
+  original.setProperty("\"size\"", Expression(1.0));
+
+  // a copy refers to the same tail
+  Expression copy = original;
+  REQUIRE(copy == original);
+  REQUIRE(&*copy.tailConstBegin() == &*original.tailConstBegin());
+
+  // writing to the copy leaves the original alone
+  copy.append(Atom(3.0));
+  copy.head() = Atom("-");
+  copy.setProperty("\"size\"", Expression(2.0));
+  REQUIRE(original.tailLength() == 2);
+  REQUIRE(original.head() == Atom("+"));
+  REQUIRE(original.property("\"size\"") == Expression(1.0));
+  REQUIRE(copy.tailLength() == 3);
+  REQUIRE(copy.head() == Atom("-"));
+  REQUIRE(copy.property("\"size\"") == Expression(2.0));
+
+  // and so does writing to the original
+  Expression other = original;
+  original.tail()->head() = Atom(5.0);
+  REQUIRE(*other.tailConstBegin() == Expression(1.0));
+  REQUIRE(*(original.tailConstEnd() - 1) == Expression(5.0));
+
+  // an empty Expression can be copied and written to
+  Expression empty;
+  Expression empty_copy = empty;
+  empty_copy.append(Atom(1.0));
+  REQUIRE(empty.isEmpty());
+  REQUIRE(empty.tailLength() == 0);
+  REQUIRE(empty_copy.tailLength() == 1);
+}
+
+TEST_CASE( "Test moves and tail views", "[expression]") {
+
+  Expression inner(std::vector<Expression>{Expression(1.)});
+  std::vector<Expression> items = {inner, Expression(2.), Expression(3.)};
+  const Expression * inner_item = &*inner.tailConstBegin();
+
+  // the rvalue constructor takes the items without copying them
+  Expression list(std::move(items));
+  REQUIRE(list.isList());
+  REQUIRE(list.tailLength() == 3);
+  REQUIRE(&*list.tailConstBegin()->tailConstBegin() == inner_item);
+  const Expression * first_item = &*list.tailConstBegin();
+
+  Expression::TailView view = list.tailView();
+  REQUIRE(view.size() == 3);
+  REQUIRE(!view.empty());
+  REQUIRE(view[1] == Expression(2.));
+  REQUIRE(&view[0] == first_item);
+
+  double sum = 0;
+  for(auto & e : view){
+    sum += e.head().asNumber();
+  }
+  REQUIRE(sum == 5.);
+
+  // moving leaves the source empty
+  Expression moved(std::move(list));
+  REQUIRE(list.isEmpty());
+  REQUIRE(moved.tailLength() == 3);
+  REQUIRE(&moved.tailView()[0] == first_item);
+
+  Expression assigned;
+  assigned = std::move(moved);
+  REQUIRE(moved.isEmpty());
+  REQUIRE(assigned.tailLength() == 3);
+
+  // a node can be replaced by one of its own children
+  assigned = std::move(*assigned.tail());
+  REQUIRE(assigned == Expression(3.));
+
+  REQUIRE(Expression().tailView().empty());
+
+  std::vector<Expression> args = {Expression(Atom("x"))};
+  Expression lambda(std::move(args), Expression(Atom("x")));
+  REQUIRE(lambda.isLambda());
+  REQUIRE(lambda.tailView()[0].isList());
+}
+
+TEST_CASE( "Test unboxed numeric lists", "[expression]") {
+
+  Expression reals = Expression::packList({Expression(1.), Expression(2.), Expression(3.)});
+  REQUIRE(reals.isList());
+  REQUIRE(reals.isRealVector());
+  REQUIRE(!reals.isComplexVector());
+  REQUIRE(reals.realItems().size() == 3);
+  REQUIRE(reals.realItems()[2] == 3.);
+  REQUIRE(reals.tailLength() == 3);
+  REQUIRE(reals.item(1) == Expression(2.));
+
+  // an unboxed list compares and prints like the boxed one
+  Expression boxed(std::vector<Expression>{Expression(1.), Expression(2.), Expression(3.)});
+  REQUIRE(!boxed.isRealVector());
+  REQUIRE(reals == boxed);
+  REQUIRE(boxed == reals);
+  REQUIRE(reals != Expression::packList({Expression(1.), Expression(2.)}));
+  std::ostringstream left, right;
+  left << reals;
+  right << boxed;
+  REQUIRE(left.str() == right.str());
+
+  // iterating boxes the items on demand, without changing the list
+  double sum = 0;
+  for(auto & e : reals.tailView()){
+    sum += e.head().asNumber();
+  }
+  REQUIRE(sum == 6.);
+  REQUIRE(reals.isRealVector());
+
+  // the boxed items belong to the view, and move with it
+  Expression::TailView view = reals.tailView();
+  Expression::TailView copied = view;
+  REQUIRE(copied.size() == 3);
+  REQUIRE(copied[2] == Expression(3.));
+  REQUIRE(reals.tailConstBegin() == reals.tailConstEnd());
+  REQUIRE(boxed.realItems().empty());
+
+  // rest, append and join stay unboxed while the items are numbers
+  REQUIRE(reals.listRest().isRealVector());
+  REQUIRE(reals.listRest() == Expression::packList({Expression(2.), Expression(3.)}));
+  REQUIRE(reals.listAppend(Expression(4.)).isRealVector());
+  REQUIRE(reals.listJoin(reals).isRealVector());
+  REQUIRE(reals.listJoin(reals).tailLength() == 6);
+
+  // anything else falls back to a boxed list
+  Expression mixed = reals.listAppend(Expression(Atom("a")));
+  REQUIRE(!mixed.isRealVector());
+  REQUIRE(mixed.tailLength() == 4);
+  REQUIRE(mixed.item(3) == Expression(Atom("a")));
+  REQUIRE(!reals.listJoin(boxed).isRealVector());
+  REQUIRE(reals.listJoin(boxed).tailLength() == 6);
+
+  Expression tagged(1.);
+  tagged.setProperty("note", Expression(Atom("\"x\"")));
+  REQUIRE(!Expression::packList({Expression(1.), tagged}).isRealVector());
+  REQUIRE(!Expression::packList({Expression(1.), reals}).isRealVector());
+  REQUIRE(!Expression::packList({}).isRealVector());
+
+  Expression complexes = Expression::packList({Expression(std::complex<double>(1., 2.)),
+                                               Expression(std::complex<double>(0., 1.))});
+  REQUIRE(complexes.isComplexVector());
+  REQUIRE(complexes.complexItems()[1] == std::complex<double>(0., 1.));
+  REQUIRE(complexes.item(0) == Expression(std::complex<double>(1., 2.)));
+  REQUIRE(!Expression::packList({Expression(1.), Expression(std::complex<double>(0., 1.))}).isComplexVector());
+
+  // writing through the tail converts a copy to boxed storage
+  Expression copy = reals;
+  *copy.tail() = Expression(Atom("z"));
+  REQUIRE(reals.isRealVector());
+  REQUIRE(reals.item(2) == Expression(3.));
+  REQUIRE(copy.item(2) == Expression(Atom("z")));
+  copy = reals;
+  copy.append(Atom(4.));
+  REQUIRE(copy.tailLength() == 4);
+  REQUIRE(reals.tailLength() == 3);
+}
+
+TEST_CASE( "Test tails behave the same held in the node or in a buffer", "[expression]") {
+
+  Expression exp(Atom("f"));
+  for(int i = 0; i < 6; ++i){
+    exp.append(Atom(static_cast<double>(i)));
+    REQUIRE(exp.tailLength() == static_cast<std::size_t>(i + 1));
+    REQUIRE(*exp.tail() == Expression(static_cast<double>(i)));
+
+    double sum = 0;
+    for(const Expression & e : exp.tailView()){
+      sum += e.head().asNumber();
+    }
+    REQUIRE(sum == i * (i + 1) / 2);
+  }
+
+  Expression copy = exp;
+  *copy.tail() = Expression(Atom("z"));
+  REQUIRE(*exp.tail() == Expression(5.));
+  REQUIRE(copy.item(5) == Expression(Atom("z")));
+
+  Expression three(std::vector<Expression>{Expression(1.), Expression(2.), Expression(3.)});
+  Expression first = three;
+  *first.tail() = Expression(4.);
+  REQUIRE(three.item(2) == Expression(3.));
+  REQUIRE(first.listRest() == Expression(std::vector<Expression>{Expression(2.), Expression(4.)}));
+  REQUIRE(three.listAppend(Expression(5.)).tailLength() == 4);
+  REQUIRE(three.tailLength() == 3);
+}
+
+// (f (f (f ... (leaf)))), depth levels deep
+static Expression nested(std::size_t depth, const Expression & leaf){
+
+  const Atom f("f");
+  Expression exp = leaf;
+  for(std::size_t i = 0; i < depth; ++i){
+    std::vector<Expression> items;
+    items.push_back(std::move(exp));
+    exp = Expression(f, std::move(items));
+  }
+  return exp;
+}
+
+TEST_CASE( "Test expressions nested a million deep", "[expression]") {
+
+  const std::size_t depth = 1000000;
+
+  Expression deep = nested(depth, Expression(Atom("x")));
+
+  INFO("printing");
+  std::ostringstream os;
+  os << deep;
+  std::string text = os.str();
+  REQUIRE(text.size() == depth * std::string("(f)").size() + std::string("(x)").size());
+  REQUIRE(text.compare(0, 7, "(f(f(f(") == 0);
+  REQUIRE(text.compare(depth * 2, 6, "(x))))") == 0);
+  REQUIRE(text.back() == ')');
+
+  INFO("comparison, with the printed text parsed back to an equal expression");
+  Expression same = parse(tokenize(text.data(), text.data() + text.size()));
+  REQUIRE(deep == same);
+  REQUIRE(deep != nested(depth, Expression(Atom("y"))));
+  Expression numbers = nested(depth / 10, Expression::packList({Expression(1.), Expression(2.)}));
+  REQUIRE(numbers == nested(depth / 10, Expression(std::vector<Expression>{Expression(1.), Expression(2.)})));
+  REQUIRE(numbers != deep);
+
+  INFO("copying shares the tree, and a write copies only the root");
+  Expression copy = deep;
+  REQUIRE(copy == deep);
+  copy.head() = Atom("g");
+  REQUIRE(copy != deep);
+  REQUIRE(deep == same);
+
+  INFO("destruction");
+  deep = Expression();
+  same = Expression();
+  REQUIRE(copy.tailLength() == 1);
+  copy = Expression();
+  REQUIRE(copy.isEmpty());
+
+  INFO("a long list of nested lists");
+  std::vector<Expression> items, rebuilt;
+  for(std::size_t i = 0; i < 100; ++i){
+    items.push_back(nested(1000, Expression(static_cast<double>(i))));
+    rebuilt.push_back(nested(1000, Expression(static_cast<double>(i))));
+  }
+  rebuilt.back() = nested(1000, Expression(-1.));
+  Expression wide(std::move(items));
+  REQUIRE(wide != Expression(rebuilt));
+  rebuilt.back() = nested(1000, Expression(99.));
+  REQUIRE(wide == Expression(std::move(rebuilt)));
+}
@@ -0,0 +1,184 @@
+#include "form_reader.hpp"
+
+#include <cstring>
+
+namespace {
+
+// the characters the tokenizer treats as spaces
+bool isBlank(char c) noexcept {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+}
+
+const std::size_t FormReader::DEFAULT_BLOCK;
+
+FormReader::FormReader(std::istream & input, std::size_t block):
+  m_input(&input), m_block(block ? block : 1), m_first(nullptr), m_last(nullptr),
+  m_start(0), m_scan(0), m_state(Between), m_resume(Between), m_depth(0) {}
+
+FormReader::FormReader(const char * first, const char * last) noexcept:
+  m_input(nullptr), m_block(0), m_first(first), m_last(last),
+  m_start(0), m_scan(0), m_state(Between), m_resume(Between), m_depth(0) {}
+
+const char * FormReader::text() const noexcept{
+  return m_input ? m_text.data() : m_first;
+}
+
+std::size_t FormReader::size() const noexcept{
+  return m_input ? m_text.size() : static_cast<std::size_t>(m_last - m_first);
+}
+
+std::size_t FormReader::buffered() const noexcept{
+  return m_text.size();
+}
+
+bool FormReader::next(const char *& first, const char *& last){
+
+  while(!scan()){
+    if(!fill()){
+      if(m_state == Between || (m_state == Comment && m_resume == Between)){
+        return false;
+      }
+
+      // the input ended inside an item, which runs to the end
+      m_state = Between;
+      m_scan = size();
+      break;
+    }
+  }
+
+  first = text() + m_start;
+  last = text() + m_scan;
+  m_start = m_scan;
+  return true;
+}
+
+bool FormReader::scan() noexcept{
+
+  const char * t = text();
+  const std::size_t n = size();
+
+  while(m_scan < n){
+    char c = t[m_scan];
+
+    switch(m_state){
+      case Between:
+        if(isBlank(c)){
+          m_start = ++m_scan;
+        }
+        else if(c == ';'){
+          m_resume = Between;
+          m_state = Comment;
+        }
+        else{
+          m_start = m_scan++;
+          if(c == '('){
+            m_state = Form;
+            m_depth = 1;
+          }
+          else if(c == ')'){
+            // a stray close parenthesis is an item of its own
+            return true;
+          }
+          else if(c == '"'){
+            m_resume = Atom;
+            m_state = String;
+          }
+          else{
+            m_state = Atom;
+          }
+        }
+        break;
+
+      case Atom:
+        if(isBlank(c) || c == '(' || c == ')' || c == ';'){
+          m_state = Between;
+          return true;
+        }
+        if(c == '"'){
+          m_resume = Atom;
+          m_state = String;
+        }
+        ++m_scan;
+        break;
+
+      case Form:
+        if(c == '('){
+          ++m_depth;
+        }
+        else if(c == ')' && --m_depth == 0){
+          ++m_scan;
+          m_state = Between;
+          return true;
+        }
+        else if(c == '"'){
+          m_resume = Form;
+          m_state = String;
+        }
+        else if(c == ';'){
+          m_resume = Form;
+          m_state = Comment;
+        }
+        ++m_scan;
+        break;
+
+      case String:
+        {
+          const char * quote = static_cast<const char *>(std::memchr(t + m_scan, '"', n - m_scan));
+          if(!quote){
+            m_scan = n;
+            break;
+          }
+          m_scan = quote - t + 1;
+          m_state = m_resume;
+        }
+        break;
+
+      case Comment:
+        {
+          const char * newline = static_cast<const char *>(std::memchr(t + m_scan, '\n', n - m_scan));
+          if(!newline){
+            m_scan = n;
+            break;
+          }
+          m_scan = newline - t + 1;
+          m_state = m_resume;
+          if(m_state == Between){
+            m_start = m_scan;
+          }
+        }
+        break;
+    }
+  }
+  return false;
+}
+
+bool FormReader::fill(){
+
+  if(!m_input){
+    return false;
+  }
+
+  // nothing before the current item is needed again
+  if(m_state == Between || (m_state == Comment && m_resume == Between)){
+    m_start = m_scan;
+  }
+  m_text.erase(0, m_start);
+  m_scan -= m_start;
+  m_start = 0;
+
+  // wait for one character, then take whatever else has already arrived,
+  // so a form is read as soon as its last character is written
+  int c = m_input->get();
+  if(c == std::char_traits<char>::eof()){
+    return false;
+  }
+  m_text.push_back(static_cast<char>(c));
+
+  std::size_t size = m_text.size();
+  m_text.resize(size + m_block - 1);
+  std::streamsize n = m_input->readsome(&m_text[size], m_block - 1);
+  m_text.resize(size + (n > 0 ? n : 0));
+  return true;
+}
@@ -0,0 +1,104 @@
+/*! \file form_reader.hpp
+Defines the FormReader type, which splits a program into its top-level forms.
+ */
+#ifndef FORM_READER_HPP
+#define FORM_READER_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+/*! \class FormReader
+\brief Reads a program one top-level form at a time.
+
+A program may be any number of top-level forms. The reader yields the
+text of each as soon as it is complete, so it can be parsed and evaluated
+before the rest of the program arrives.
+
+Reading from a stream, the reader pulls the text in blocks, taking only
+what has already arrived after the first character of a block, and keeps
+only the text of the form being read: memory is bounded by the largest
+form rather than by the program. Reading from a buffer, the text of each
+form is a range of the buffer.
+
+The reader only finds where forms end, honouring strings and comments as
+the tokenizer does; it does not check them. Text between forms that is not
+a form, such as a stray atom or close parenthesis, is yielded as an item
+of its own, and a form still open at the end of the input runs to the
+end, so parsing either fails as parsing the whole program would.
+ */
+class FormReader {
+public:
+
+  /// the most characters read from a stream at once
+  static const std::size_t DEFAULT_BLOCK = 64 * 1024;
+
+  /*! Construct a reader of a stream.
+    \param input the stream, which must outlive the reader
+    \param block the most characters to read from it at once
+   */
+  explicit FormReader(std::istream & input, std::size_t block = DEFAULT_BLOCK);
+
+  /*! Construct a reader of a buffer.
+    \param first the start of the text, which must outlive the reader
+    \param last one past its end
+   */
+  FormReader(const char * first, const char * last) noexcept;
+
+  FormReader(const FormReader &) = delete;
+  FormReader & operator=(const FormReader &) = delete;
+
+  /*! Read the next top-level form.
+    \param first set to the start of the form's text
+    \param last set to one past its end
+    \return false if only spaces and comments remain
+
+    The text is valid until the next call.
+   */
+  bool next(const char *& first, const char *& last);
+
+  /// return the number of characters the reader holds
+  std::size_t buffered() const noexcept;
+
+private:
+
+  // what the character at m_scan is part of
+  enum State { Between, Form, Atom, String, Comment };
+
+  // the stream read from, or nullptr when reading a buffer
+  std::istream * m_input;
+  std::size_t m_block;
+
+  // the text read from the stream and not yet discarded
+  std::string m_text;
+
+  // the buffer read from
+  const char * m_first;
+  const char * m_last;
+
+  // offsets into the text: the start of the item being read, and how far
+  // it has been scanned
+  std::size_t m_start;
+  std::size_t m_scan;
+
+  State m_state;
+
+  // the state a string or comment returns to when it ends
+  State m_resume;
+
+  // the nesting depth of the form being read
+  std::size_t m_depth;
+
+  // the text, from the stream or the buffer
+  const char * text() const noexcept;
+  std::size_t size() const noexcept;
+
+  // scan the text for the end of the current item; true if it ends
+  bool scan() noexcept;
+
+  // discard the text before the current item and read another block; false
+  // at the end of the input
+  bool fill();
+};
+
+#endif
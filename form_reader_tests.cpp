@@ -0,0 +1,109 @@
+#include "catch.hpp"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "form_reader.hpp"
+#include "interpreter.hpp"
+
+// the text of every item the reader yields
+static std::vector<std::string> readAll(FormReader & reader){
+
+  std::vector<std::string> forms;
+  const char * first;
+  const char * last;
+  while(reader.next(first, last)){
+    forms.emplace_back(first, last);
+  }
+  return forms;
+}
+
+TEST_CASE( "Test form reader splits a program into forms", "[form_reader]" ) {
+
+  std::string program =
+    "; a generated script\n"
+    "(define a (list 1 2))  (define b \"a ) string ; of sorts\")\n"
+    "(+ a ; a ( comment\n 2)\n"
+    "  ; the end\n";
+
+  std::vector<std::string> expected = {
+    "(define a (list 1 2))",
+    "(define b \"a ) string ; of sorts\")",
+    "(+ a ; a ( comment\n 2)"
+  };
+
+  FormReader buffer(program.data(), program.data() + program.size());
+  REQUIRE(readAll(buffer) == expected);
+  REQUIRE(buffer.buffered() == 0);
+
+  INFO("a stream gives the same forms however it is read");
+  for(std::size_t block : {1, 2, 3, 7, 64}){
+    std::istringstream iss(program);
+    FormReader stream(iss, block);
+    REQUIRE(readAll(stream) == expected);
+  }
+
+  std::string empty = " ; nothing\n\t";
+  FormReader blank(empty.data(), empty.data() + empty.size());
+  REQUIRE(readAll(blank).empty());
+}
+
+TEST_CASE( "Test form reader yields text that is not a form", "[form_reader]" ) {
+
+  std::vector<std::pair<std::string, std::vector<std::string>>> cases = {
+    {"(a) b (c)", {"(a)", "b", "(c)"}},
+    {"(a)) (c)", {"(a)", ")", "(c)"}},
+    {"x\"y z\"(c)", {"x\"y z\"", "(c)"}},
+    {"(a) (b (c)", {"(a)", "(b (c)"}},
+    {"(a) (b \"c)", {"(a)", "(b \"c)"}},
+    {"(a) (b ; c)", {"(a)", "(b ; c)"}}
+  };
+
+  for(const auto & c : cases){
+    INFO(c.first);
+    std::istringstream iss(c.first);
+    FormReader reader(iss, 2);
+    REQUIRE(readAll(reader) == c.second);
+  }
+}
+
+TEST_CASE( "Test form reader holds only the form being read", "[form_reader]" ) {
+
+  std::ostringstream os;
+  for(int i = 0; i < 2000; ++i){
+    os << "(define x" << i << " (list " << i << " \"(\" " << i << ")) ; sample\n";
+  }
+
+  std::istringstream iss(os.str());
+  FormReader reader(iss, 256);
+
+  std::size_t forms = 0, held = 0;
+  const char * first;
+  const char * last;
+  while(reader.next(first, last)){
+    ++forms;
+    held = std::max(held, reader.buffered());
+  }
+  REQUIRE(forms == 2000);
+  REQUIRE(held < 2 * 256);
+}
+
+TEST_CASE( "Test evaluating forms as they are read", "[form_reader]" ) {
+
+  std::istringstream iss("(define a 1) (define b (+ a 1))\n(list a b)");
+  FormReader reader(iss);
+  Interpreter interp;
+
+  std::vector<Expression> results;
+  const char * first;
+  const char * last;
+  while(reader.next(first, last)){
+    REQUIRE(interp.parseBuffer(first, last));
+    results.push_back(interp.evaluate());
+  }
+
+  REQUIRE(results.size() == 3);
+  REQUIRE(results[1] == Expression(2.));
+  REQUIRE(results[2] == Expression(std::vector<Expression>{Expression(1.), Expression(2.)}));
+}
@@ -0,0 +1,86 @@
+/*! \file graphic.hpp
+Defines the plain data of the graphics values: points, lines, text and plots.
+ */
+#ifndef GRAPHIC_HPP
+#define GRAPHIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/// the kind of graphic an Expression is, if any
+enum class GraphicKind : std::uint8_t {None, Point, Line, Text, Plot};
+
+/// the kind of a plot
+enum class PlotKind : std::uint8_t {Discrete, Continuous};
+
+/// a point at (x, y), drawn with diameter size
+struct PointGraphic {
+  double x;
+  double y;
+  double size;
+};
+
+/// a line from p1 to p2, drawn with width thickness
+struct LineGraphic {
+  PointGraphic p1;
+  PointGraphic p2;
+  double thickness;
+};
+
+/// text centred on position, scaled by scale and rotated by rotation
+/// radians; the string itself is the head of the Expression
+struct TextGraphic {
+  PointGraphic position;
+  double scale;
+  double rotation;
+};
+
+/// a plot, whose items are the graphics and labels it draws
+struct PlotGraphic {
+  PlotKind kind;
+  std::size_t numPoints;
+  std::size_t numOptions;
+};
+
+/*! \enum GraphicField
+\brief The properties a Graphic holds in its fields, as bit flags.
+
+The object-name of points, lines and text and the type of plots are implied
+by the kind, and always set.
+ */
+enum GraphicField : std::uint16_t {
+  NameField = 1,        //< "object-name"
+  SizeField = 2,        //< "size" of a point
+  ThicknessField = 4,   //< "thickness" of a line
+  PositionField = 8,    //< "position" of text
+  ScaleField = 16,      //< "text-scale" of text
+  RotationField = 32,   //< "text-rotation" of text
+  TypeField = 64,       //< "type" of a plot
+  PointsField = 128,    //< "numpoints" of a plot
+  OptionsField = 256    //< "numoptions" of a plot
+};
+
+/*! \struct Graphic
+\brief The plain data of a graphics value, as the renderer draws it.
+
+A field whose property is not set holds the value the renderer assumes:
+a size or thickness of -1, which it rejects, a text scale of 1 and a
+rotation of 0.
+ */
+struct Graphic {
+  GraphicKind kind;
+
+  /// the GraphicField flags of the properties set
+  std::uint16_t fields;
+
+  union {
+    PointGraphic point;
+    LineGraphic line;
+    TextGraphic text;
+    PlotGraphic plot;
+  };
+
+  Graphic() noexcept: kind(GraphicKind::None), fields(0), line() {}
+};
+
+#endif
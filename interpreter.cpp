@@ -1,15 +1,80 @@
 #include "interpreter.hpp"
 
-bool Interpreter::parseStream(std::istream & expression) noexcept{
+#include "form_reader.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
 
-  TokenSequenceType tokens = tokenize(expression);
+bool Interpreter::parseStream(std::istream & expression) noexcept{
 
-  ast = parse(tokens);
+  std::string text((std::istreambuf_iterator<char>(expression)), std::istreambuf_iterator<char>());
 
-  return (ast != Expression());
+  return parseBuffer(text.data(), text.data() + text.size());
 };
 
+// the text each thread must have to parse before starting it costs less
+// than parsing on it saves
+static const std::size_t PARALLEL_PARSE_BYTES_PER_THREAD = 4 << 20;
+
+bool Interpreter::parseBuffer(const char * first, const char * last) noexcept{
+
+  // threads beyond the hardware's only share its cores, and threads with
+  // too little text only add the pre-scan and the stitching; with fewer
+  // than two left the serial parser runs
+  std::size_t threads = std::min(parseThreads, std::max(std::thread::hardware_concurrency(), 1u));
+  threads = std::min(threads, static_cast<std::size_t>(last - first) / PARALLEL_PARSE_BYTES_PER_THREAD);
+  tree = parseTree(first, last, threads > 1 ? static_cast<unsigned>(threads) : 1);
+  ast = Expression();
+  program.reset();
+
+  return !tree.empty();
+}
+
+void Interpreter::setParseThreads(unsigned threads) noexcept{
+  parseThreads = threads ? threads : 1;
+}
+
+void Interpreter::setEvaluationMode(EvaluationMode m) noexcept{
+  mode = m;
+}
+
+Interpreter::EvaluationMode Interpreter::evaluationMode() const noexcept{
+  return mode;
+}
+
 Expression Interpreter::evaluate(){
 
-  return ast.eval(env);
+  Expression result;
+  if(mode == TreeWalk){
+    if(ast == Expression()){
+      ast = tree.toExpression();
+    }
+    result = ast.eval(env);
+  }
+  else{
+    if(!program){
+      program = tree.empty() ? compile(Expression()) : compile(tree, tree.root());
+    }
+    result = vm.run(*program, env);
+  }
+
+  // no call is running, so every value still in use is reachable from the
+  // globals or the result
+  env.collect(result);
+  return result;
+}
+
+bool Interpreter::evaluateStartup(std::istream & startup){
+
+  FormReader reader(startup);
+  const char * first;
+  const char * last;
+  while(reader.next(first, last)){
+    if(!parseBuffer(first, last)){
+      return false;
+    }
+    evaluate();
+  }
+  return true;
 }
@@ -9,13 +9,16 @@ It maintains an environment during evaluation.
 
 // system includes
 #include <istream>
+#include <memory>
 #include <string>
 #include <stdexcept>
 
 // module includes
+#include "bytecode.hpp"
 #include "environment.hpp"
 #include "expression.hpp"
 #include "token.hpp"
+#include "vm.hpp"
 #include "parse.hpp"
 #include "semantic_error.hpp"
 
@@ -23,31 +26,90 @@ It maintains an environment during evaluation.
 \brief Class to parse and evaluate an expression (program)
 
 Interpreter has an Environment, which starts at a default.
-The parse method builds an internal AST.
+The parse method builds an internal syntax tree.
 The eval method updates Environment and returns last result.
+
+By default the AST is compiled to bytecode and run on the VM. The original
+tree-walking evaluator is kept as a reference mode.
 */
 class Interpreter {
 public:
 
+  /*! \enum EvaluationMode
+    \brief selects how evaluate executes the parsed program
+   */
+  enum EvaluationMode { Bytecode, //< compile and run on the VM
+                        TreeWalk  //< recursively evaluate the AST
+  };
+
+  /// select the evaluation mode used by subsequent calls to evaluate
+  void setEvaluationMode(EvaluationMode mode) noexcept;
+
+  /// return the current evaluation mode
+  EvaluationMode evaluationMode() const noexcept;
+
+  /*! Set the most threads parseBuffer may use for a large buffer.
+    \param threads the thread count, including the calling thread; 1, the
+    default, parses on the calling thread only
+
+    parseBuffer uses no more threads than the hardware runs at once, and
+    no more than the buffer has 4 MB of text for; below two it parses on
+    the calling thread.
+   */
+  void setParseThreads(unsigned threads) noexcept;
+
   /*! Parse into an internal Expression from a stream
     \param expression the raw text stream repreenting the candidate expression
     \return true on successful parsing
    */
   bool parseStream(std::istream &expression) noexcept;
 
-  /*! Evaluate the Expression by walking the tree, returning the result.
+  /*! Parse into an internal Expression from a contiguous buffer
+    \param first the start of the raw text representing the candidate expression
+    \param last one past its end
+    \return true on successful parsing
+
+    The buffer is only read during the call.
+   */
+  bool parseBuffer(const char * first, const char * last) noexcept;
+
+  /*! Evaluate the Expression in the current mode, returning the result.
     \return the Expression resulting from the evaluation in the current environment
     \throws SemanticError when a semantic error is encountered
    */
   Expression evaluate();
 
+  /*! Parse and evaluate a startup program, one top-level form at a time.
+    \param startup the program, which may hold any number of forms, or none
+    \return false if a form could not be parsed; the forms before it have
+    been evaluated
+    \throws SemanticError when a semantic error is encountered
+   */
+  bool evaluateStartup(std::istream & startup);
+
 private:
 
   // the environment
   Environment env;
 
-  // the AST
+  // the parsed program
+  SyntaxTree tree;
+
+  // the program as an Expression, built from the tree on first tree-walking
+  // evaluation
   Expression ast;
+
+  // the AST compiled to bytecode, built on first evaluation
+  std::shared_ptr<const Chunk> program;
+
+  // the machine running program, kept so its stacks are reused
+  VM vm;
+
+  // how evaluate executes the AST
+  EvaluationMode mode = Bytecode;
+
+  // the most threads parseBuffer uses
+  unsigned parseThreads = 1;
 };
 
 #endif
@@ -4,10 +4,14 @@
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include "semantic_error.hpp"
 #include "interpreter.hpp"
 #include "expression.hpp"
+#include "environment.hpp"
 #include "startup_config.hpp"
 
 Expression run(const std::string & program){
@@ -15,8 +19,9 @@ Expression run(const std::string & program){
   Interpreter interp;
 
   std::ifstream startip_str(STARTUP_FILE);
-  REQUIRE(interp.parseStream(startip_str));
-  REQUIRE_NOTHROW(interp.evaluate());
+  bool started = false;
+  REQUIRE_NOTHROW(started = interp.evaluateStartup(startip_str));
+  REQUIRE(started);
 
   std::istringstream iss(program);
   INFO(program);
@@ -39,8 +44,9 @@ bool run_and_expect_error(const std::string & program){
   Interpreter interp;
 
   std::ifstream startip_str(STARTUP_FILE);
-  REQUIRE(interp.parseStream(startip_str));
-  REQUIRE_NOTHROW(interp.evaluate());
+  bool started = false;
+  REQUIRE_NOTHROW(started = interp.evaluateStartup(startip_str));
+  REQUIRE(started);
 
   bool ok = interp.parseStream(iss);
   if(!ok){
@@ -434,6 +440,125 @@ TEST_CASE("Test handle_lambda", "[expression]"){
   program = "(begin (define f (lambda (+ x I) (+ x I))) (f 5))";
   REQUIRE(run_and_expect_error(program));
 
+  // a lambda created inside a call keeps the parameters it closed over
+  program = "(begin (define make-adder (lambda (n) (lambda (x) (+ x n)))) (define add1 (make-adder 1)) (add1 41))";
+  result = run(program);
+  REQUIRE(result == Expression(42.));
+
+  // parameters hide globals only inside the call
+  program = "(begin (define x 100) (define f (lambda (x) (* x x))) (list (f 3) x))";
+  result = run(program);
+  REQUIRE(result == Expression(std::vector<Expression>{Expression(9.), Expression(100.)}));
+
+  // a definition inside a call does not leak into the global scope
+  program = "(begin (define f (lambda (x) (define y x))) (f 3) (y))";
+  REQUIRE(run_and_expect_error(program));
+}
+
+TEST_CASE("Test local procedures see definitions made after them", "[expression]"){
+
+  std::vector<std::pair<std::string, double>> programs = {
+    {"(begin (define f (lambda (n) (begin (define g (lambda (x) (h x))) (define h (lambda (y) (* y n))) (g 2)))) (f 5))", 10},
+    {"(begin (define f (lambda (n) (begin (define g (lambda (x) (* x m))) (define m 3) (g 2)))) (f 5))", 6}
+  };
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    for(auto & program : programs){
+      INFO(program.first);
+      Interpreter interp;
+      interp.setEvaluationMode(mode);
+      std::istringstream iss(program.first);
+      REQUIRE(interp.parseStream(iss));
+      Expression result;
+      REQUIRE_NOTHROW(result = interp.evaluate());
+      REQUIRE(result == Expression(program.second));
+    }
+  }
+}
+
+TEST_CASE("Test call frames held only by their own closures are freed", "[expression]"){
+
+  std::string program = "(begin (define f (lambda (n) (begin (define g (lambda (x) (h x))) (define h (lambda (y) (* y n))) g))) (f 5))";
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    Interpreter interp;
+    interp.setEvaluationMode(mode);
+    std::istringstream iss(program);
+    REQUIRE(interp.parseStream(iss));
+
+    // the helper returned still sees the frame it was defined in
+    Expression g = interp.evaluate();
+    REQUIRE(g.isLambda());
+    std::shared_ptr<const Environment> scope = g.closure();
+    REQUIRE(scope->get_exp(Atom("h")).isLambda());
+    REQUIRE(scope->get_exp(Atom("n")) == Expression(5.));
+
+    // then the frame goes at the first collection after the last
+    // reference from outside it, which runs once the captured frames
+    // have doubled
+    g = Expression();
+    std::istringstream next("(begin (f 1) (f 2) (+ 1 2))");
+    REQUIRE(interp.parseStream(next));
+    interp.evaluate();
+    REQUIRE(!scope->is_known(Atom("h")));
+    REQUIRE(!scope->is_known(Atom("n")));
+  }
+}
+
+TEST_CASE("Test call frames reached through lists and properties are freed", "[expression]"){
+
+  // each call leaves a frame whose own binding closes over it, reached
+  // only through the list or property returned; run under LeakSanitizer,
+  // any frame kept alive by such a cycle is reported as a leak
+  // each maker, and how to call the lambda it left in a global
+  std::vector<std::pair<std::string, std::string>> makers = {
+    {"(define mk (lambda (n) (begin (define loop (lambda (k) (+ k n))) (list loop))))",
+     "(begin (define k (first kept)) (k 1))"},
+    {"(define mk (lambda (n) (begin (define loop (lambda (k) (+ k n))) (set-property \"f\" loop n))))",
+     "(begin (define k (get-property \"f\" kept)) (k 1))"},
+    {"(define mk (lambda (n) (begin (define loop (lambda (k) (+ k n))) (define fs (list (list loop))) fs)))",
+     "(begin (define k (first (first kept))) (k 1))"}
+  };
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    for(auto & entry : makers){
+      const std::string & maker = entry.first;
+      INFO(maker);
+      Interpreter interp;
+      interp.setEvaluationMode(mode);
+      std::istringstream define(maker);
+      REQUIRE(interp.parseStream(define));
+      interp.evaluate();
+
+      // a frame still reachable from a global is kept
+      std::istringstream keep("(begin (define kept (mk 41)) (length (map mk (range 1 100 1))))");
+      REQUIRE(interp.parseStream(keep));
+      REQUIRE(interp.evaluate() == Expression(100.));
+
+      std::istringstream drop("(mk 7)");
+      REQUIRE(interp.parseStream(drop));
+      Expression dropped = interp.evaluate();
+      Expression loop = dropped.isList() ? dropped.item(0) : dropped.property("\"f\"");
+      while(loop.isList()){
+        loop = loop.item(0);
+      }
+      REQUIRE(loop.isLambda());
+      std::shared_ptr<const Environment> scope = loop.closure();
+      REQUIRE(scope->get_exp(Atom("n")) == Expression(7.));
+
+      // capturing more frames starts the next collection
+      dropped = Expression();
+      loop = Expression();
+      std::istringstream call("(length (map mk (range 1 10 1)))");
+      REQUIRE(interp.parseStream(call));
+      REQUIRE(interp.evaluate() == Expression(10.));
+      REQUIRE(!scope->is_known(Atom("n")));
+
+      std::istringstream use(entry.second);
+      REQUIRE(interp.parseStream(use));
+      REQUIRE(interp.evaluate() == Expression(42.));
+    }
+  }
 }
 
 TEST_CASE("Test handle_apply", "[expression]"){
@@ -555,6 +680,115 @@ TEST_CASE("Test output widget helper functions", "[expression]") {
   REQUIRE(e.getTextProperties() == target2);
 }
 
+TEST_CASE("Test graphics procedures match their lambda definitions", "[expression]") {
+
+  // the definitions startup.pls used before the procedures were built in
+  auto with_lambdas = [](const std::string & body){
+    return std::string(R"((begin
+      (define point (lambda (x y) (set-property "size" (0) (set-property "object-name" "point" (list x y)))))
+      (define line (lambda (p1 p2) (set-property "thickness" (1) (set-property "object-name" "line" (list p1 p2)))))
+      (define text (lambda (str) (set-property "position" (point 0 0) (set-property "object-name" "text" (str))))) )") +
+      body + ")";
+  };
+
+  Expression point = run("(make-point 2 -3)");
+  Expression old_point = run(with_lambdas("(point 2 -3)"));
+  REQUIRE(point == old_point);
+  REQUIRE(point.property("\"size\"") == old_point.property("\"size\""));
+  REQUIRE(point.property("\"object-name\"") == old_point.property("\"object-name\""));
+
+  Expression line = run("(make-line (make-point 0 0) (make-point 1 2))");
+  Expression old_line = run(with_lambdas("(line (point 0 0) (point 1 2))"));
+  REQUIRE(line == old_line);
+  REQUIRE(line.property("\"thickness\"") == old_line.property("\"thickness\""));
+  REQUIRE(line.property("\"object-name\"") == old_line.property("\"object-name\""));
+
+  Expression text = run("(make-text \"hi\")");
+  Expression old_text = run(with_lambdas("(text \"hi\")"));
+  REQUIRE(text == old_text);
+  REQUIRE(text.property("\"position\"") == old_text.property("\"position\""));
+  REQUIRE(text.property("\"object-name\"") == old_text.property("\"object-name\""));
+
+  // arguments the lambdas accepted are still accepted
+  for(auto calls : {std::make_pair("(make-point \"a\" 2)", "(point \"a\" 2)"),
+                    std::make_pair("(make-point 1 (list 2))", "(point 1 (list 2))"),
+                    std::make_pair("(make-line 1 2)", "(line 1 2)"),
+                    std::make_pair("(make-text 3)", "(text 3)")}){
+    INFO(calls.first);
+    Expression e = run(calls.first);
+    Expression old_e = run(with_lambdas(calls.second));
+    REQUIRE(e == old_e);
+    REQUIRE(e.property("\"object-name\"") == old_e.property("\"object-name\""));
+  }
+
+  REQUIRE(run_and_expect_error("(make-point 1)"));
+  REQUIRE(run_and_expect_error("(define + 1)"));
+
+  // unlike the built-in arithmetic, the constructors may be redefined
+  REQUIRE(run("(begin (define make-point (lambda (x y) (+ x y))) (make-point 1 2))") == Expression(3.));
+}
+
+TEST_CASE("Test calling a built-in procedure with no arguments", "[interpreter]") {
+
+  std::vector<std::pair<std::string, std::string>> calls = {
+    {"(make-text)", "Error: invalid number of arguments to make-text."},
+    {"(make-point)", "Error: invalid number of arguments to make-point."},
+    {"(make-line)", "Error: invalid number of arguments to make-line."},
+    {"(begin (define f (lambda (x) (make-text))) (f 1))", "Error: invalid number of arguments to make-text."},
+    {"(undefined)", "Error during handle lookup: unknown symbol undefined"}
+  };
+
+  for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+    for(auto & call : calls){
+      INFO(call.first);
+      Interpreter interp;
+      interp.setEvaluationMode(mode);
+      std::istringstream iss(call.first);
+      REQUIRE(interp.parseStream(iss));
+
+      std::string message;
+      try{
+        interp.evaluate();
+      }
+      catch(const SemanticError & ex){
+        message = ex.what();
+      }
+      REQUIRE(message == call.second);
+    }
+  }
+}
+
+TEST_CASE("Test the reductions may be redefined", "[interpreter]") {
+
+  for(std::string name : {"sum", "prod", "mean", "variance", "min", "max", "argmin", "argmax"}){
+    INFO(name);
+    Expression builtin = run("(" + name + " (list 4 1 3))");
+
+    for(auto mode : {Interpreter::TreeWalk, Interpreter::Bytecode}){
+      auto eval = [mode](const std::string & program){
+        Interpreter interp;
+        interp.setEvaluationMode(mode);
+        std::istringstream iss(program);
+        INFO(program);
+        REQUIRE(interp.parseStream(iss));
+        Expression result;
+        REQUIRE_NOTHROW(result = interp.evaluate());
+        return result;
+      };
+
+      // at top level, as a value or as a procedure
+      REQUIRE(eval("(begin (define " + name + " 0) " + name + ")") == Expression(0.));
+      REQUIRE(eval("(begin (define " + name + " 10) (+ " + name + " 1))") == Expression(11.));
+      REQUIRE(eval("(begin (define " + name + " (lambda (x) (* 2 x))) (" + name + " 3))") == Expression(6.));
+
+      // inside a lambda, leaving the built-in in place outside it
+      REQUIRE(eval("(begin (define f (lambda (x) (begin (define " + name + " (lambda (y) (* 2 y))) (" + name + " x)))) (f 3))") == Expression(6.));
+      REQUIRE(eval("(begin (define f (lambda (x) (begin (define " + name + " (lambda (y) (* 2 y))) (" + name + " x)))) (f 3) (" + name + " (list 4 1 3)))") == builtin);
+      REQUIRE(eval("(begin (define f (lambda (" + name + ") (+ " + name + " 1))) (f 3))") == Expression(4.));
+    }
+  }
+}
+
 TEST_CASE("Test handle discrete-plot", "[expression]") {
   std::string program;
   program = R"( (discrete-plot (list (list -1 -1) (list 1 1)) (list (list "title" "The Title") (list "abscissa-label" "X Label") (list "ordinate-label" "Y Label"))) )";
@@ -91,17 +91,14 @@ NotebookApp::NotebookApp(QWidget *parent) : QWidget(parent) {
     setObjectName("notebook");
 
     std::ifstream startip_str(STARTUP_FILE);
-    if(!mrInterpret->parseStream(startip_str)){
-        emit send_failure("Error: Invalid Startup Program. Could not parse.");
-    }
-    else{
-        try{
-            Expression exp = mrInterpret->evaluate();
-        }
-        catch(const SemanticError & ex){
-            emit send_failure(ex.what());
+    try{
+        if(!mrInterpret->evaluateStartup(startip_str)){
+            emit send_failure("Error: Invalid Startup Program. Could not parse.");
         }
     }
+    catch(const SemanticError & ex){
+        emit send_failure(ex.what());
+    }
 
     default_state = mrInterpret;
 
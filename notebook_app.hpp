@@ -14,8 +14,10 @@
 #include "startup_config.hpp"
 #include "TSmessage.hpp"
 
+#include <chrono>
 #include <fstream>
 #include <sstream>
+#include <thread>
 
 
 typedef TSmessage<std::string> InputQueue;
@@ -12,43 +12,25 @@ void OutputWidget::catch_result(Expression e){
         clear_screen();
     }
 
-    if(e.checkProperty("object-name", "point")) {
+    const Graphic & graphic = e.graphic();
+    if(graphic.kind == GraphicKind::Point) {
 
-        std::vector<Expression> coordinates = e.contents();
-        double x = coordinates[0].head().asNumber();
-        double y = coordinates[1].head().asNumber();
-        double diam = e.getNumericalProperty("\"size\"");
-        if(diam < 0){
+        if(graphic.point.size < 0){
             catch_failure("Error: in make-point call: diameter not positive");
             return;
         }
-        drawPoint(x, y, diam);
+        drawPoint(graphic.point.x, graphic.point.y, graphic.point.size);
     }
-    else if (e.checkProperty("object-name", "line")) {
+    else if (graphic.kind == GraphicKind::Line) {
 
-        Expression p1, p2;
-        std::vector<Expression> list = e.contents();
-        p1 = list[0];
-        p2 = list[1];
-
-        if(p1.checkProperty("object-name", "point") && p2.checkProperty("object-name", "point")){
-            double a = p1.tailConstBegin()->head().asNumber();
-            double b = p1.tailConstEnd()->head().asNumber();
-            double c = p2.tailConstBegin()->head().asNumber();
-            double d = p2.tailConstEnd()->head().asNumber();
-            double thicc = e.getNumericalProperty("\"thickness\"");
-            if(thicc < 0){
-                catch_failure("Error: in make-line call: thickness value not positive");
-                return;
-            }
-            drawLine(a, b, c, d, thicc);
-        }
-        else {
-            catch_failure("Error: argument to make-line not a point");
+        const LineGraphic & line = graphic.line;
+        if(line.thickness < 0){
+            catch_failure("Error: in make-line call: thickness value not positive");
             return;
         }
+        drawLine(line.p1.x, line.p1.y, line.p2.x, line.p2.y, line.thickness);
     }
-    else if (e.checkProperty("object-name", "text")) {
+    else if (graphic.kind == GraphicKind::Text) {
 
         std::string text_string = e.head().asSymbol();
 
@@ -58,18 +40,23 @@ void OutputWidget::catch_result(Expression e){
         
         drawText(QString::fromStdString(text_string), scaleFactor, rotDeg, xcor, ycor);
     }
+    else if (e.checkProperty("object-name", "line")) {
+        // a line is only typed when both its ends are points
+        catch_failure("Error: argument to make-line not a point");
+        return;
+    }
     else if (e.isList()) {
         clear_on_print = false;
-        for (auto &item: e.contents()) {
+        for (auto &item: e.tailView()) {
             drawListItem(item);
         }
         clear_on_print = true;
     }
-    else if (e.isDP()) {
+    else if (graphic.kind == GraphicKind::Plot && graphic.plot.kind == PlotKind::Discrete) {
         clear_on_print = false;
         drawDP(e);
     }
-    else if (e.isCP()){
+    else if (graphic.kind == GraphicKind::Plot){
         clear_on_print = false;
         //TODO
     }
@@ -150,13 +137,13 @@ void OutputWidget::drawListItem(Expression e) {
 void OutputWidget::drawDP(Expression e) {
 
     // Graph constants
-    double N = 20, A = 3, B = 3, C = 2, D = 2, P = 0.5;
+    double N = 20, C = 2, D = 2;
 
-    std::vector<Expression> data = e.contents();
-    int i = 0;
+    Expression::TailView data = e.tailView();
+    std::size_t i = 0;
 
     // Draw bounding box lines
-    for(i; i < 4; i++) {
+    for(; i < 4; i++) {
         catch_result(data[i]);
     }
 
@@ -179,23 +166,23 @@ void OutputWidget::drawDP(Expression e) {
     drawText(QString::fromStdString(OLa.asString()), 1, 0, AL-D, OL);
     drawText(QString::fromStdString(OUa.asString()), 1, 0, AL-D, OU);
 
-    size_t num_opt = (int)e.getProperty("numoptions").asNumber();
-    for (i; i < 11; i++) {
+    size_t num_opt = e.graphic().plot.numOptions;
+    for (; i < 11; i++) {
         catch_result(data[i]);
     }
-    double text_scale = 1;
+    // skip the text scale, which the drawing does not apply yet
     if (num_opt == 4) {
-        text_scale = data[i++].head().asNumber();
+        i++;
     }
 
 
-    size_t num_data = (int)e.getProperty("numpoints").asNumber();
-    for (i; i < 15; i++) {
+    size_t num_data = e.graphic().plot.numPoints;
+    for (; i < 15; i++) {
         catch_result(data[i]);
     }
 
     // Draw data points and stem lines
-    for(i; i < num_data; i++) {
+    for(; i < num_data; i++) {
         catch_result(data[i]);
     }
 
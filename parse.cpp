@@ -1,48 +1,50 @@
 #include "parse.hpp"
 
+#include <cstring>
+#include <iterator>
 #include <stack>
+#include <thread>
+#include <vector>
 
-bool setHead(Expression &exp, const Token &token) {
+// Token and TokenView sequences parse the same way, differing only in the
+// token type the Atoms are built from
 
-  Atom a(token);
+/* Add the nodes of the form in [first, last) to tree, returning the index of
+   its root, or SyntaxTree::NONE if the tokens are not exactly one form.
 
-  exp.head() = a;
-  
-  return !a.isNone();
-}
-
-bool append(Expression *exp, const Token &token) {
-
-  Atom a(token);
-
-  exp->append(a);
-
-  return !a.isNone();
-}
+   The stack holds the index of each open form and of its last child, so
+   each token adds one node and links it without searching.
+ */
+template <typename Iterator>
+NodeId parseForm(Iterator first, Iterator last, SyntaxTree &tree) {
 
-Expression parse(const TokenSequenceType &tokens) noexcept {
+  // cannot parse empty
+  if (first == last)
+    return SyntaxTree::NONE;
 
-  Expression ast;
+  struct Open {
+    NodeId node;
+    NodeId lastChild;
+  };
 
-  // cannot parse empty
-  if (tokens.empty())
-    return Expression();
+  NodeId root = SyntaxTree::NONE;
 
   bool athead = false;
 
-  // stack tracks the last node created
-  std::stack<Expression *> stack;
+  // stack tracks the forms opened and not yet closed
+  std::stack<Open, std::vector<Open>> stack;
 
   std::size_t num_tokens_seen = 0;
 
-  for (auto &t : tokens) {
+  for (Iterator it = first; it != last; ++it) {
+    auto &t = *it;
 
     if (t.type() == Token::OPEN) {
       athead = true;
     }
     else if (t.type() == Token::CLOSE) {
       if (stack.empty()) {
-        return Expression();
+        return SyntaxTree::NONE;
       }
       stack.pop();
 
@@ -52,41 +54,418 @@ Expression parse(const TokenSequenceType &tokens) noexcept {
       }
     }
     else {
+      Atom a(t);
+      if (a.isNone() || (!athead && stack.empty())) {
+        return SyntaxTree::NONE;
+      }
+
+      NodeId node = tree.addNode(a);
+      if (stack.empty()) {
+        root = node;
+      }
+      else {
+        tree.link(stack.top().node, stack.top().lastChild, node);
+        stack.top().lastChild = node;
+      }
+
       if (athead) {
-        if (stack.empty()) {
-          if (!setHead(ast, t)) {
-            return Expression();
-          }
-          stack.push(&ast);
+        stack.push(Open{node, SyntaxTree::NONE});
+        athead = false;
+      }
+    }
+    num_tokens_seen += 1;
+  }
+
+  if (stack.empty() && (num_tokens_seen == static_cast<std::size_t>(last - first))) {
+    return root;
+  }
+
+  return SyntaxTree::NONE;
+}
+
+template <typename Sequence>
+SyntaxTree parseSequence(const Sequence &tokens) noexcept {
+
+  // every node is an atom token, so this is the only allocation per array
+  SyntaxTree tree;
+  tree.reserve(tokens.size());
+
+  if (parseForm(tokens.begin(), tokens.end(), tree) == SyntaxTree::NONE) {
+    tree.clear();
+  }
+  return tree;
+}
+
+SyntaxTree parseTree(const TokenSequenceType &tokens) noexcept {
+  return parseSequence(tokens);
+}
+
+SyntaxTree parseTree(const TokenViewSequenceType &tokens) noexcept {
+  return parseSequence(tokens);
+}
+
+Expression parse(const TokenSequenceType &tokens) noexcept {
+  return parseTree(tokens).toExpression();
+}
+
+Expression parse(const TokenViewSequenceType &tokens) noexcept {
+  return parseTree(tokens).toExpression();
+}
+
+/* Parsing a buffer on several threads.
+
+   parseTokens accepts exactly one form in which every open parenthesis is
+   followed by an atom, and every atom is valid; anything else is the None
+   Expression. So the parallel parse only needs to build that one tree, and
+   can hand any input it is unsure of to the serial parse.
+
+   A large program is almost always one form, such as a begin, so there
+   are rarely top-level forms to split between. Instead a pre-scan walks
+   down the spine of forms, from each to its child holding most of the
+   text, to the first form whose text is spread over many children: for a
+   data script, the list of samples. The children of that form are split
+   into byte ranges, one per thread, which are tokenized and parsed as
+   sequences of items. The forms along the spine are then parsed around
+   the child they contain, and the items stitched back together in order.
+
+   Every range starts and ends at a parenthesis outside any string or
+   comment, so tokenizing it gives the same tokens as tokenizing the whole
+   buffer.
+ */
+
+namespace {
+
+// the pre-scan only stops at these characters, everything else belongs
+// to an atom or separates atoms
+struct ScanTable {
+  bool stops[256];
+
+  ScanTable() noexcept {
+    for(bool & s : stops){
+      s = false;
+    }
+    for(unsigned char c : {'(', ')', '"', ';'}){
+      stops[c] = true;
+    }
+  }
+};
+
+const ScanTable SCAN_TABLE;
+
+// the deepest form the pre-scan descends to
+const std::size_t MAX_SPINE = 16;
+
+bool isBlank(char c) noexcept {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// the first character at or after c that is not a space or in a comment
+const char * skipBlank(const char * c, const char * last) noexcept {
+
+  while(c != last){
+    if(*c == ';'){
+      const char * newline = static_cast<const char *>(std::memchr(c, '\n', last - c));
+      c = newline ? newline + 1 : last;
+    }
+    else if(isBlank(*c)){
+      ++c;
+    }
+    else{
+      break;
+    }
+  }
+  return c;
+}
+
+// what the pre-scan found in one form
+struct FormScan {
+  // the closing parenthesis of the form
+  const char * close;
+
+  // the text of the largest child form, or nullptr if it has none
+  const char * child;
+  const char * childEnd;
+
+  // the opening parentheses of the child forms to split the form at
+  std::vector<const char *> splits;
+};
+
+/* Scan the form whose opening parenthesis is at open, picking up to
+   parts - 1 children, evenly spaced as if the form ended at end, to split
+   it at.
+
+   Returns false if the form's head is not an atom or the form is not
+   closed before last; parseTokens rejects both, so the caller parses
+   serially to fail the same way.
+ */
+bool scanForm(const char * open, const char * last, const char * end, std::size_t parts, FormScan & scan){
+
+  scan.child = scan.childEnd = nullptr;
+  scan.splits.clear();
+
+  const char * c = skipBlank(open + 1, last);
+  if(c == last || *c == '(' || *c == ')'){
+    return false;
+  }
+
+  std::size_t step = static_cast<std::size_t>(end - open) / parts + 1;
+  const char * split = open + step;
+  const char * childStart = nullptr;
+  std::size_t depth = 1;
+
+  while(true){
+    while(c != last && !SCAN_TABLE.stops[static_cast<unsigned char>(*c)]){
+      ++c;
+    }
+    if(c == last){
+      return false;
+    }
+
+    switch(*c){
+      case '"':
+        {
+          const char * quote = static_cast<const char *>(std::memchr(c + 1, '"', last - c - 1));
+          if(!quote) return false;
+          c = quote + 1;
         }
-        else {
-          if (stack.empty()) {
-            return Expression();
-          }
+        break;
 
-          if (!append(stack.top(), t)) {
-            return Expression();
-          }
-          stack.push(stack.top()->tail());
+      case ';':
+        {
+          const char * newline = static_cast<const char *>(std::memchr(c, '\n', last - c));
+          if(!newline) return false;
+          c = newline + 1;
         }
-        athead = false;
-      }
-      else {
-        if (stack.empty()) {
-          return Expression();
+        break;
+
+      case '(':
+        if(depth == 1){
+          childStart = c;
+          if(c >= split && scan.splits.size() + 1 < parts){
+            scan.splits.push_back(c);
+            split = c + step;
+          }
         }
+        ++depth;
+        ++c;
+        break;
 
-        if (!append(stack.top(), t)) {
-          return Expression();
+      default:
+        if(--depth == 0){
+          scan.close = c;
+          return true;
         }
+        ++c;
+        if(depth == 1 && (!scan.child || c - childStart > scan.childEnd - scan.child)){
+          scan.child = childStart;
+          scan.childEnd = c;
+        }
+        break;
+    }
+  }
+}
+
+// parse the tokens of a sequence of items, atoms or whole forms, into
+// nodes of tree, adding the index of each item to items; false if any item
+// is one parseForm rejects
+template <typename Iterator>
+bool parseItems(Iterator first, Iterator last, SyntaxTree & tree, std::vector<NodeId> & items){
+
+  while(first != last){
+    if(first->type() == Token::CLOSE){
+      return false;
+    }
+
+    if(first->type() == Token::OPEN){
+      // the item is the form ending at the matching parenthesis
+      Iterator close = first;
+      for(std::size_t depth = 0; close != last; ++close){
+        if(close->type() == Token::OPEN) ++depth;
+        if(close->type() == Token::CLOSE && --depth == 0) break;
       }
+      if(close == last){
+        return false;
+      }
+
+      NodeId form = parseForm(first, close + 1, tree);
+      if(form == SyntaxTree::NONE){
+        return false;
+      }
+      items.push_back(form);
+      first = close + 1;
+    }
+    else{
+      Atom a(*first);
+      if(a.isNone()){
+        return false;
+      }
+      items.push_back(tree.addNode(a));
+      ++first;
     }
-    num_tokens_seen += 1;
   }
+  return true;
+}
+
+// tokenize and parse the items in [first, last)
+bool parseItems(const char * first, const char * last, SyntaxTree & tree, std::vector<NodeId> & items){
+
+  TokenViewSequenceType tokens = tokenize(first, last);
+  tree.reserve(tree.size() + tokens.size());
+  return parseItems(tokens.cbegin(), tokens.cend(), tree, items);
+}
 
-  if (stack.empty() && (num_tokens_seen == tokens.size())) {
-    return ast;
+// link children to node in order, after its last child; returns the new last child
+NodeId linkAll(SyntaxTree & tree, NodeId node, NodeId lastChild, const std::vector<NodeId> & children, std::size_t from = 0){
+
+  for(std::size_t i = from; i < children.size(); ++i){
+    tree.link(node, lastChild, children[i]);
+    lastChild = children[i];
   }
+  return lastChild;
+}
 
-  return Expression();
-};
+// parse a buffer that is one form on up to threads threads, or return
+// false to have it parsed serially
+bool parseInParallel(const char * first, const char * last, unsigned threads, SyntaxTree & tree){
+
+  const char * open = skipBlank(first, last);
+  if(open == last || *open != '('){
+    return false;
+  }
+
+  // walk down the spine to the form to split
+  struct Level {
+    const char * open;
+    const char * close;
+    const char * child;
+    const char * childEnd;
+  };
+  std::vector<Level> spine;
+
+  FormScan scan;
+  const char * end = last;
+  while(true){
+    if(!scanForm(open, last, end, threads, scan)){
+      return false;
+    }
+    if(spine.empty() && skipBlank(scan.close + 1, last) != last){
+      return false;
+    }
+    if(!scan.child || 2 * (scan.childEnd - scan.child) < scan.close - open || spine.size() == MAX_SPINE){
+      break;
+    }
+    spine.push_back(Level{open, scan.close, scan.child, scan.childEnd});
+    open = scan.child;
+    end = scan.childEnd;
+  }
+
+  // The forms on the spine are added first, so the root is node 0 and each
+  // parent comes before its children. A form's head is its first item,
+  // which becomes the form's node; the items after the child on the spine
+  // are linked once that child is.
+  struct SpineNode {
+    NodeId node;
+    NodeId lastChild;
+    std::vector<NodeId> after;
+  };
+  std::vector<SpineNode> nodes(spine.size());
+  for(std::size_t i = 0; i < spine.size(); ++i){
+    std::vector<NodeId> before;
+    if(!parseItems(spine[i].open + 1, spine[i].child, tree, before) ||
+       !parseItems(spine[i].childEnd, spine[i].close, tree, nodes[i].after)){
+      return false;
+    }
+    nodes[i].node = before.front();
+    nodes[i].lastChild = linkAll(tree, before.front(), SyntaxTree::NONE, before, 1);
+  }
+
+  // the ranges of the split form's items, each parsed on its own thread
+  // into its own tree
+  std::vector<const char *> bounds;
+  bounds.push_back(open + 1);
+  bounds.insert(bounds.end(), scan.splits.begin(), scan.splits.end());
+  bounds.push_back(scan.close);
+
+  std::size_t parts = bounds.size() - 1;
+  std::vector<SyntaxTree> trees(parts);
+  std::vector<std::vector<NodeId>> items(parts);
+  std::vector<char> parsed(parts, false);
+
+  auto work = [&](std::size_t i){
+    try{
+      parsed[i] = parseItems(bounds[i], bounds[i + 1], trees[i], items[i]);
+    }
+    catch(...){
+      parsed[i] = false;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  try{
+    for(std::size_t i = 1; i < parts; ++i){
+      workers.emplace_back(work, i);
+    }
+  }
+  catch(const std::system_error &){
+    // too few threads to go round, so the rest are parsed here
+  }
+  for(std::size_t i = workers.size() + 1; i < parts; ++i){
+    work(i);
+  }
+  work(0);
+  for(std::thread & worker : workers){
+    worker.join();
+  }
+
+  for(char ok : parsed){
+    if(!ok) return false;
+  }
+
+  // append each part's nodes, and link its items to the split form
+  std::size_t nodeCount = tree.size();
+  for(const SyntaxTree & part : trees){
+    nodeCount += part.size();
+  }
+  tree.reserve(nodeCount);
+
+  NodeId form = SyntaxTree::NONE;
+  NodeId lastChild = SyntaxTree::NONE;
+  for(std::size_t i = 0; i < parts; ++i){
+    NodeId offset = tree.splice(trees[i]);
+    trees[i] = SyntaxTree();
+    for(NodeId & item : items[i]){
+      item += offset;
+    }
+    if(i == 0){
+      form = items[0].front();
+    }
+    lastChild = linkAll(tree, form, lastChild, items[i], i == 0 ? 1 : 0);
+  }
+
+  // then link each form on the spine to the form within it
+  for(std::size_t i = spine.size(); i-- > 0;){
+    tree.link(nodes[i].node, nodes[i].lastChild, form);
+    linkAll(tree, nodes[i].node, form, nodes[i].after);
+    form = nodes[i].node;
+  }
+
+  return true;
+}
+
+}
+
+SyntaxTree parseTree(const char * first, const char * last, unsigned threads) noexcept {
+
+  SyntaxTree tree;
+  if(static_cast<std::size_t>(last - first) > TokenView::MAX_SOURCE){
+    return tree;
+  }
+  if(threads > 1 && parseInParallel(first, last, threads, tree)){
+    return tree;
+  }
+  return parseTree(tokenize(first, last));
+}
+
+Expression parse(const char * first, const char * last, unsigned threads) noexcept {
+  return parseTree(first, last, threads).toExpression();
+}
@@ -1,11 +1,46 @@
 /*! \file parse.hpp
-Defines the parse function.
+Defines the parse functions, which build a SyntaxTree or an Expression.
  */
 #ifndef PARSE_HPP
 #define PARSE_HPP
 
 #include "token.hpp"
 #include "expression.hpp"
+#include "syntax_tree.hpp"
+
+/*! \fn parseTree
+\brief parse a sequence of tokens into a syntax tree
+
+\param tokens, the input token sequence
+\returns the tree resulting from parsing or an empty tree on failure
+ */
+SyntaxTree parseTree(const TokenSequenceType & tokens) noexcept;
+
+/*! \fn parseTree
+\brief parse a sequence of tokens read from a buffer into a syntax tree
+
+\param tokens, the input token sequence
+\returns the tree resulting from parsing or an empty tree on failure
+
+The tree copies what it needs, so the buffer may be released after.
+ */
+SyntaxTree parseTree(const TokenViewSequenceType & tokens) noexcept;
+
+/*! \fn parseTree
+\brief tokenize and parse a buffer, splitting the work between threads
+
+\param first the start of the program text
+\param last one past its end
+\param threads the most threads to use, including the calling one
+\returns the tree resulting from parsing or an empty tree on failure
+
+The result is always the one parsing the buffer's tokens serially gives.
+The text of the form holding most of the program, such as a long list of
+data, is split between the threads; programs without one, and any text
+the serial parser would reject, are parsed on the calling thread. A
+buffer longer than TokenView::MAX_SOURCE fails to parse.
+ */
+SyntaxTree parseTree(const char * first, const char * last, unsigned threads) noexcept;
 
 /*! \fn parse
 \brief parse a sequence of tokens into an expression (abstract syntax tree)
@@ -15,4 +50,24 @@ Defines the parse function.
  */
 Expression parse(const TokenSequenceType & tokens) noexcept;
 
+/*! \fn parse
+\brief parse a sequence of tokens read from a buffer into an expression
+
+\param tokens, the input token sequence
+\returns the expression resulting from parsing or the None Expression on failure
+
+The Expression copies what it needs, so the buffer may be released after.
+ */
+Expression parse(const TokenViewSequenceType & tokens) noexcept;
+
+/*! \fn parse
+\brief tokenize and parse a buffer on up to threads threads, as parseTree does
+
+\param first the start of the program text
+\param last one past its end
+\param threads the most threads to use, including the calling one
+\returns the expression resulting from parsing or the None Expression on failure
+ */
+Expression parse(const char * first, const char * last, unsigned threads) noexcept;
+
 #endif
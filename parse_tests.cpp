@@ -1,7 +1,23 @@
 #include "catch.hpp"
 
+#include <random>
+#include <sstream>
+
 #include "parse.hpp"
 
+// true if parsing program on threads threads gives what parsing it
+// serially does, printed the same
+static bool parsesAsSerially(const std::string & program, unsigned threads){
+
+  Expression serial = parse(tokenize(program.data(), program.data() + program.size()));
+  Expression parallel = parse(program.data(), program.data() + program.size(), threads);
+
+  std::ostringstream s, p;
+  s << serial;
+  p << parallel;
+  return serial == parallel && s.str() == p.str();
+}
+
 TEST_CASE("Test parser with expected input", "[parse]") {
 
   std::string program = "(begin (define r 10) (* pi (* r r)))";
@@ -66,4 +82,70 @@ TEST_CASE( "Test open quotes", "[parse]" ) {
   TokenSequenceType tokens = tokenize(iss);
 
   REQUIRE(parse(tokens) == Expression());
-}
\ No newline at end of file
+}
+TEST_CASE( "Test parse a buffer in parallel", "[parse]" ) {
+
+  std::ostringstream data;
+  data << "(begin\n ; samples\n (define data (list\n";
+  for(int i = 0; i < 200; ++i){
+    data << "  (list " << i << " \"(" << i << ";\" " << -i * 0.5 << ") ; (point\n";
+  }
+  data << " ))\n (discrete-plot data (list (list \"title\" \"Samples\"))))\n";
+
+  std::vector<std::string> programs = {
+    data.str(),
+    "(begin (define r 10) (* pi (* r r)))",
+    "(list (a) (b) (c) (d) (e) (f) (g) (h))",
+    "  ; leading comment\n(list (a) \"x)\" (b)) ; trailing comment",
+    "(\"head\" (a) (b))",
+    "(list (a) (b) (c)) (d)",
+    "(list (a) (b) (c)) x",
+    "((begin (+ 1))))))",
+    "(list (a) (b) (c)",
+    "(list (a) (1.2abc) (c) (d))",
+    "(list (a) () (c) (d))",
+    "(list (a) ((b)) (c) (d))",
+    "(list (a) (b) 1.2abc)",
+    "((a) (b) (c))",
+    "( (a) (b) (c))",
+    "+ 1 2",
+    "()",
+    "(\"this string is unbalanced (a) (b)",
+    "(list (a) (b) ; unterminated comment",
+    ""
+  };
+
+  for(const std::string & program : programs){
+    INFO(program);
+    for(unsigned threads : {1, 2, 3, 4, 8, 64}){
+      INFO(threads);
+      REQUIRE(parsesAsSerially(program, threads));
+    }
+  }
+
+  std::string text = data.str();
+  REQUIRE(parse(text.data(), text.data() + text.size(), 4) != Expression());
+}
+
+TEST_CASE( "Test parse damaged programs in parallel", "[parse]" ) {
+
+  std::mt19937 random(2020);
+  const std::string damage = "() \";x1\n";
+
+  // a nested program, then copies of it with a character changed
+  std::string program = "(begin";
+  for(int i = 0; i < 40; ++i){
+    program += (i % 7 == 0) ? " (list (f " + std::to_string(i) + ") \"s)\" ; c(\n" : " (g " + std::to_string(i) + ")";
+    if(i % 7 == 6) program += ")";
+  }
+  program += "))";
+  REQUIRE(parsesAsSerially(program, 4));
+
+  std::uniform_int_distribution<std::size_t> at(0, program.size() - 1), pick(0, damage.size() - 1);
+  for(int i = 0; i < 300; ++i){
+    std::string damaged = program;
+    damaged[at(random)] = damage[pick(random)];
+    INFO(damaged);
+    REQUIRE(parsesAsSerially(damaged, 1 + i % 5));
+  }
+}
@@ -3,9 +3,13 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <thread>
+#include <chrono>
 
+#include "form_reader.hpp"
 #include "interpreter.hpp"
 #include "semantic_error.hpp"
+#include "source_buffer.hpp"
 #include "startup_config.hpp"
 #include "TSmessage.hpp"
 
@@ -91,15 +95,13 @@ class Consumer {
         if(!iqueue->try_pop(line)){
           continue;
         }
-        std::istringstream expression(line);
-
         if(line == "")
           continue;
 
         Expression result;
         std::string error;
 
-        if(!cInterp.parseStream(expression)){
+        if(!cInterp.parseBuffer(line.data(), line.data() + line.size())){
           error = "Invalid Expression. Could not parse.";
         }
         else{
@@ -166,13 +168,19 @@ void info(const std::string & err_str){
   std::cout << "Info: " << err_str << std::endl;
 }
 
-int eval_from_stream(std::istream & stream, Interpreter &interp){
+// evaluate each top-level form as soon as it is read, printing its result
+int eval_from_reader(FormReader & reader, Interpreter &interp){
 
-  if(!interp.parseStream(stream)){
-    error("Invalid Program. Could not parse.");
-    return EXIT_FAILURE;
-  }
-  else{
+  const char * first;
+  const char * last;
+  bool empty = true;
+
+  while(reader.next(first, last)){
+    empty = false;
+    if(!interp.parseBuffer(first, last)){
+      error("Invalid Program. Could not parse.");
+      return EXIT_FAILURE;
+    }
     try{
       Expression exp = interp.evaluate();
       std::cout << exp << std::endl;
@@ -183,26 +191,50 @@ int eval_from_stream(std::istream & stream, Interpreter &interp){
     }
   }
 
+  if(empty){
+    error("Invalid Program. Could not parse.");
+    return EXIT_FAILURE;
+  }
+
   return EXIT_SUCCESS;
 }
 
 int eval_from_file(std::string filename, Interpreter &interp){
 
-  std::ifstream ifs(filename);
+  // files may be large generated data scripts, worth parsing in parallel
+  // where there are cores to parse them on
+  unsigned cores = std::thread::hardware_concurrency();
+  if(cores > 1){
+    interp.setParseThreads(cores);
+  }
 
-  if(!ifs){
+  // a pipe is read as it arrives, so its first forms run before the rest
+  // is written
+  if(!SourceBuffer::isRegularFile(filename)){
+    std::ifstream input(filename, std::ios::binary);
+    if(!input){
+      error("Could not open file for reading.");
+      return EXIT_FAILURE;
+    }
+    FormReader reader(input);
+    return eval_from_reader(reader, interp);
+  }
+
+  SourceBuffer source;
+  if(!source.open(filename)){
     error("Could not open file for reading.");
     return EXIT_FAILURE;
   }
 
-  return eval_from_stream(ifs, interp);
+  FormReader reader(source.begin(), source.end());
+  return eval_from_reader(reader, interp);
 }
 
 int eval_from_command(std::string argexp, Interpreter &interp){
 
-  std::istringstream expression(argexp);
+  FormReader reader(argexp.data(), argexp.data() + argexp.size());
 
-  return eval_from_stream(expression, interp);
+  return eval_from_reader(reader, interp);
 }
 
 // A REPL is a repeated read-eval-print loop
@@ -281,20 +313,17 @@ int main(int argc, char *argv[])
 
   Interpreter interp;
   std::ifstream startup_stream(STARTUP_FILE);
-  if(!interp.parseStream(startup_stream)){
-    error("Error: Invalid Startup Program. Could not parse.");
-    return EXIT_FAILURE;
-  }
-  else{
-    try{
-      Expression exp = interp.evaluate();
-    }
-    catch(const SemanticError & ex){
-      std::cerr << "Start-up failed " << std::endl;
-      std::cerr << ex.what() << std::endl;
+  try{
+    if(!interp.evaluateStartup(startup_stream)){
+      error("Error: Invalid Startup Program. Could not parse.");
       return EXIT_FAILURE;
     }
   }
+  catch(const SemanticError & ex){
+    std::cerr << "Start-up failed " << std::endl;
+    std::cerr << ex.what() << std::endl;
+    return EXIT_FAILURE;
+  }
 
   if(argc == 2){
     return eval_from_file(argv[1], interp);
@@ -0,0 +1,187 @@
+/*! \file property_list.hpp
+Defines the PropertyList type, the storage behind Expression properties.
+ */
+#ifndef PROPERTY_LIST_HPP
+#define PROPERTY_LIST_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "symbol_table.hpp"
+
+/*! \class PropertyList
+\brief A small map from interned property keys to values.
+
+Almost no values have properties, so an empty list is a single null
+pointer. Otherwise the entries live out of line in one block, as a flat
+array sorted by key: a lookup is a binary search over a few integers,
+with no string compares and no per-entry allocation.
+
+Copies are deep; the Expression node holding a list is already shared
+between copies of the Expression and only copied before it is changed.
+
+T must be nothrow copy and move constructible.
+ */
+template<typename T>
+class PropertyList {
+public:
+
+  /// a key and its value
+  struct Entry {
+    SymbolId key;
+    T value;
+  };
+
+  typedef const Entry * ConstIteratorType;
+
+  /// construct an empty list, which has no block
+  PropertyList() noexcept: m_block(nullptr) {}
+
+  PropertyList(const PropertyList & a): PropertyList() {
+    if(a.m_block){
+      m_block = Block::create(a.size());
+      for(const Entry & e : a){
+        new(m_block->entries() + m_block->size++) Entry(e);
+      }
+    }
+  }
+
+  PropertyList(PropertyList && a) noexcept: m_block(a.m_block) {
+    a.m_block = nullptr;
+  }
+
+  ~PropertyList(){
+    destroy(m_block);
+  }
+
+  PropertyList & operator=(PropertyList a) noexcept {
+    swap(a);
+    return *this;
+  }
+
+  void swap(PropertyList & a) noexcept {
+    std::swap(m_block, a.m_block);
+  }
+
+  std::size_t size() const noexcept { return m_block ? m_block->size : 0; }
+  bool empty() const noexcept { return m_block == nullptr; }
+
+  ConstIteratorType begin() const noexcept { return m_block ? m_block->entries() : nullptr; }
+  ConstIteratorType end() const noexcept { return begin() + size(); }
+
+  /// return the value of key, or nullptr if it is not set
+  const T * find(SymbolId key) const noexcept {
+    const Entry * e = lowerBound(key);
+    return (e != end() && e->key == key) ? &e->value : nullptr;
+  }
+
+  /// true if key is set
+  bool count(SymbolId key) const noexcept {
+    return find(key) != nullptr;
+  }
+
+  /// store value as key, replacing any previous value
+  void set(SymbolId key, const T & value){
+
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "PropertyList values must move without throwing");
+
+    Entry * at = const_cast<Entry *>(lowerBound(key));
+    if(at != end() && at->key == key){
+      at->value = value;
+      return;
+    }
+
+    // copied before the block can move, in case value is one of its entries
+    Entry item{key, value};
+    std::size_t index = at - begin();
+    std::size_t n = size();
+    if(!m_block || n == m_block->capacity){
+      // most lists hold one or two keys; grow geometrically past that
+      Block * block = Block::create(n < 2 ? 2 : 2 * n);
+      for(Entry * e = m_block ? m_block->entries() : nullptr, * last = e + n; e != last; ++e){
+        new(block->entries() + block->size++) Entry(std::move(*e));
+      }
+      destroy(m_block);
+      m_block = block;
+    }
+
+    // shift the entries after index up one slot, then fill the gap
+    Entry * entries = m_block->entries();
+    if(index == n){
+      new(entries + n) Entry(std::move(item));
+    }
+    else{
+      new(entries + n) Entry(std::move(entries[n - 1]));
+      for(std::size_t i = n - 1; i > index; --i){
+        entries[i] = std::move(entries[i - 1]);
+      }
+      entries[index] = std::move(item);
+    }
+    ++m_block->size;
+  }
+
+  /// remove key, returning true if it was set
+  bool erase(SymbolId key) noexcept {
+
+    Entry * at = const_cast<Entry *>(lowerBound(key));
+    if(at == end() || at->key != key){
+      return false;
+    }
+
+    Entry * last = m_block->entries() + m_block->size - 1;
+    for(; at != last; ++at){
+      *at = std::move(at[1]);
+    }
+    last->~Entry();
+    if(--m_block->size == 0){
+      destroy(m_block);
+      m_block = nullptr;
+    }
+    return true;
+  }
+
+private:
+
+  // A block header followed by capacity slots for entries. The first size
+  // slots hold constructed entries; the rest are raw storage.
+  struct Block {
+    std::uint32_t size;
+    std::uint32_t capacity;
+
+    Entry * entries() noexcept {
+      static_assert(sizeof(Block) % alignof(Entry) == 0, "misaligned PropertyList entries");
+      return reinterpret_cast<Entry *>(this + 1);
+    }
+
+    static Block * create(std::size_t capacity){
+      void * memory = ::operator new(sizeof(Block) + capacity * sizeof(Entry));
+      Block * block = static_cast<Block *>(memory);
+      block->size = 0;
+      block->capacity = static_cast<std::uint32_t>(capacity);
+      return block;
+    }
+  };
+
+  const Entry * lowerBound(SymbolId key) const noexcept {
+    return std::lower_bound(begin(), end(), key,
+                            [](const Entry & e, SymbolId k){ return e.key < k; });
+  }
+
+  static void destroy(Block * block) noexcept {
+    if(block){
+      for(std::uint32_t i = 0; i < block->size; ++i){
+        block->entries()[i].~Entry();
+      }
+      ::operator delete(block);
+    }
+  }
+
+  Block * m_block;
+};
+
+#endif
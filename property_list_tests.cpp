@@ -0,0 +1,75 @@
+#include "catch.hpp"
+
+#include <string>
+
+#include "property_list.hpp"
+
+TEST_CASE( "Test empty property list", "[property_list]" ) {
+
+  PropertyList<std::string> empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty.size() == 0);
+  REQUIRE(empty.begin() == empty.end());
+  REQUIRE(empty.find(3) == nullptr);
+  REQUIRE(!empty.erase(3));
+
+  // an empty list is only its null block pointer
+  REQUIRE(sizeof(empty) == sizeof(void *));
+}
+
+TEST_CASE( "Test property list keeps its keys sorted", "[property_list]" ) {
+
+  PropertyList<std::string> list;
+  for(SymbolId key : {5, 1, 9, 3, 7}){
+    list.set(key, std::to_string(key));
+  }
+
+  REQUIRE(list.size() == 5);
+  SymbolId previous = 0;
+  for(const auto & e : list){
+    REQUIRE(e.key > previous);
+    REQUIRE(e.value == std::to_string(e.key));
+    previous = e.key;
+  }
+  REQUIRE(*list.find(7) == "7");
+  REQUIRE(list.find(4) == nullptr);
+
+  INFO("setting a key again replaces its value");
+  list.set(3, "three");
+  REQUIRE(list.size() == 5);
+  REQUIRE(*list.find(3) == "three");
+
+  INFO("erasing closes the gap, and the last erase frees the block");
+  REQUIRE(list.erase(1));
+  REQUIRE(!list.erase(1));
+  REQUIRE(list.begin()->key == 3);
+  for(SymbolId key : {3, 5, 7, 9}){
+    REQUIRE(list.erase(key));
+  }
+  REQUIRE(list.empty());
+}
+
+TEST_CASE( "Test property list copies are independent", "[property_list]" ) {
+
+  PropertyList<std::string> list;
+  list.set(2, "two");
+  list.set(4, "four");
+
+  PropertyList<std::string> copy(list);
+  copy.set(4, "FOUR");
+  copy.set(3, "three");
+  REQUIRE(*list.find(4) == "four");
+  REQUIRE(list.find(3) == nullptr);
+  REQUIRE(copy.size() == 3);
+
+  PropertyList<std::string> moved(std::move(copy));
+  REQUIRE(copy.empty());
+  REQUIRE(*moved.find(3) == "three");
+
+  // a value taken from the list itself survives the block growing
+  PropertyList<std::string> self;
+  self.set(1, "one");
+  self.set(2, "two");
+  self.set(0, *self.find(2));
+  REQUIRE(*self.find(0) == "two");
+}
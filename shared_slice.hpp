@@ -0,0 +1,360 @@
+/*! \file shared_slice.hpp
+Defines the SharedSlice type, the storage behind list tails.
+ */
+#ifndef SHARED_SLICE_HPP
+#define SHARED_SLICE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*! \class SharedSlice
+\brief A persistent, contiguous sequence: a window onto a shared buffer.
+
+Slices that share a buffer never see each other's changes. Dropping items
+from the front only moves the window. Appending to a slice whose window
+ends where the buffer's claimed items end writes into the spare capacity
+in place, since no other slice can see that slot; any other append copies
+the window into a new buffer with room to grow. Building a list one item
+at a time is therefore amortized constant time per item, while every
+earlier version of the list stays valid.
+
+Only one slice can extend a buffer in place. Appending through a slice
+whose buffer another slice has already extended past its window, such as
+appending twice to the same list, copies the whole window: O(n) for an
+n-item slice. Keeping the items contiguous, so data() and the iterators
+stay plain pointers, costs this; a chunked layout would avoid the copy
+but not give a contiguous view.
+
+A slice may also hold up to INLINE items in the slice object itself, with
+no buffer at all; it moves them to a buffer when it grows past that.
+Copying such a slice copies its items rather than sharing them.
+
+T must be nothrow copy and move constructible, and no larger than a
+pointer if INLINE is not zero.
+ */
+template<typename T, std::size_t INLINE = 0>
+class SharedSlice {
+public:
+
+  typedef const T * ConstIteratorType;
+
+  /// construct an empty slice, which has no buffer
+  SharedSlice() noexcept: m_buffer(nullptr), m_size(0) {
+    m_offset = 0;
+  }
+
+  /// construct a slice holding items, moving them inline or into a new buffer
+  explicit SharedSlice(std::vector<T> && items):
+    SharedSlice(std::make_move_iterator(items.data()), std::make_move_iterator(items.data() + items.size()))
+  {}
+
+  /// construct a slice holding the items in [first, last), moving them
+  SharedSlice(std::move_iterator<T *> first, std::move_iterator<T *> last): SharedSlice() {
+    std::size_t n = last - first;
+    if(n <= INLINE){
+      for(; first != last; ++first){
+        new(inlineItems() + m_size++) T(*first);
+      }
+    }
+    else{
+      m_buffer = Buffer::create(n);
+      for(; first != last; ++first){
+        new(m_buffer->items() + m_size++) T(*first);
+      }
+      m_buffer->claimed.store(m_size, std::memory_order_relaxed);
+    }
+  }
+
+  /// construct a slice holding n copies of value, which it owns alone
+  SharedSlice(std::size_t n, const T & value): SharedSlice() {
+    if(n <= INLINE){
+      for(; m_size < n; ++m_size){
+        new(inlineItems() + m_size) T(value);
+      }
+    }
+    else{
+      m_buffer = Buffer::create(n);
+      for(; m_size < n; ++m_size){
+        new(m_buffer->items() + m_size) T(value);
+      }
+      m_buffer->claimed.store(m_size, std::memory_order_relaxed);
+    }
+  }
+
+  /// construct a slice holding a copy of the items in [first, last)
+  SharedSlice(const T * first, const T * last): SharedSlice() {
+    assign(first, last, last - first);
+  }
+
+  SharedSlice(const SharedSlice & a) noexcept: m_buffer(a.m_buffer), m_size(a.m_size) {
+    if(m_buffer){
+      m_offset = a.m_offset;
+      retain(m_buffer);
+    }
+    else if(INLINE > 0){
+      for(std::size_t i = 0; i < m_size; ++i){
+        new(inlineItems() + i) T(a.inlineItems()[i]);
+      }
+    }
+  }
+
+  SharedSlice(SharedSlice && a) noexcept: SharedSlice() {
+    take(a);
+  }
+
+  ~SharedSlice(){
+    reset();
+  }
+
+  SharedSlice & operator=(SharedSlice a) noexcept {
+    swap(a);
+    return *this;
+  }
+
+  void swap(SharedSlice & a) noexcept {
+    if(m_buffer && a.m_buffer){
+      std::swap(m_buffer, a.m_buffer);
+      std::swap(m_offset, a.m_offset);
+      std::swap(m_size, a.m_size);
+    }
+    else{
+      SharedSlice t;
+      t.take(a);
+      a.take(*this);
+      take(t);
+    }
+  }
+
+  std::size_t size() const noexcept { return m_size; }
+  bool empty() const noexcept { return m_size == 0; }
+
+  /// true if the items are held in the slice itself, not in a buffer
+  bool isInline() const noexcept { return !m_buffer && m_size > 0; }
+
+  const T * data() const noexcept {
+    if(m_buffer){
+      return m_buffer->items() + m_offset;
+    }
+    return m_size ? inlineItems() : nullptr;
+  }
+
+  ConstIteratorType begin() const noexcept { return data(); }
+  ConstIteratorType end() const noexcept { return data() + m_size; }
+  ConstIteratorType cbegin() const noexcept { return begin(); }
+  ConstIteratorType cend() const noexcept { return end(); }
+
+  const T & operator[](std::size_t i) const noexcept { return data()[i]; }
+  const T & back() const noexcept { return data()[m_size - 1]; }
+
+  /// return the slice without its first n items, sharing this buffer
+  SharedSlice drop(std::size_t n) const noexcept {
+    if(n >= m_size){
+      return SharedSlice();
+    }
+    if(!m_buffer){
+      return SharedSlice(data() + n, data() + m_size);
+    }
+    SharedSlice result(*this);
+    result.m_offset += n;
+    result.m_size -= n;
+    return result;
+  }
+
+  /// return the slice followed by item, sharing this buffer if possible
+  SharedSlice append(const T & item) const {
+    return append(&item, &item + 1);
+  }
+
+  /// return the slice followed by the items in [first, last)
+  SharedSlice append(const T * first, const T * last) const {
+
+    std::size_t n = last - first;
+    SharedSlice result(*this);
+    if(n == 0){
+      return result;
+    }
+
+    if(m_buffer && claim(n)){
+      T * slot = m_buffer->items() + m_offset + m_size;
+      for(const T * item = first; item != last; ++item){
+        new(slot++) T(*item);
+      }
+    }
+    else if(!m_buffer && m_size + n <= INLINE){
+      T * slot = result.inlineItems() + m_size;
+      for(const T * item = first; item != last; ++item){
+        new(slot++) T(*item);
+      }
+    }
+    else{
+      // grow geometrically so repeated appends stay amortized constant
+      std::size_t capacity = 2 * (m_size + n);
+      Buffer * buffer = Buffer::create(capacity);
+      copyInto(buffer, data(), m_size);
+      copyInto(buffer, first, n);
+      result = SharedSlice(buffer);
+    }
+    result.m_size = m_size + n;
+    return result;
+  }
+
+  /// append item to this slice, as with append
+  void push_back(const T & item){
+    append(&item, &item + 1).swap(*this);
+  }
+
+  /// return writable items, copying them first unless this slice owns them
+  T * mutableData(){
+    if(m_buffer && (m_buffer->refs.load(std::memory_order_acquire) != 1 || m_offset != 0 ||
+                    m_buffer->claimed.load(std::memory_order_relaxed) != m_size)){
+      SharedSlice copy;
+      copy.assign(data(), end(), m_size);
+      swap(copy);
+    }
+    if(m_buffer){
+      return m_buffer->items();
+    }
+    return m_size ? inlineItems() : nullptr;
+  }
+
+private:
+
+  // A buffer header followed by capacity slots for T. The first claimed
+  // slots hold constructed items; the rest are raw storage.
+  struct Buffer {
+    std::atomic<std::size_t> refs;
+    std::atomic<std::size_t> claimed;
+    std::size_t capacity;
+
+    T * items() noexcept {
+      static_assert(sizeof(Buffer) % alignof(T) == 0, "misaligned SharedSlice items");
+      return reinterpret_cast<T *>(this + 1);
+    }
+
+    static Buffer * create(std::size_t capacity){
+      void * memory = ::operator new(sizeof(Buffer) + capacity * sizeof(T));
+      Buffer * buffer = static_cast<Buffer *>(memory);
+      buffer->refs.store(1, std::memory_order_relaxed);
+      buffer->claimed.store(0, std::memory_order_relaxed);
+      buffer->capacity = capacity;
+      return buffer;
+    }
+  };
+
+  // adopt buffer, which already holds one reference for this slice
+  explicit SharedSlice(Buffer * buffer) noexcept: m_buffer(buffer), m_size(0) {
+    m_offset = 0;
+  }
+
+  // the inline items, meaningful only when there is no buffer
+  T * inlineItems() noexcept {
+    static_assert(INLINE == 0 || (sizeof(T) <= sizeof(void *) && alignof(T) <= alignof(void *)),
+                  "SharedSlice inline items must fit in a pointer");
+    return reinterpret_cast<T *>(m_inline);
+  }
+
+  const T * inlineItems() const noexcept {
+    return const_cast<SharedSlice *>(this)->inlineItems();
+  }
+
+  // move the contents of a into this slice, which is empty, leaving a empty
+  void take(SharedSlice & a) noexcept {
+    m_buffer = a.m_buffer;
+    m_size = a.m_size;
+    if(m_buffer){
+      m_offset = a.m_offset;
+    }
+    else if(INLINE > 0){
+      for(std::size_t i = 0; i < m_size; ++i){
+        new(inlineItems() + i) T(std::move(a.inlineItems()[i]));
+        a.inlineItems()[i].~T();
+      }
+    }
+    a.m_buffer = nullptr;
+    a.m_size = 0;
+    a.m_offset = 0;
+  }
+
+  // drop the items, leaving the slice empty
+  void reset() noexcept {
+    if(m_buffer){
+      release(m_buffer);
+    }
+    else if(INLINE > 0){
+      for(std::size_t i = 0; i < m_size; ++i){
+        inlineItems()[i].~T();
+      }
+    }
+    m_buffer = nullptr;
+    m_size = 0;
+    m_offset = 0;
+  }
+
+  // try to reserve the n slots just past this slice's window
+  bool claim(std::size_t n) const noexcept {
+    std::size_t frontier = m_offset + m_size;
+    if(frontier + n > m_buffer->capacity){
+      return false;
+    }
+    return m_buffer->claimed.compare_exchange_strong(frontier, frontier + n,
+                                                     std::memory_order_acq_rel);
+  }
+
+  void assign(const T * first, const T * last, std::size_t capacity){
+    SharedSlice result;
+    if(static_cast<std::size_t>(last - first) <= INLINE){
+      for(const T * item = first; item != last; ++item){
+        new(result.inlineItems() + result.m_size++) T(*item);
+      }
+    }
+    else{
+      result.m_buffer = Buffer::create(capacity);
+      copyInto(result.m_buffer, first, last - first);
+      result.m_size = last - first;
+    }
+    swap(result);
+  }
+
+  static void copyInto(Buffer * buffer, const T * first, std::size_t n) noexcept {
+    static_assert(std::is_nothrow_copy_constructible<T>::value,
+                  "SharedSlice items must copy without throwing");
+    std::size_t at = buffer->claimed.load(std::memory_order_relaxed);
+    for(std::size_t i = 0; i < n; ++i){
+      new(buffer->items() + at + i) T(first[i]);
+    }
+    buffer->claimed.store(at + n, std::memory_order_relaxed);
+  }
+
+  static void retain(Buffer * buffer) noexcept {
+    if(buffer){
+      buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  static void release(Buffer * buffer) noexcept {
+    if(buffer && buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+      std::size_t claimed = buffer->claimed.load(std::memory_order_relaxed);
+      for(std::size_t i = 0; i < claimed; ++i){
+        buffer->items()[i].~T();
+      }
+      ::operator delete(buffer);
+    }
+  }
+
+  // null for a slice whose items, if any, are inline
+  Buffer * m_buffer;
+  std::size_t m_size;
+  union {
+    // the window's start in the buffer
+    std::size_t m_offset;
+    // storage for up to INLINE items
+    void * m_inline[INLINE > 0 ? INLINE : 1];
+  };
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include "catch.hpp"
+
+#include <memory>
+#include <thread>
+
+#include "shared_slice.hpp"
+
+TEST_CASE( "Test empty slice", "[shared_slice]" ) {
+
+  SharedSlice<int> empty;
+  REQUIRE(empty.empty());
+  REQUIRE(empty.size() == 0);
+  REQUIRE(empty.begin() == empty.end());
+  REQUIRE(empty.drop(1).empty());
+
+  SharedSlice<int> one = empty.append(7);
+  REQUIRE(one.size() == 1);
+  REQUIRE(one[0] == 7);
+  REQUIRE(empty.empty());
+}
+
+TEST_CASE( "Test slice drop shares storage", "[shared_slice]" ) {
+
+  SharedSlice<int> slice(std::vector<int>{1, 2, 3, 4});
+  SharedSlice<int> rest = slice.drop(1);
+
+  REQUIRE(rest.size() == 3);
+  REQUIRE(rest[0] == 2);
+  REQUIRE(rest.back() == 4);
+  REQUIRE(rest.data() == slice.data() + 1);
+  REQUIRE(slice.size() == 4);
+  REQUIRE(slice.drop(4).empty());
+  REQUIRE(slice.drop(10).empty());
+}
+
+TEST_CASE( "Test slice append is persistent", "[shared_slice]" ) {
+
+  SharedSlice<int> base(std::vector<int>{1});
+
+  // the first append to the newest version grows into new storage
+  SharedSlice<int> ab = base.append(2);
+  // later appends to the newest version reuse it
+  SharedSlice<int> abc = ab.append(3);
+  REQUIRE(abc.data() == ab.data());
+
+  // appending to an older version copies, leaving the newer one alone
+  SharedSlice<int> abd = ab.append(4);
+  REQUIRE(abd.data() != ab.data());
+  REQUIRE(abc.size() == 3);
+  REQUIRE(abc[2] == 3);
+  REQUIRE(abd.size() == 3);
+  REQUIRE(abd[2] == 4);
+  REQUIRE(ab.size() == 2);
+  REQUIRE(base.size() == 1);
+
+  // appending to a dropped slice extends the same window
+  SharedSlice<int> bc = abc.drop(1);
+  SharedSlice<int> bce = bc.append(5);
+  REQUIRE(bce.size() == 3);
+  REQUIRE(bce[0] == 2);
+  REQUIRE(bce[2] == 5);
+  REQUIRE(abc[2] == 3);
+
+  // append a range, including the slice itself
+  SharedSlice<int> twice = abc.append(abc.begin(), abc.end());
+  REQUIRE(twice.size() == 6);
+  REQUIRE(twice[3] == 1);
+  REQUIRE(twice[5] == 3);
+}
+
+TEST_CASE( "Test slice destroys its items", "[shared_slice]" ) {
+
+  std::shared_ptr<int> item = std::make_shared<int>(1);
+  {
+    SharedSlice<std::shared_ptr<int>> slice(std::vector<std::shared_ptr<int>>{item});
+    SharedSlice<std::shared_ptr<int>> longer = slice.append(item).append(item);
+    SharedSlice<std::shared_ptr<int>> rest = longer.drop(2);
+    slice = SharedSlice<std::shared_ptr<int>>();
+    longer = SharedSlice<std::shared_ptr<int>>();
+    REQUIRE(rest.size() == 1);
+    REQUIRE(item.use_count() > 1);
+  }
+  REQUIRE(item.use_count() == 1);
+}
+
+TEST_CASE( "Test slice append is amortized constant", "[shared_slice]" ) {
+
+  SharedSlice<int> slice;
+  std::size_t moves = 0;
+  const int * storage = nullptr;
+  for(int i = 0; i < 100000; ++i){
+    slice.push_back(i);
+    if(slice.data() != storage){
+      storage = slice.data();
+      ++moves;
+    }
+  }
+
+  REQUIRE(slice.size() == 100000);
+  REQUIRE(slice[99999] == 99999);
+  // storage doubles, so it moves a logarithmic number of times
+  REQUIRE(moves < 20);
+}
+
+TEST_CASE( "Test slice mutable data copies shared storage", "[shared_slice]" ) {
+
+  SharedSlice<int> slice(std::vector<int>{1, 2, 3});
+  SharedSlice<int> copy = slice;
+
+  copy.mutableData()[0] = 10;
+  REQUIRE(copy[0] == 10);
+  REQUIRE(slice[0] == 1);
+
+  // a slice that owns its storage is written in place
+  const int * storage = copy.data();
+  copy.mutableData()[1] = 20;
+  REQUIRE(copy.data() == storage);
+  REQUIRE(copy[1] == 20);
+}
+
+TEST_CASE( "Test slice appends from many threads", "[shared_slice]" ) {
+
+  SharedSlice<int> base(std::vector<int>{0});
+  base = base.append(1); // leave spare capacity at the frontier
+
+  std::vector<SharedSlice<int>> results(8);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 8; ++t){
+    threads.emplace_back([&base, &results, t](){ results[t] = base.append(100 + t); });
+  }
+  for(auto & thread : threads){
+    thread.join();
+  }
+
+  // exactly one append may claim the slot, every result is still correct
+  for(int t = 0; t < 8; ++t){
+    REQUIRE(results[t].size() == 3);
+    REQUIRE(results[t][0] == 0);
+    REQUIRE(results[t][2] == 100 + t);
+  }
+}
+
+TEST_CASE( "Test filled slice is writable in place", "[shared_slice]" ) {
+
+  SharedSlice<int> filled(4, 7);
+  REQUIRE(filled.size() == 4);
+  REQUIRE(filled[3] == 7);
+
+  // the slice owns its buffer alone, so writing does not copy
+  const int * items = filled.data();
+  int * writable = filled.mutableData();
+  REQUIRE(writable == items);
+  writable[0] = 1;
+  REQUIRE(filled[0] == 1);
+
+  REQUIRE(SharedSlice<int>(0, 7).empty());
+}
+
+TEST_CASE( "Test slice holds a few items inline", "[shared_slice]" ) {
+
+  typedef SharedSlice<int, 3> Small;
+
+  Small slice;
+  for(int i = 0; i < 3; ++i){
+    slice.push_back(i);
+  }
+  REQUIRE(slice.isInline());
+  REQUIRE(slice.size() == 3);
+  REQUIRE(slice.back() == 2);
+  REQUIRE(static_cast<const void *>(slice.data()) >= static_cast<const void *>(&slice));
+  REQUIRE(static_cast<const void *>(slice.data()) < static_cast<const void *>(&slice + 1));
+
+  INFO("copies, moves and drops copy the items, and versions stay independent");
+  Small copy = slice;
+  Small rest = slice.drop(1);
+  Small moved = std::move(copy);
+  REQUIRE(copy.empty());
+  REQUIRE(moved.size() == 3);
+  REQUIRE(rest.isInline());
+  REQUIRE(rest.size() == 2);
+  REQUIRE(rest[0] == 1);
+  moved.mutableData()[0] = 10;
+  REQUIRE(moved[0] == 10);
+  REQUIRE(slice[0] == 0);
+
+  INFO("growing past the inline capacity moves the items to a buffer");
+  Small grown = slice.append(3);
+  REQUIRE(!grown.isInline());
+  REQUIRE(grown.size() == 4);
+  REQUIRE(grown[3] == 3);
+  REQUIRE(slice.isInline());
+  Small more = grown.append(4);
+  REQUIRE(more.data() == grown.data());
+
+  INFO("swapping works between inline and buffered slices");
+  rest.swap(grown);
+  REQUIRE(rest.size() == 4);
+  REQUIRE(!rest.isInline());
+  REQUIRE(grown.size() == 2);
+  REQUIRE(grown.isInline());
+  REQUIRE(grown[1] == 2);
+}
@@ -0,0 +1,110 @@
+#include "source_buffer.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+// files are mapped where POSIX mmap is available, and read anywhere else
+#if defined(__APPLE__) || defined(__linux) || defined(__unix) || defined(__posix)
+#define SOURCE_BUFFER_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SourceBuffer::SourceBuffer() noexcept: m_map(nullptr), m_mapSize(0) {}
+
+SourceBuffer::SourceBuffer(std::string text) noexcept:
+  m_text(std::move(text)), m_map(nullptr), m_mapSize(0) {}
+
+SourceBuffer::SourceBuffer(SourceBuffer && a) noexcept:
+  m_text(std::move(a.m_text)), m_map(a.m_map), m_mapSize(a.m_mapSize) {
+  a.m_map = nullptr;
+  a.m_mapSize = 0;
+}
+
+SourceBuffer & SourceBuffer::operator=(SourceBuffer && a) noexcept{
+
+  if(this != &a){
+    close();
+    m_text = std::move(a.m_text);
+    std::swap(m_map, a.m_map);
+    std::swap(m_mapSize, a.m_mapSize);
+  }
+  return *this;
+}
+
+SourceBuffer::~SourceBuffer(){
+  close();
+}
+
+void SourceBuffer::close() noexcept{
+
+#ifdef SOURCE_BUFFER_MMAP
+  if(m_map){
+    munmap(m_map, m_mapSize);
+  }
+#endif
+  m_map = nullptr;
+  m_mapSize = 0;
+  m_text.clear();
+}
+
+bool SourceBuffer::open(const std::string & filename){
+
+  close();
+
+#ifdef SOURCE_BUFFER_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if(fd < 0){
+    return false;
+  }
+
+  struct stat info;
+  bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+  if(regular && info.st_size > 0){
+    void * map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map != MAP_FAILED){
+      m_map = map;
+      m_mapSize = info.st_size;
+    }
+  }
+  ::close(fd);
+
+  // an empty file needs no mapping; anything else that cannot be mapped,
+  // such as a pipe, is read instead
+  if(m_map || (regular && info.st_size == 0)){
+    return true;
+  }
+#endif
+
+  std::ifstream ifs(filename, std::ios::binary);
+  if(!ifs){
+    return false;
+  }
+  m_text.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  return true;
+}
+
+bool SourceBuffer::isRegularFile(const std::string & filename){
+
+#ifdef SOURCE_BUFFER_MMAP
+  struct stat info;
+  return ::stat(filename.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+#else
+  return static_cast<bool>(std::ifstream(filename));
+#endif
+}
+
+const char * SourceBuffer::begin() const noexcept{
+  return m_map ? static_cast<const char *>(m_map) : m_text.data();
+}
+
+const char * SourceBuffer::end() const noexcept{
+  return begin() + size();
+}
+
+std::size_t SourceBuffer::size() const noexcept{
+  return m_map ? m_mapSize : m_text.size();
+}
@@ -0,0 +1,71 @@
+/*! \file source_buffer.hpp
+Defines the SourceBuffer type, the contiguous text a program is parsed from.
+ */
+#ifndef SOURCE_BUFFER_HPP
+#define SOURCE_BUFFER_HPP
+
+#include <cstddef>
+#include <string>
+
+/*! \class SourceBuffer
+\brief The text of a program as one contiguous, read-only buffer.
+
+A buffer either maps a file into memory, so reading it copies nothing, or
+owns a string, for programs given on the command line or typed at the
+REPL. Tokens read from a buffer are views into it and valid only as long
+as it is.
+ */
+class SourceBuffer {
+public:
+
+  /// construct an empty buffer
+  SourceBuffer() noexcept;
+
+  /// construct a buffer holding text
+  explicit SourceBuffer(std::string text) noexcept;
+
+  SourceBuffer(SourceBuffer && a) noexcept;
+  SourceBuffer & operator=(SourceBuffer && a) noexcept;
+
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer & operator=(const SourceBuffer &) = delete;
+
+  ~SourceBuffer();
+
+  /*! Replace the contents with those of a file.
+    \param filename the file to read
+    \return true on success; on failure the buffer is left empty
+   */
+  bool open(const std::string & filename);
+
+  /*! Test whether open would map a file rather than read it, so its text
+    is there to parse at once, unlike a pipe's.
+    \param filename the file to test
+    \return true if filename is a regular file; where files are never
+    mapped, true if it can be opened
+   */
+  static bool isRegularFile(const std::string & filename);
+
+  /// return the first character of the text
+  const char * begin() const noexcept;
+
+  /// return one past the last character of the text
+  const char * end() const noexcept;
+
+  /// return the number of characters in the text
+  std::size_t size() const noexcept;
+
+private:
+
+  // the text, when the buffer owns it
+  std::string m_text;
+
+  // the mapped file, or nullptr if the buffer owns its text
+  void * m_map;
+  std::size_t m_mapSize;
+
+  // unmap the file, if any, leaving the buffer empty
+  void close() noexcept;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "source_buffer.hpp"
+
+TEST_CASE( "Test source buffer holding a string", "[source_buffer]" ) {
+
+  SourceBuffer empty;
+  REQUIRE(empty.size() == 0);
+  REQUIRE(empty.begin() == empty.end());
+
+  SourceBuffer text(std::string("(+ 1 2)"));
+  REQUIRE(std::string(text.begin(), text.end()) == "(+ 1 2)");
+
+  SourceBuffer moved(std::move(text));
+  REQUIRE(moved.size() == 7);
+  REQUIRE(std::string(moved.begin(), moved.end()) == "(+ 1 2)");
+}
+
+TEST_CASE( "Test source buffer mapping a file", "[source_buffer]" ) {
+
+  const std::string filename = "source_buffer_test.pls";
+  std::string program = "(begin\n  (define a 1) ; a comment\n  (+ a 2))\n";
+  {
+    std::ofstream ofs(filename, std::ios::binary);
+    ofs << program;
+  }
+
+  SourceBuffer source;
+  REQUIRE(source.open(filename));
+  REQUIRE(std::string(source.begin(), source.end()) == program);
+
+  SourceBuffer moved;
+  moved = std::move(source);
+  REQUIRE(moved.size() == program.size());
+  REQUIRE(std::string(moved.begin(), moved.end()) == program);
+
+  {
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+  }
+  REQUIRE(moved.open(filename));
+  REQUIRE(moved.size() == 0);
+
+  std::remove(filename.c_str());
+  REQUIRE(!moved.open(filename));
+  REQUIRE(moved.size() == 0);
+}
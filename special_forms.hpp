@@ -0,0 +1,95 @@
+/*! \file special_forms.hpp
+Defines the tags used to dispatch the evaluation of an Expression node.
+ */
+#ifndef SPECIAL_FORMS_HPP
+#define SPECIAL_FORMS_HPP
+
+#include <cstdint>
+
+#include "atom.hpp"
+#include "symbol_table.hpp"
+
+/*! \enum SpecialForm
+\brief How an Expression node is evaluated.
+
+Every node resolves to exactly one tag: a terminal Lookup, an ordinary
+procedure Call, or one of the special forms.
+ */
+enum class SpecialForm : std::uint8_t {
+  Unresolved,     //< not yet resolved (the head was modified)
+  Lookup,         //< terminal, look up or return the head
+  Call,           //< apply a procedure or lambda to the evaluated tail
+  List,
+  Begin,
+  Define,
+  Lambda,
+  Apply,
+  Map,
+  SetProperty,
+  GetProperty,
+  DiscretePlot,
+  ContinuousPlot,
+  Count           //< number of tags, not a tag
+};
+
+/*! \var WELL_KNOWN_FORMS
+\brief The special form named by each WellKnownSymbol, indexed by ID.
+
+Built at compile time; names that are not special forms map to Call.
+ */
+constexpr SpecialForm WELL_KNOWN_FORMS[WellKnownSymbolCount] = {
+  SpecialForm::List,
+  SpecialForm::Begin,
+  SpecialForm::Define,
+  SpecialForm::Lambda,
+  SpecialForm::Apply,
+  SpecialForm::Map,
+  SpecialForm::SetProperty,
+  SpecialForm::GetProperty,
+  SpecialForm::DiscretePlot,
+  SpecialForm::ContinuousPlot,
+  SpecialForm::Call, // pi
+  SpecialForm::Call, // e
+  SpecialForm::Call, // I
+  SpecialForm::Call, SpecialForm::Call, SpecialForm::Call, // property keys
+  SpecialForm::Call, SpecialForm::Call, SpecialForm::Call,
+  SpecialForm::Call, SpecialForm::Call, SpecialForm::Call
+};
+
+static_assert(WELL_KNOWN_FORMS[ListSymbol] == SpecialForm::List &&
+              WELL_KNOWN_FORMS[ContinuousPlotSymbol] == SpecialForm::ContinuousPlot &&
+              WELL_KNOWN_FORMS[PiSymbol] == SpecialForm::Call,
+              "WELL_KNOWN_FORMS out of step with WellKnownSymbol");
+
+/*! \fn specialForm
+\brief the special form named by a head Atom
+
+\param head the head of an Expression node
+\return the special form head names, or Call if it names none
+
+Constant time and allocation-free: special-form names are interned with
+reserved IDs, so this is a bounds check and a table load.
+ */
+inline SpecialForm specialForm(const Atom & head) noexcept {
+  if(head.isSymbol() && head.symbolId() < WellKnownSymbolCount){
+    return WELL_KNOWN_FORMS[head.symbolId()];
+  }
+  return SpecialForm::Call;
+}
+
+/*! \fn resolveForm
+\brief the tag an Expression node with this head and tail is evaluated by
+
+\param head the head of the node
+\param tailEmpty true if the node has no tail
+\return the node's tag, never Unresolved
+ */
+inline SpecialForm resolveForm(const Atom & head, bool tailEmpty) noexcept {
+  SpecialForm form = specialForm(head);
+  if(form == SpecialForm::List){
+    return form;
+  }
+  return tailEmpty ? SpecialForm::Lookup : form;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#include "symbol_table.hpp"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// names of the WellKnownSymbol IDs, in order
+const char * const WELL_KNOWN_NAMES[WellKnownSymbolCount] = {
+  "list", "begin", "define", "lambda", "apply", "map",
+  "set-property", "get-property", "discrete-plot", "continuous-plot",
+  "pi", "e", "I",
+  "\"object-name\"", "\"size\"", "\"thickness\"", "\"position\"",
+  "\"text-scale\"", "\"text-rotation\"", "type", "numpoints", "numoptions"
+};
+
+// The names are stored by ID in chunks that double in size and are never
+// moved or freed, so a name can be read while others are being added.
+// Chunk k holds the IDs from (FIRST_CHUNK << k) - FIRST_CHUNK on; CHUNKS of
+// them hold every SymbolId.
+const std::uint64_t FIRST_CHUNK = 64;
+const std::size_t CHUNKS = 27;
+
+// the IDs of names, split by hash so interning locks only one shard
+const std::size_t SHARDS = 16;
+
+struct Shard {
+  std::mutex mutex;
+  std::unordered_map<std::string, SymbolId> ids;
+};
+
+struct Table {
+  std::atomic<std::string *> chunks[CHUNKS];
+
+  // the number of IDs assigned
+  std::atomic<std::uint64_t> count;
+
+  Shard shards[SHARDS];
+
+  Table(): count(0) {
+    for(auto & chunk : chunks){
+      chunk.store(nullptr, std::memory_order_relaxed);
+    }
+    for(SymbolId id = 0; id < WellKnownSymbolCount; ++id){
+      intern(WELL_KNOWN_NAMES[id]);
+    }
+  }
+
+  ~Table(){
+    for(auto & chunk : chunks){
+      delete[] chunk.load(std::memory_order_relaxed);
+    }
+  }
+
+  // find the chunk of an ID and its index there
+  static void locate(SymbolId id, std::size_t & chunk, std::size_t & index) noexcept {
+    std::uint64_t n = id + FIRST_CHUNK;
+    chunk = 0;
+    while((FIRST_CHUNK << (chunk + 1)) <= n){
+      ++chunk;
+    }
+    index = n - (FIRST_CHUNK << chunk);
+  }
+
+  // the storage for the name of an ID, creating its chunk if needed
+  std::string & slot(SymbolId id){
+    std::size_t chunk, index;
+    locate(id, chunk, index);
+    std::string * names = chunks[chunk].load(std::memory_order_acquire);
+    if(!names){
+      // another thread may create the same chunk, keep whichever lands first
+      std::string * fresh = new std::string[FIRST_CHUNK << chunk];
+      if(chunks[chunk].compare_exchange_strong(names, fresh, std::memory_order_acq_rel)){
+        names = fresh;
+      }
+      else{
+        delete[] fresh;
+      }
+    }
+    return names[index];
+  }
+
+  SymbolId intern(const std::string & name){
+
+    Shard & shard = shards[std::hash<std::string>()(name) % SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto result = shard.ids.find(name);
+    if(result != shard.ids.end()){
+      return result->second;
+    }
+
+    // the name is stored before its ID is published, through the shard's
+    // lock or by whatever hands the ID to another thread
+    std::uint64_t id = count.fetch_add(1, std::memory_order_relaxed);
+    if(id > UINT32_MAX){
+      count.fetch_sub(1, std::memory_order_relaxed);
+      throw std::length_error("Error: too many symbols");
+    }
+    slot(id) = name;
+    shard.ids.emplace(name, id);
+    return id;
+  }
+
+  const std::string & name(SymbolId id) const{
+    if(id >= count.load(std::memory_order_acquire)){
+      throw std::out_of_range("Error: unknown symbol ID");
+    }
+    std::size_t chunk, index;
+    locate(id, chunk, index);
+    return chunks[chunk].load(std::memory_order_acquire)[index];
+  }
+};
+
+// construct on first use so Atoms in static initializers are safe
+Table & table(){
+  static Table t;
+  return t;
+}
+
+}
+
+SymbolId SymbolTable::intern(const std::string & name){
+  return table().intern(name);
+}
+
+const std::string & SymbolTable::name(SymbolId id){
+  return table().name(id);
+}
+
+std::size_t SymbolTable::size(){
+  return table().count.load(std::memory_order_acquire);
+}
@@ -0,0 +1,80 @@
+/*! \file symbol_table.hpp
+Defines the process-wide table that interns symbol names.
+ */
+#ifndef SYMBOL_TABLE_HPP
+#define SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <string>
+
+/*! \typedef SymbolId
+\brief The integer a symbol name is interned to.
+ */
+typedef std::uint32_t SymbolId;
+
+/*! \enum WellKnownSymbol
+\brief IDs reserved for the names the interpreter itself gives meaning to.
+
+The table interns these names first and in this order, so their IDs are
+compile-time constants. Property keys are interned in the same table, so
+the keys the renderer reads are reserved here too.
+ */
+enum WellKnownSymbol : SymbolId {
+  ListSymbol,
+  BeginSymbol,
+  DefineSymbol,
+  LambdaSymbol,
+  ApplySymbol,
+  MapSymbol,
+  SetPropertySymbol,
+  GetPropertySymbol,
+  DiscretePlotSymbol,
+  ContinuousPlotSymbol,
+  PiSymbol,
+  ESymbol,
+  ISymbol,
+  ObjectNameProperty,    //< "object-name", the kind of a graphic
+  SizeProperty,          //< "size" of a point
+  ThicknessProperty,     //< "thickness" of a line
+  PositionProperty,      //< "position" of text
+  TextScaleProperty,     //< "text-scale" of text
+  TextRotationProperty,  //< "text-rotation" of text
+  TypeProperty,          //< type of a plot
+  NumPointsProperty,     //< numpoints of a plot
+  NumOptionsProperty,    //< numoptions of a plot
+  WellKnownSymbolCount
+};
+
+/*! \class SymbolTable
+\brief Maps symbol names to small integer IDs and back.
+
+Every distinct name is assigned an ID the first time it is interned; the
+same name always yields the same ID for the lifetime of the process, so
+symbols can be compared and hashed as integers. Names are never freed, so
+only symbols and property keys are interned, not strings a program builds.
+
+The table is shared by all threads and may be used concurrently. Looking up
+the name of an ID takes no lock. Interning locks one of several shards of
+the table, chosen by the name, so threads interning different names rarely
+wait for each other.
+ */
+class SymbolTable {
+public:
+
+  /*! Intern a name.
+    \param name the symbol name
+    \return the ID of name, assigning a new one if it has not been seen
+   */
+  static SymbolId intern(const std::string & name);
+
+  /*! Look up the name of an interned symbol.
+    \param id an ID previously returned by intern
+    \return the name, which remains valid for the lifetime of the process
+   */
+  static const std::string & name(SymbolId id);
+
+  /// return the number of distinct symbols interned so far
+  static std::size_t size();
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "catch.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "symbol_table.hpp"
+#include "atom.hpp"
+
+TEST_CASE( "Test interning symbols", "[symbol_table]" ) {
+
+  SymbolId a = SymbolTable::intern("an-interned-symbol");
+  SymbolId b = SymbolTable::intern("another-interned-symbol");
+
+  REQUIRE(a != b);
+  REQUIRE(SymbolTable::intern("an-interned-symbol") == a);
+  REQUIRE(SymbolTable::name(a) == "an-interned-symbol");
+  REQUIRE(SymbolTable::name(b) == "another-interned-symbol");
+}
+
+TEST_CASE( "Test well-known symbols", "[symbol_table]" ) {
+
+  REQUIRE(SymbolTable::intern("list") == ListSymbol);
+  REQUIRE(SymbolTable::intern("begin") == BeginSymbol);
+  REQUIRE(SymbolTable::intern("continuous-plot") == ContinuousPlotSymbol);
+  REQUIRE(SymbolTable::intern("I") == ISymbol);
+  REQUIRE(SymbolTable::name(DefineSymbol) == "define");
+  REQUIRE(SymbolTable::intern("\"object-name\"") == ObjectNameProperty);
+  REQUIRE(SymbolTable::intern("numoptions") == NumOptionsProperty);
+  REQUIRE(SymbolTable::size() >= WellKnownSymbolCount);
+}
+
+TEST_CASE( "Test symbol atoms carry interned IDs", "[symbol_table]" ) {
+
+  Atom a("symbol-id-test");
+  Atom b(Token("symbol-id-test"));
+
+  REQUIRE(a.isSymbol());
+  REQUIRE(a.symbolId() == b.symbolId());
+  REQUIRE(a.symbolId() == SymbolTable::intern("symbol-id-test"));
+  REQUIRE(a.asSymbol() == "symbol-id-test");
+
+  // strings are not interned as symbols
+  Atom s("\"symbol-id-test\"");
+  REQUIRE(s.isString());
+  REQUIRE(s != a);
+}
+
+TEST_CASE( "Test strings are not interned", "[symbol_table]" ) {
+
+  std::size_t before = SymbolTable::size();
+  for(int i = 0; i < 100; ++i){
+    Atom s("\"label " + std::to_string(i) + "\"");
+    REQUIRE(s.isString());
+  }
+  REQUIRE(SymbolTable::size() == before);
+}
+
+TEST_CASE( "Test interning from several threads", "[symbol_table]" ) {
+
+  const int nthreads = 4;
+  std::vector<std::vector<SymbolId>> ids(nthreads);
+  std::vector<std::thread> threads;
+
+  for(int t = 0; t < nthreads; ++t){
+    threads.emplace_back([t, &ids](){
+      for(int i = 0; i < 100; ++i){
+        ids[t].push_back(SymbolTable::intern("threaded-" + std::to_string(i)));
+      }
+    });
+  }
+  for(auto & th : threads){
+    th.join();
+  }
+
+  for(int t = 1; t < nthreads; ++t){
+    REQUIRE(ids[t] == ids[0]);
+  }
+  REQUIRE(SymbolTable::name(ids[0][42]) == "threaded-42");
+}
+
+TEST_CASE( "Test names stay valid as the table grows", "[symbol_table]" ) {
+
+  // enough names to fill several chunks of the table
+  SymbolId first = SymbolTable::intern("growth-0");
+  const std::string & name = SymbolTable::name(first);
+  std::vector<SymbolId> ids;
+  for(int i = 0; i < 5000; ++i){
+    ids.push_back(SymbolTable::intern("growth-" + std::to_string(i)));
+  }
+
+  REQUIRE(&SymbolTable::name(first) == &name);
+  REQUIRE(name == "growth-0");
+  bool named = true;
+  for(int i = 0; i < 5000; ++i){
+    named = named && SymbolTable::name(ids[i]) == "growth-" + std::to_string(i);
+  }
+  REQUIRE(named);
+  REQUIRE_THROWS_AS(SymbolTable::name(static_cast<SymbolId>(SymbolTable::size())), std::out_of_range);
+}
@@ -0,0 +1,153 @@
+#include "syntax_tree.hpp"
+
+#include <iterator>
+
+const NodeId SyntaxTree::NONE;
+
+SyntaxTree::SyntaxTree() noexcept {}
+
+SyntaxTree::SyntaxTree(const Expression & exp){
+
+  // visit the nodes in order, each keeping the form the Expression has
+  struct Pending {
+    Expression exp;
+    NodeId parent;
+  };
+  std::vector<Pending> pending;
+  pending.push_back(Pending{exp, NONE});
+
+  // the last child linked to each node so far
+  std::vector<NodeId> last;
+
+  while(!pending.empty()){
+    Pending p = std::move(pending.back());
+    pending.pop_back();
+
+    NodeId node = addNode(p.exp.head());
+    m_forms[node] = p.exp.form();
+    last.push_back(NONE);
+    if(p.parent != NONE){
+      attach(p.parent, last[p.parent], node);
+      last[p.parent] = node;
+    }
+
+    for(std::size_t i = p.exp.tailLength(); i-- > 0;){
+      pending.push_back(Pending{p.exp.item(i), node});
+    }
+  }
+}
+
+NodeId SyntaxTree::child(NodeId n, std::size_t i) const noexcept{
+
+  NodeId c = m_firstChild[n];
+  for(; i > 0; --i){
+    c = m_nextSibling[c];
+  }
+  return c;
+}
+
+Expression SyntaxTree::toExpression(NodeId n) const{
+
+  // build each node after its children, whose Expressions wait on built
+  struct Frame {
+    NodeId node;
+    NodeId next;
+    std::size_t first;
+  };
+  std::vector<Frame> frames;
+  std::vector<Expression> built;
+
+  frames.push_back(Frame{n, m_firstChild[n], 0});
+  while(true){
+    Frame & f = frames.back();
+    if(f.next != NONE){
+      NodeId c = f.next;
+      f.next = m_nextSibling[c];
+      frames.push_back(Frame{c, m_firstChild[c], built.size()});
+      continue;
+    }
+
+    Expression e = (built.size() > f.first) ?
+      Expression(m_heads[f.node], built.data() + f.first, built.data() + built.size()) :
+      Expression(m_heads[f.node]);
+    built.resize(f.first);
+    frames.pop_back();
+
+    if(frames.empty()){
+      return e;
+    }
+    built.push_back(std::move(e));
+  }
+}
+
+Expression SyntaxTree::toExpression() const{
+  return empty() ? Expression() : toExpression(root());
+}
+
+std::size_t SyntaxTree::memoryUsage() const noexcept{
+  return m_heads.capacity() * sizeof(Atom) +
+    m_forms.capacity() * sizeof(SpecialForm) +
+    (m_firstChild.capacity() + m_nextSibling.capacity() + m_childCount.capacity()) * sizeof(NodeId);
+}
+
+void SyntaxTree::reserve(std::size_t nodes){
+  m_heads.reserve(nodes);
+  m_forms.reserve(nodes);
+  m_firstChild.reserve(nodes);
+  m_nextSibling.reserve(nodes);
+  m_childCount.reserve(nodes);
+}
+
+void SyntaxTree::clear() noexcept{
+  m_heads.clear();
+  m_forms.clear();
+  m_firstChild.clear();
+  m_nextSibling.clear();
+  m_childCount.clear();
+}
+
+NodeId SyntaxTree::addNode(const Atom & a){
+
+  m_heads.push_back(a);
+  m_forms.push_back(resolveForm(a, true));
+  m_firstChild.push_back(NONE);
+  m_nextSibling.push_back(NONE);
+  m_childCount.push_back(0);
+  return static_cast<NodeId>(m_heads.size() - 1);
+}
+
+void SyntaxTree::attach(NodeId parent, NodeId previous, NodeId child) noexcept{
+
+  if(previous == NONE){
+    m_firstChild[parent] = child;
+  }
+  else{
+    m_nextSibling[previous] = child;
+  }
+  ++m_childCount[parent];
+}
+
+void SyntaxTree::link(NodeId parent, NodeId previous, NodeId child) noexcept{
+
+  if(m_childCount[parent] == 0){
+    m_forms[parent] = resolveForm(m_heads[parent], false);
+  }
+  attach(parent, previous, child);
+}
+
+NodeId SyntaxTree::splice(const SyntaxTree & other){
+
+  NodeId offset = static_cast<NodeId>(size());
+  auto shift = [offset](NodeId n){ return n == NONE ? NONE : n + offset; };
+
+  m_heads.insert(m_heads.end(), other.m_heads.begin(), other.m_heads.end());
+  m_forms.insert(m_forms.end(), other.m_forms.begin(), other.m_forms.end());
+  m_childCount.insert(m_childCount.end(), other.m_childCount.begin(), other.m_childCount.end());
+  for(NodeId n : other.m_firstChild){
+    m_firstChild.push_back(shift(n));
+  }
+  for(NodeId n : other.m_nextSibling){
+    m_nextSibling.push_back(shift(n));
+  }
+  return offset;
+}
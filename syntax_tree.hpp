@@ -0,0 +1,115 @@
+/*! \file syntax_tree.hpp
+Defines the SyntaxTree type, the parsed form of a program.
+ */
+#ifndef SYNTAX_TREE_HPP
+#define SYNTAX_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "atom.hpp"
+#include "expression.hpp"
+#include "special_forms.hpp"
+
+/*! \typedef NodeId
+\brief The index of a node in a SyntaxTree.
+ */
+typedef std::uint32_t NodeId;
+
+/*! \class SyntaxTree
+\brief A parsed program, stored as a flat pool of nodes.
+
+Each node is an index into parallel arrays: its head Atom, the special
+form it is evaluated by, its first child, its next sibling and its number
+of children. A program is a handful of arrays however many nodes it has,
+walking it reads them in order, and memoryUsage reports exactly what it
+holds.
+
+The root is node 0, and a node is always added before its children. The
+parser builds trees with addNode and link; Expressions are built from a
+tree only when a tree-walking evaluation needs them.
+ */
+class SyntaxTree {
+public:
+
+  /// the index of no node: the child of a leaf, the sibling of a last child
+  static const NodeId NONE = 0xFFFFFFFF;
+
+  /// construct an empty tree, the result of a failed parse
+  SyntaxTree() noexcept;
+
+  /// construct the tree of an expression
+  explicit SyntaxTree(const Expression & exp);
+
+  /// true if the tree has no nodes
+  bool empty() const noexcept { return m_heads.empty(); }
+
+  /// return the number of nodes
+  std::size_t size() const noexcept { return m_heads.size(); }
+
+  /// return the root node, which the tree must have
+  NodeId root() const noexcept { return 0; }
+
+  /// return the head of node n
+  const Atom & head(NodeId n) const noexcept { return m_heads[n]; }
+
+  /// return the special form node n is evaluated by
+  SpecialForm form(NodeId n) const noexcept { return m_forms[n]; }
+
+  /// return the first child of node n, or NONE
+  NodeId firstChild(NodeId n) const noexcept { return m_firstChild[n]; }
+
+  /// return the child of node n's parent after n, or NONE
+  NodeId nextSibling(NodeId n) const noexcept { return m_nextSibling[n]; }
+
+  /// return the number of children of node n
+  std::size_t childCount(NodeId n) const noexcept { return m_childCount[n]; }
+
+  /// return the i-th child of node n, which must have one
+  NodeId child(NodeId n, std::size_t i) const noexcept;
+
+  /// return the Expression node n is the root of
+  Expression toExpression(NodeId n) const;
+
+  /// return the Expression of the whole tree, or the None Expression if it is empty
+  Expression toExpression() const;
+
+  /// return the bytes the tree's arrays hold
+  std::size_t memoryUsage() const noexcept;
+
+  /// make room for nodes nodes, so building the tree does not reallocate
+  void reserve(std::size_t nodes);
+
+  /// remove every node
+  void clear() noexcept;
+
+  /// add a node with head a and no children, returning its index
+  NodeId addNode(const Atom & a);
+
+  /*! Make child the next child of parent.
+    \param parent the node to add to
+    \param previous parent's last child, or NONE if it has none
+    \param child the node to add, which has no parent
+   */
+  void link(NodeId parent, NodeId previous, NodeId child) noexcept;
+
+  /*! Append the nodes of another tree.
+    \param other the tree to copy
+    \return the index the nodes of other are offset by
+   */
+  NodeId splice(const SyntaxTree & other);
+
+private:
+
+  std::vector<Atom> m_heads;
+  std::vector<SpecialForm> m_forms;
+  std::vector<NodeId> m_firstChild;
+  std::vector<NodeId> m_nextSibling;
+  std::vector<NodeId> m_childCount;
+
+  // link child after previous without resolving parent's form again
+  void attach(NodeId parent, NodeId previous, NodeId child) noexcept;
+};
+
+#endif
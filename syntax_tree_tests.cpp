@@ -0,0 +1,99 @@
+#include "catch.hpp"
+
+#include <string>
+
+#include "parse.hpp"
+#include "syntax_tree.hpp"
+
+static SyntaxTree parse_tree(const std::string & program){
+  return parseTree(tokenize(program.data(), program.data() + program.size()));
+}
+
+TEST_CASE( "Test syntax tree of a program", "[syntax_tree]" ) {
+
+  SyntaxTree tree = parse_tree("(begin (define a 1) (+ a 2) (list))");
+  REQUIRE(tree.size() == 8);
+
+  NodeId root = tree.root();
+  REQUIRE(tree.head(root) == Atom("begin"));
+  REQUIRE(tree.form(root) == SpecialForm::Begin);
+  REQUIRE(tree.childCount(root) == 3);
+
+  NodeId define = tree.firstChild(root);
+  REQUIRE(tree.form(define) == SpecialForm::Define);
+  REQUIRE(tree.head(tree.child(define, 1)) == Atom(1.));
+  REQUIRE(tree.form(tree.child(define, 1)) == SpecialForm::Lookup);
+
+  NodeId add = tree.nextSibling(define);
+  REQUIRE(tree.form(add) == SpecialForm::Call);
+  REQUIRE(tree.childCount(add) == 2);
+
+  NodeId list = tree.child(root, 2);
+  REQUIRE(tree.form(list) == SpecialForm::List);
+  REQUIRE(tree.childCount(list) == 0);
+  REQUIRE(tree.firstChild(list) == SyntaxTree::NONE);
+  REQUIRE(tree.nextSibling(list) == SyntaxTree::NONE);
+
+  INFO("a node comes before its children");
+  for(NodeId n = 0; n < tree.size(); ++n){
+    for(NodeId c = tree.firstChild(n); c != SyntaxTree::NONE; c = tree.nextSibling(c)){
+      REQUIRE(c > n);
+    }
+  }
+
+  INFO("a failed parse is an empty tree");
+  REQUIRE(parse_tree("(begin (define a 1)").empty());
+  REQUIRE(parse_tree("(begin (define a 1abc))").empty());
+  REQUIRE(parse_tree("").toExpression() == Expression());
+}
+
+TEST_CASE( "Test syntax tree and Expression convert both ways", "[syntax_tree]" ) {
+
+  std::string program = "(begin (define f (lambda (x y) (+ x y))) (f \"s\" (list 1 2 3)) (- 1))";
+  SyntaxTree tree = parse_tree(program);
+
+  Expression exp = tree.toExpression();
+  REQUIRE(exp.head() == Atom("begin"));
+  REQUIRE(exp.tailLength() == 3);
+
+  SyntaxTree again(exp);
+  REQUIRE(again.size() == tree.size());
+  for(NodeId n = 0; n < tree.size(); ++n){
+    REQUIRE(again.head(n) == tree.head(n));
+    REQUIRE(again.form(n) == tree.form(n));
+    REQUIRE(again.childCount(n) == tree.childCount(n));
+  }
+  REQUIRE(again.toExpression() == exp);
+
+  INFO("a subtree converts on its own");
+  NodeId lambda = tree.child(tree.firstChild(tree.root()), 1);
+  Expression sub = tree.toExpression(lambda);
+  REQUIRE(sub.head() == Atom("lambda"));
+  REQUIRE(sub.tailLength() == 2);
+}
+
+TEST_CASE( "Test syntax tree storage", "[syntax_tree]" ) {
+
+  std::string program = "(list";
+  for(int i = 0; i < 1000; ++i){
+    program += " (list " + std::to_string(i) + " " + std::to_string(-i) + ")";
+  }
+  program += ")";
+
+  TokenViewSequenceType tokens = tokenize(program.data(), program.data() + program.size());
+  SyntaxTree tree = parseTree(tokens);
+  REQUIRE(tree.size() == 3001);
+
+  // each array was sized once, from the token count
+  std::size_t perNode = sizeof(Atom) + sizeof(SpecialForm) + 3 * sizeof(NodeId);
+  REQUIRE(tree.memoryUsage() == tokens.size() * perNode);
+
+  INFO("splicing offsets the links of the nodes appended");
+  SyntaxTree joined = parse_tree("(a b)");
+  NodeId offset = joined.splice(parse_tree("(c (d))"));
+  REQUIRE(offset == 2);
+  REQUIRE(joined.size() == 4);
+  REQUIRE(joined.firstChild(offset) == offset + 1);
+  REQUIRE(joined.head(offset + 1) == Atom("d"));
+  REQUIRE(joined.childCount(joined.root()) == 1);
+}
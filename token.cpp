@@ -1,5 +1,41 @@
 #include "token.hpp"
 
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <stdexcept>
+
+// the delimiter scan is vectorized where the target has SSE2, and wider
+// where the processor has AVX2: always if the build enables it, otherwise
+// after a check at run time on x86 under GCC and Clang. Other targets
+// scan one character at a time
+#if defined(__AVX2__)
+#define TOKEN_SCAN_AVX2 1
+#define TOKEN_SCAN_AVX2_TARGET
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TOKEN_SCAN_AVX2 1
+#define TOKEN_SCAN_AVX2_DISPATCH 1
+#define TOKEN_SCAN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TOKEN_SCAN_SSE2 1
+#endif
+
+#if defined(TOKEN_SCAN_AVX2)
+#include <immintrin.h>
+#elif defined(TOKEN_SCAN_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(TOKEN_SCAN_SSE2)
+#include <intrin.h>
+#endif
+
 // define constants for special characters
 const char OPENCHAR = '(';
 const char CLOSECHAR = ')';
@@ -23,63 +59,388 @@ std::string Token::asString() const{
       return "(";
     case CLOSE:
       return ")";
+    case STRING:
+    case NUMBER:
+    case SYMBOL:
+      break;
     }
     return value;
 }
 
 
-// add token to sequence unless it is empty, clears token
-void store_ifnot_empty(std::string & token, TokenSequenceType & seq){
-  if(!token.empty()){
-    seq.emplace_back(token);
-    token.clear();
+namespace {
+
+// how the buffer tokenizer treats each character
+enum CharClass : unsigned char {PlainChar, SpaceChar, OpenChar, CloseChar, QuoteChar, CommentChar};
+
+// the class of every char value; spaces are those std::isspace accepts in
+// the "C" locale, without its per-character lookup through the locale
+struct CharClassTable {
+  CharClass classes[256];
+
+  CharClassTable() noexcept {
+    for(CharClass & c : classes){
+      c = PlainChar;
+    }
+    for(unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}){
+      classes[c] = SpaceChar;
+    }
+    classes[static_cast<unsigned char>(OPENCHAR)] = OpenChar;
+    classes[static_cast<unsigned char>(CLOSECHAR)] = CloseChar;
+    classes[static_cast<unsigned char>(QUOTECHAR)] = QuoteChar;
+    classes[static_cast<unsigned char>(COMMENTCHAR)] = CommentChar;
   }
+
+  CharClass operator[](char c) const noexcept {
+    return classes[static_cast<unsigned char>(c)];
+  }
+};
+
+const CharClassTable CHAR_CLASS;
+
+// the index of the lowest set bit of a nonzero mask
+inline unsigned lowestBit(std::uint64_t mask) noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return index;
+#elif defined(_MSC_VER)
+  unsigned long index;
+  if(_BitScanForward(&index, static_cast<unsigned long>(mask))) return index;
+  _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+  return index + 32;
+#else
+  return __builtin_ctzll(mask);
+#endif
 }
 
-TokenSequenceType tokenize(std::istream & seq){
-  TokenSequenceType tokens;
-  std::string token;
+#ifdef TOKEN_SCAN_SSE2
+
+// one bit for each of the 16 bytes that is not a PlainChar
+inline std::uint64_t delimiterMask(__m128i bytes) noexcept {
+
+  // '\t' through '\r' are the control characters that are spaces
+  __m128i control = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+  __m128i delimiters = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+
+  delimiters = _mm_or_si128(delimiters, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+  delimiters = _mm_or_si128(delimiters, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(OPENCHAR)));
+  delimiters = _mm_or_si128(delimiters, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(CLOSECHAR)));
+  delimiters = _mm_or_si128(delimiters, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(QUOTECHAR)));
+  delimiters = _mm_or_si128(delimiters, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(COMMENTCHAR)));
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(delimiters));
+}
+
+#endif
+
+#ifdef TOKEN_SCAN_AVX2
+
+// one bit for each of the 32 bytes that is not a PlainChar
+TOKEN_SCAN_AVX2_TARGET inline std::uint64_t delimiterMask(__m256i bytes) noexcept {
+
+  __m256i control = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+  __m256i delimiters = _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control);
+
+  delimiters = _mm256_or_si256(delimiters, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')));
+  delimiters = _mm256_or_si256(delimiters, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(OPENCHAR)));
+  delimiters = _mm256_or_si256(delimiters, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(CLOSECHAR)));
+  delimiters = _mm256_or_si256(delimiters, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(QUOTECHAR)));
+  delimiters = _mm256_or_si256(delimiters, _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(COMMENTCHAR)));
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(delimiters));
+}
+
+// one bit for each of the 64 bytes at c that is not a PlainChar
+TOKEN_SCAN_AVX2_TARGET std::uint64_t blockMaskAVX2(const char * c) noexcept {
+  return delimiterMask(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(c))) |
+    delimiterMask(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(c + 32))) << 32;
+}
 
-  while(true){
-    char c = seq.get();
-    if(seq.eof()) break;
+#endif
 
-    if(c == COMMENTCHAR){
-      // chomp until the end of the line
-      while((!seq.eof()) && (c != '\n')){
-	      c = seq.get();
+// true if the processor running the scan has AVX2
+bool hasAVX2() noexcept {
+#if defined(TOKEN_SCAN_AVX2_DISPATCH)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+#elif defined(TOKEN_SCAN_AVX2)
+  return true;
+#else
+  return false;
+#endif
+}
+
+/* Finds the characters that end plain runs: spaces, parentheses, quotes
+   and comment starts.
+
+   Tokens in data scripts are a few characters long, so a scan per token
+   would load a whole vector to find one delimiter. Instead the scanner
+   classifies a 64-character block at a time into a bit mask, one bit per
+   delimiter, and answers each query from the mask until the tokenizer
+   moves past the block. A block that would run past the end of the input
+   is classified through the character table, as is every block where the
+   target has no vector unit, so all paths give the same tokens.
+ */
+class DelimiterScanner {
+public:
+
+  static const std::size_t BLOCK = 64;
+
+  DelimiterScanner(const char * first, const char * last) noexcept:
+    m_block(first), m_last(last), m_avx2(hasAVX2()), m_mask(classify(first)) {}
+
+  // the first delimiter at or after c, or last
+  const char * next(const char * c) noexcept {
+
+    while(true){
+      std::size_t offset = c - m_block;
+      if(offset < BLOCK){
+        std::uint64_t mask = m_mask & (~std::uint64_t(0) << offset);
+        if(mask){
+          return m_block + lowestBit(mask);
+        }
+        // the delimiters of a block at the end are all in its mask
+        if(static_cast<std::size_t>(m_last - m_block) <= BLOCK){
+          return m_last;
+        }
+        c = m_block + BLOCK;
       }
-      if(seq.eof()) break;
-    }
-    else if(c == OPENCHAR){ // c == (
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::OPEN);
-    }
-    else if(c == CLOSECHAR){ // c == )
-      store_ifnot_empty(token, tokens);
-      tokens.push_back(Token::TokenType::CLOSE);
-    }
-    else if(c == QUOTECHAR){ // c == " (BEGIN SPECIAL CASE)
-      token.push_back(QUOTECHAR);
-      c = seq.get();
-      while(!seq.eof() && c != QUOTECHAR){
-	      token.push_back(c);
-        c = seq.get();
+      m_block = c;
+      m_mask = classify(c);
+    }
+  }
+
+private:
+
+  // the first character of the classified block, which may be last
+  const char * m_block;
+  const char * m_last;
+
+  // true to classify whole blocks with AVX2
+  bool m_avx2;
+
+  // bit i is set if m_block[i] is a delimiter
+  std::uint64_t m_mask;
+
+  std::uint64_t classify(const char * c) const noexcept {
+
+    std::size_t n = m_last - c;
+#if defined(TOKEN_SCAN_AVX2)
+    if(n >= BLOCK && m_avx2){
+      return blockMaskAVX2(c);
+    }
+#endif
+#if defined(TOKEN_SCAN_SSE2)
+    if(n >= BLOCK){
+      return delimiterMask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(c))) |
+        delimiterMask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(c + 16))) << 16 |
+        delimiterMask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(c + 32))) << 32 |
+        delimiterMask(_mm_loadu_si128(reinterpret_cast<const __m128i *>(c + 48))) << 48;
+    }
+#endif
+    std::uint64_t mask = 0;
+    for(std::size_t i = 0, end = n < BLOCK ? n : BLOCK; i < end; ++i){
+      mask |= std::uint64_t(CHAR_CLASS[c[i]] != PlainChar) << i;
+    }
+    return mask;
+  }
+};
+
+// the powers of ten a double holds exactly
+const double EXACT_POWERS_OF_TEN[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// the value of a literal the fast path cannot round exactly, read as the
+// istream parser did but in the classic locale; false if it overflows
+bool parseNumberSlowly(const char * first, const char * last, double & value){
+  std::istringstream iss(std::string(first, last));
+  iss.imbue(std::locale::classic());
+  return static_cast<bool>(iss >> value);
+}
+
+bool isDigit(char c) noexcept {
+  return c >= '0' && c <= '9';
+}
+
+}
+
+bool parseNumber(const char * first, const char * last, double & value) noexcept{
+
+  const char * c = first;
+  bool negative = (c != last && (*c == '-' || *c == '+')) ? *c++ == '-' : false;
+
+  // up to 19 significant digits fit the mantissa; any more that are not
+  // zero make it inexact
+  std::uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool inexact = false;
+  bool any = false;
+
+  auto digit = [&](char d, bool fraction){
+    any = true;
+    if(mantissa == 0 && d == '0'){
+      exponent -= fraction;
+    }
+    else if(digits < 19){
+      mantissa = 10 * mantissa + (d - '0');
+      ++digits;
+      exponent -= fraction;
+    }
+    else{
+      inexact = inexact || d != '0';
+      exponent += !fraction;
+    }
+  };
+
+  for(; c != last && isDigit(*c); ++c){
+    digit(*c, false);
+  }
+  if(c != last && *c == '.'){
+    for(++c; c != last && isDigit(*c); ++c){
+      digit(*c, true);
+    }
+  }
+  if(!any){
+    return false;
+  }
+
+  if(c != last && (*c == 'e' || *c == 'E')){
+    ++c;
+    bool negativeExponent = (c != last && (*c == '-' || *c == '+')) ? *c++ == '-' : false;
+    if(c == last || !isDigit(*c)){
+      return false;
+    }
+    int e = 0;
+    for(; c != last && isDigit(*c); ++c){
+      // saturate far beyond any exponent a double can reach
+      e = (e < 100000) ? 10 * e + (*c - '0') : e;
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+  if(c != last){
+    return false;
+  }
+
+  if(mantissa == 0){
+    value = negative ? -0.0 : 0.0;
+    return true;
+  }
+
+  // Clinger's fast path: a mantissa and a power of ten that are both exact
+  // doubles give an exactly rounded result from one multiply or divide,
+  // provided arithmetic is done in double precision
+#if FLT_EVAL_METHOD == 0
+  if(!inexact && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22){
+    double m = static_cast<double>(mantissa);
+    value = exponent < 0 ? m / EXACT_POWERS_OF_TEN[-exponent] : m * EXACT_POWERS_OF_TEN[exponent];
+    value = negative ? -value : value;
+    return true;
+  }
+#endif
+
+  try{
+    return parseNumberSlowly(first, last, value);
+  }
+  catch(const std::exception &){
+    return false;
+  }
+}
+
+TokenViewSequenceType tokenize(const char * first, const char * last){
+
+  if(static_cast<std::size_t>(last - first) > TokenView::MAX_SOURCE){
+    throw std::length_error("source too large to tokenize");
+  }
+
+  // a token is at least one character and a delimiter, so this is at most
+  // one reallocation for typical programs
+  TokenViewSequenceType tokens;
+  tokens.reserve((last - first) / 4 + 1);
+
+  // the start of the STRING token being read, or nullptr between tokens
+  const char * token = nullptr;
+
+  const double notNumber = std::numeric_limits<double>::quiet_NaN();
+
+  // add the token ending at end to the sequence, unless there is none,
+  // parsing it if it may be a number
+  auto store = [&](const char * end){
+    if(token){
+      double number = notNumber;
+      if((isDigit(*token) || *token == '-' || *token == '+' || *token == '.') &&
+         !parseNumber(token, end, number)){
+        number = notNumber;
       }
-      if(seq.eof()) {
+      tokens.emplace_back(token, end - token, token - first, number);
+      token = nullptr;
+    }
+  };
+
+  DelimiterScanner delimiters(first, last);
+
+  const char * c = first;
+  while(c != last){
+
+    switch(CHAR_CLASS[*c]){
+      case PlainChar:
+        // the rest of the token's plain characters
+        if(!token) token = c;
+        c = delimiters.next(c + 1);
+        break;
+
+      case SpaceChar:
+        store(c);
+        ++c;
+        break;
+
+      case OpenChar:
+      case CloseChar:
+        store(c);
+        tokens.emplace_back(c, 1, c - first, notNumber);
+        ++c;
+        break;
+
+      case QuoteChar:
+        {
+          // the quoted text, with both quotes, joins any token before it
+          if(!token) token = c;
+          const char * close = static_cast<const char *>(std::memchr(c + 1, QUOTECHAR, last - c - 1));
+          // an unterminated string runs to the end of the input
+          c = close ? close + 1 : last;
+          store(c);
+        }
+        break;
+
+      case CommentChar:
+        {
+          // chomp until the end of the line
+          store(c);
+          const char * newline = static_cast<const char *>(std::memchr(c, '\n', last - c));
+          c = newline ? newline + 1 : last;
+        }
         break;
-      }
-      token.push_back(QUOTECHAR); // push last ending quote
-      store_ifnot_empty(token, tokens);
     }
-    else if(isspace(c)){ // c == ' '
-      store_ifnot_empty(token, tokens);
+  }
+  store(last);
+
+  return tokens;
+}
+
+TokenSequenceType tokenize(std::istream & seq){
+
+  std::string text((std::istreambuf_iterator<char>(seq)), std::istreambuf_iterator<char>());
+
+  TokenSequenceType tokens;
+  for(const TokenView & t : tokenize(text.data(), text.data() + text.size())){
+    if(t.type() == Token::OPEN || t.type() == Token::CLOSE){
+      tokens.emplace_back(t.type());
     }
-    else{ // c == any other character
-      token.push_back(c);
+    else{
+      tokens.emplace_back(t.asString());
     }
   }
-  store_ifnot_empty(token, tokens);
 
   return tokens;
-}
\ No newline at end of file
+}
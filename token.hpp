@@ -4,9 +4,13 @@ Defines the Token and TokenSequence types, and associated functions.
 #ifndef TOKEN_HPP
 #define TOKEN_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <istream>
 #include <future>
+#include <string>
+#include <vector>
 
 /*! \class Token
   \brief Value class representing a token.
@@ -22,6 +26,8 @@ public:
   enum TokenType { OPEN,  //< open tag, aka '('
 		   CLOSE, //< close tag, aka ')'
 		   STRING, //< string tag
+		   NUMBER, //< number literal, only from the buffer tokenizer
+		   SYMBOL, //< any other atom, only from the buffer tokenizer
   };
 
   /// construct a token of type t (if string default to empty value)
@@ -47,6 +53,97 @@ sequential access should do.
  */
 typedef std::deque<Token> TokenSequenceType;
 
+/*! \class TokenView
+  \brief A token as a window onto the source text it was read from.
+
+  A TokenView does not own its text: it is valid only as long as the
+  buffer it was tokenized from. The tokenizer classifies each token as
+  it scans, parsing number literals once so the parser need not. A
+  parenthesis is only ever a token of its own and a string starts with
+  its quote, so only the value of a NUMBER is stored, with a NaN, which
+  no literal parses to, for every other type. Sources are limited to
+  MAX_SOURCE characters.
+*/
+class TokenView {
+public:
+
+  /// the largest source whose sizes and offsets a view can hold
+  static const std::size_t MAX_SOURCE = UINT32_MAX;
+
+  /// construct a view of the size characters at data, which start offset
+  /// characters into the source, and are the literal of number unless it
+  /// is NaN
+  TokenView(const char * data, std::size_t size, std::size_t offset, double number) noexcept:
+    m_data(data), m_size(static_cast<std::uint32_t>(size)),
+    m_offset(static_cast<std::uint32_t>(offset)), m_number(number) {}
+
+  /// return the type of the token: OPEN, CLOSE, NUMBER, STRING or SYMBOL
+  Token::TokenType type() const noexcept {
+    if(m_size == 1 && (*m_data == '(' || *m_data == ')')){
+      return *m_data == '(' ? Token::OPEN : Token::CLOSE;
+    }
+    if(*m_data == '"'){
+      return Token::STRING;
+    }
+    return (m_number == m_number) ? Token::NUMBER : Token::SYMBOL;
+  }
+
+  /// return the value of a NUMBER token
+  double number() const noexcept { return m_number; }
+
+  /// return the first character of the token's text
+  const char * data() const noexcept { return m_data; }
+
+  /// return the number of characters in the token's text
+  std::size_t size() const noexcept { return m_size; }
+
+  /// return the position of the token in the source, in characters
+  std::size_t offset() const noexcept { return m_offset; }
+
+  /// return the token rendered as a string, as Token::asString does
+  std::string asString() const { return std::string(m_data, m_size); }
+
+private:
+  const char * m_data;
+  std::uint32_t m_size;
+  std::uint32_t m_offset;
+  double m_number;
+};
+
+/*! \typedef TokenViewSequenceType
+The tokens of a contiguous buffer, in order.
+ */
+typedef std::vector<TokenView> TokenViewSequenceType;
+
+/*! \fn TokenViewSequenceType tokenize(const char * first, const char * last)
+\brief Split the characters in [first, last) into a sequence of tokens
+
+\param first the start of the source text
+\param last one past its end
+\return The sequence of tokens, as views into the source
+
+Tokens are split exactly as by tokenize(std::istream &), except that a
+comment also ends the token before it. No token's text is copied.
+
+Throws std::length_error if the source is longer than TokenView::MAX_SOURCE.
+*/
+TokenViewSequenceType tokenize(const char * first, const char * last);
+
+/*! \fn parseNumber
+\brief parse the text in [first, last) as a number literal
+
+\param first the start of the text
+\param last one past its end
+\param value set to the number, exactly rounded, on success
+\return true if the whole text is a number literal
+
+A literal is an optional sign, digits with an optional decimal point
+(and at least one digit), and an optional exponent, as std::istream reads
+a double in the classic locale. A literal too large for a double is not a
+number; one too small is zero. The result does not depend on the locale.
+ */
+bool parseNumber(const char * first, const char * last, double & value) noexcept;
+
 /*! \fn TokenSequenceType tokenize(std::istream & seq)
 \brief Split a stream into a sequnce of tokens
 
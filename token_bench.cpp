@@ -0,0 +1,242 @@
+#include "bench.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "atom.hpp"
+#include "interpreter.hpp"
+#include "parse.hpp"
+#include "source_buffer.hpp"
+#include "syntax_tree.hpp"
+#include "token.hpp"
+
+// the istream tokenizer tokenize(std::istream &) used before it read the
+// whole stream into a buffer: one get() and eof() test per character, and
+// a std::string built and copied for every token
+static TokenSequenceType tokenize_by_character(std::istream & seq){
+
+  TokenSequenceType tokens;
+  std::string token;
+
+  auto store = [&](){
+    if(!token.empty()){
+      tokens.emplace_back(token);
+      token.clear();
+    }
+  };
+
+  while(true){
+    char c = seq.get();
+    if(seq.eof()) break;
+
+    if(c == ';'){
+      while((!seq.eof()) && (c != '\n')){
+        c = seq.get();
+      }
+      if(seq.eof()) break;
+    }
+    else if(c == '('){
+      store();
+      tokens.push_back(Token::TokenType::OPEN);
+    }
+    else if(c == ')'){
+      store();
+      tokens.push_back(Token::TokenType::CLOSE);
+    }
+    else if(c == '"'){
+      token.push_back('"');
+      c = seq.get();
+      while(!seq.eof() && c != '"'){
+        token.push_back(c);
+        c = seq.get();
+      }
+      if(seq.eof()) break;
+      token.push_back('"');
+      store();
+    }
+    else if(isspace(c)){
+      store();
+    }
+    else{
+      token.push_back(c);
+    }
+  }
+  store();
+
+  return tokens;
+}
+
+// a data script of points, as a plot of measurements would be written
+static std::string data_script(std::size_t points){
+
+  std::ostringstream os;
+  os << "(begin\n  ; measured samples\n  (define data (list\n";
+  for(std::size_t i = 0; i < points; ++i){
+    os << "    (list " << i * 0.25 << " " << (i % 97) * 1.5 - 12.125 << ")\n";
+  }
+  os << "  ))\n  (discrete-plot data (list (list \"title\" \"Samples\"))))\n";
+  return os.str();
+}
+
+static void tokenize_data_script(){
+
+  const std::size_t N = 5;
+
+  std::string text = data_script(200000);
+  std::string note = std::to_string(text.size() / 1000) + " kB";
+
+  double ns = bench::time_ns(N, [&](){
+    std::istringstream iss(text);
+    TokenSequenceType tokens = tokenize_by_character(iss);
+    bench::keep(&tokens);
+  });
+  bench::report("istream, by character", ns, note);
+
+  ns = bench::time_ns(N, [&](){
+    std::istringstream iss(text);
+    TokenSequenceType tokens = tokenize(iss);
+    bench::keep(&tokens);
+  });
+  bench::report("istream, buffered", ns, note);
+
+  SourceBuffer source(text);
+  ns = bench::time_ns(N, [&](){
+    TokenViewSequenceType tokens = tokenize(source.begin(), source.end());
+    bench::keep(&tokens);
+  });
+  bench::report("buffer, views", ns, note);
+}
+BENCHMARK(tokenize_data_script, "tokenize a data script");
+
+// the Atom(Token) constructor before tokens were classified: a
+// std::istringstream per token to test whether it is a number
+static Atom atom_by_istringstream(const std::string & text){
+
+  std::istringstream iss(text);
+  double temp;
+  if(iss >> temp){
+    if(iss.rdbuf()->in_avail() == 0){
+      return Atom(temp);
+    }
+  }
+  else if(!std::isdigit(text[0])){
+    return Atom(text);
+  }
+  return Atom();
+}
+
+static void parse_data_script(){
+
+  const std::size_t N = 5;
+
+  std::string text = data_script(200000);
+  std::string note = std::to_string(text.size() / 1000) + " kB";
+  TokenViewSequenceType tokens = tokenize(text.data(), text.data() + text.size());
+
+  double ns = bench::time_ns(N, [&](){
+    for(const TokenView & t : tokens){
+      Atom a = atom_by_istringstream(t.asString());
+      bench::keep(&a);
+    }
+  });
+  bench::report("atoms by istringstream", ns, note);
+
+  ns = bench::time_ns(N, [&](){
+    for(const TokenView & t : tokens){
+      Atom a(t);
+      bench::keep(&a);
+    }
+  });
+  bench::report("atoms from classified tokens", ns, note);
+
+  Interpreter interp;
+  ns = bench::time_ns(N, [&](){
+    bool ok = interp.parseBuffer(text.data(), text.data() + text.size());
+    bench::keep(&ok);
+  });
+  bench::report("tokenize and parse", ns, note);
+
+  SyntaxTree tree = parseTree(tokens);
+  std::string nodes = note + ", " + std::to_string(tree.size()) + " nodes of " +
+    std::to_string(tree.memoryUsage() / tree.size()) + " bytes";
+  ns = bench::time_ns(N, [&](){
+    SyntaxTree t = parseTree(tokens);
+    bench::keep(&t);
+  });
+  bench::report("parse to a syntax tree", ns, nodes);
+
+  ns = bench::time_ns(N, [&](){
+    Expression exp = tree.toExpression();
+    bench::keep(&exp);
+  });
+  bench::report("syntax tree to Expression", ns, nodes);
+}
+BENCHMARK(parse_data_script, "parse a data script");
+
+// a data script of measurements at full precision, as an exported dataset
+// would be written, of at least size bytes
+static std::string precise_data_script(std::size_t size){
+
+  std::ostringstream os;
+  os.precision(8);
+  os << "(begin\n  ; exported samples\n  (define data (list\n";
+  for(std::size_t i = 0; os.tellp() < static_cast<std::streamoff>(size); ++i){
+    os << "    (list " << i * 0.1 << " " << std::sin(i * 0.001) * 100 << ")\n";
+  }
+  os << "  ))\n  (discrete-plot data (list (list \"title\" \"Samples\"))))\n";
+  return os.str();
+}
+
+// a script of labelled, commented text items, mostly long strings and
+// comments, of at least size bytes
+static std::string text_script(std::size_t size){
+
+  std::ostringstream os;
+  os << "(begin\n";
+  for(std::size_t i = 0; os.tellp() < static_cast<std::streamoff>(size); ++i){
+    os << "  ; item " << i << ", as recorded by the field station during the morning survey\n"
+       << "  (make-text \"observation " << i << ": clear skies, light wind from the north-east\")\n";
+  }
+  os << ")\n";
+  return os.str();
+}
+
+static void tokenize_large_script(){
+
+  const std::size_t N = 3;
+  const std::size_t size = 100 * 1000 * 1000;
+
+  for(std::string kind : {"data", "text"}){
+    std::string text = (kind == "data") ? precise_data_script(size) : text_script(size);
+    double ns = bench::time_ns(N, [&](){
+      TokenViewSequenceType tokens = tokenize(text.data(), text.data() + text.size());
+      bench::keep(&tokens);
+    });
+
+    std::ostringstream note;
+    note.precision(0);
+    note << std::fixed << text.size() / 1e6 << " MB, " << text.size() / ns * 1e3 << " MB/s";
+    bench::report(kind + " script, buffer views", ns, note.str());
+  }
+}
+BENCHMARK(tokenize_large_script, "tokenize a 100 MB script");
+
+static void parse_large_script(){
+
+  const std::size_t N = 3;
+
+  std::string text = precise_data_script(100 * 1000 * 1000);
+  std::string note = std::to_string(text.size() / 1000000) + " MB";
+
+  for(unsigned threads : {1u, 2u, 4u, std::thread::hardware_concurrency()}){
+    double ns = bench::time_ns(N, [&](){
+      Expression ast = parse(text.data(), text.data() + text.size(), threads);
+      bench::keep(&ast);
+    });
+    bench::report("tokenize and parse, " + std::to_string(threads) + " threads", ns, note);
+  }
+}
+BENCHMARK(parse_large_script, "parse a 100 MB script");
@@ -1,5 +1,11 @@
 #include "catch.hpp"
 
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "token.hpp"
 
 TEST_CASE( "Test Token creation", "[token]" ) {
@@ -78,3 +84,190 @@ TEST_CASE( "Test tokenize", "[token]" ) {
   REQUIRE(tokens.empty());
 }
 
+
+TEST_CASE( "Test tokenize a buffer", "[token]" ) {
+  std::string input = "(define s \"a ; string\") ;c\n(+ s 1.5)";
+
+  TokenViewSequenceType tokens = tokenize(input.data(), input.data() + input.size());
+
+  std::vector<std::string> expected = {"(", "define", "s", "\"a ; string\"", ")",
+                                       "(", "+", "s", "1.5", ")"};
+  REQUIRE(tokens.size() == expected.size());
+  for(std::size_t i = 0; i < tokens.size(); ++i){
+    REQUIRE(tokens[i].asString() == expected[i]);
+    REQUIRE(tokens[i].data() == input.data() + tokens[i].offset());
+  }
+  REQUIRE(tokens[0].type() == Token::OPEN);
+  REQUIRE(tokens[4].type() == Token::CLOSE);
+  REQUIRE(tokens[1].type() == Token::SYMBOL);
+  REQUIRE(tokens[3].type() == Token::STRING);
+  REQUIRE(tokens[6].type() == Token::SYMBOL);
+  REQUIRE(tokens[8].type() == Token::NUMBER);
+  REQUIRE(tokens[8].number() == 1.5);
+  REQUIRE(tokens[3].offset() == 10);
+  REQUIRE(tokens[5].offset() == 27);
+
+  INFO("the stream tokenizer reads the same tokens, without classifying atoms");
+  std::istringstream iss(input);
+  TokenSequenceType streamed = tokenize(iss);
+  REQUIRE(streamed.size() == tokens.size());
+  for(std::size_t i = 0; i < tokens.size(); ++i){
+    bool atom = tokens[i].type() != Token::OPEN && tokens[i].type() != Token::CLOSE;
+    REQUIRE(streamed[i].type() == (atom ? Token::STRING : tokens[i].type()));
+    REQUIRE(streamed[i].asString() == tokens[i].asString());
+  }
+}
+
+TEST_CASE( "Test tokenize a buffer at its edges", "[token]" ) {
+
+  std::string empty;
+  REQUIRE(tokenize(empty.data(), empty.data()).empty());
+
+  INFO("a comment ends the token before it");
+  std::string comment = "abc;x\ndef";
+  TokenViewSequenceType tokens = tokenize(comment.data(), comment.data() + comment.size());
+  REQUIRE(tokens.size() == 2);
+  REQUIRE(tokens[0].asString() == "abc");
+  REQUIRE(tokens[1].asString() == "def");
+
+  INFO("a string joins the token before it");
+  std::string joined = "ab\"c d\"e";
+  tokens = tokenize(joined.data(), joined.data() + joined.size());
+  REQUIRE(tokens.size() == 2);
+  REQUIRE(tokens[0].asString() == "ab\"c d\"");
+  REQUIRE(tokens[1].asString() == "e");
+
+  INFO("an unterminated string runs to the end");
+  std::string open = "(x \"abc def";
+  tokens = tokenize(open.data(), open.data() + open.size());
+  REQUIRE(tokens.size() == 3);
+  REQUIRE(tokens[2].asString() == "\"abc def");
+}
+
+// the token strings of text, read one character at a time
+static std::vector<std::string> tokenStrings(const std::string & text){
+
+  std::vector<std::string> tokens;
+  std::string token;
+  auto store = [&](){
+    if(!token.empty()) tokens.push_back(token);
+    token.clear();
+  };
+
+  for(std::size_t i = 0; i < text.size(); ++i){
+    char c = text[i];
+    if(c == ';'){
+      store();
+      while(i < text.size() && text[i] != '\n') ++i;
+    }
+    else if(c == '(' || c == ')'){
+      store();
+      tokens.push_back(std::string(1, c));
+    }
+    else if(c == '"'){
+      std::size_t close = text.find('"', i + 1);
+      close = (close == std::string::npos) ? text.size() - 1 : close;
+      token += text.substr(i, close - i + 1);
+      i = close;
+      store();
+    }
+    else if(c == ' ' || (c >= '\t' && c <= '\r')){
+      store();
+    }
+    else{
+      token.push_back(c);
+    }
+  }
+  store();
+
+  return tokens;
+}
+
+// the token strings of text, read from the buffer tokenizer
+static std::vector<std::string> bufferTokenStrings(const std::string & text){
+
+  std::vector<std::string> tokens;
+  for(const TokenView & t : tokenize(text.data(), text.data() + text.size())){
+    tokens.push_back(t.asString());
+  }
+  return tokens;
+}
+
+TEST_CASE( "Test tokenize a buffer across scan blocks", "[token]" ) {
+
+  INFO("every character, at every offset around the scanner's blocks");
+  for(int c = 0; c < 256; ++c){
+    int mismatches = 0;
+    for(std::size_t offset = 0; offset < 140; ++offset){
+      std::string text(140, 'x');
+      text[offset] = static_cast<char>(c);
+      mismatches += bufferTokenStrings(text) != tokenStrings(text);
+    }
+    INFO(c);
+    REQUIRE(mismatches == 0);
+  }
+
+  INFO("random programs of delimiters and plain characters");
+  std::mt19937 random(2019);
+  const std::string alphabet = "ab1.-  ()\";\n\t\r\x80\xff";
+  std::uniform_int_distribution<std::size_t> pick(0, alphabet.size() - 1), length(0, 300);
+  for(int i = 0; i < 500; ++i){
+    std::string text;
+    for(std::size_t n = length(random); n > 0; --n){
+      text.push_back(alphabet[pick(random)]);
+    }
+    INFO(text);
+    REQUIRE(bufferTokenStrings(text) == tokenStrings(text));
+  }
+}
+
+TEST_CASE( "Test number literals parse as the istream parser read them", "[token]" ) {
+
+  std::vector<std::string> literals = {
+    "1", "-1", "+1", "1.", "-.5", ".5", ".", "-", "+", "1e", "1e+", "1e5", "1E5",
+    "1e-5", "1.5e3x", "0x10", "inf", "nan", "1e999", "1e-999", "4.9e-324", "1e-320",
+    "00012", "1..2", "1e5.5", "-0", "e5", "1,5", "2.2250738585072011e-308",
+    "9007199254740993", "0.1e1", "1.e2", "+.e2", "-e", "0.1", "0.3", "123.456",
+    "1.7976931348623157e308", "3.141592653589793238462643383279", "0.000001234",
+    "12345678901234567890123", "1234567890123456789e-30", "-12.125", "6.02214076e23"
+  };
+
+  for(const std::string & text : literals){
+    INFO(text);
+    std::istringstream iss(text);
+    double expected = 0;
+    bool isNumber = (iss >> expected) && iss.rdbuf()->in_avail() == 0;
+
+    double value = 0;
+    REQUIRE(parseNumber(text.data(), text.data() + text.size(), value) == isNumber);
+    if(isNumber){
+      REQUIRE(value == expected);
+      REQUIRE(std::signbit(value) == std::signbit(expected));
+    }
+  }
+}
+
+TEST_CASE( "Test number literals are exactly rounded", "[token]" ) {
+
+  std::mt19937 random(2018);
+  std::uniform_int_distribution<int> digit(0, 9), length(1, 20), exponent(-40, 40);
+
+  for(int i = 0; i < 1000; ++i){
+    std::string text;
+    int n = length(random);
+    for(int j = 0; j < n; ++j){
+      text.push_back('0' + digit(random));
+    }
+    text.insert(text.begin() + n / 2, '.');
+    text += "e" + std::to_string(exponent(random));
+
+    INFO(text);
+    std::istringstream iss(text);
+    double expected = 0;
+    REQUIRE(iss >> expected);
+
+    double value = 0;
+    REQUIRE(parseNumber(text.data(), text.data() + text.size(), value));
+    REQUIRE(value == expected);
+  }
+}
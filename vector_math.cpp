@@ -0,0 +1,301 @@
+#include "vector_math.hpp"
+
+// the SIMD kernels need GCC-style target attributes and x86 intrinsics;
+// anywhere else only the scalar kernel is built
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VECTOR_MATH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace vector_math {
+
+namespace {
+
+// An operand as a base pointer and a step. A broadcast value is read from
+// a small block of copies with a step of zero, so the loops below never
+// branch on the shape of an operand. Not copyable: p may point into fill.
+struct Stream {
+  double fill[4];
+  const double * p;
+  std::size_t step;
+
+  explicit Stream(const Operand & x) noexcept {
+    for(auto & f : fill){
+      f = x.value;
+    }
+    p = x.data ? x.data : fill;
+    step = x.data ? 1 : 0;
+  }
+
+  Stream(const Stream &) = delete;
+  Stream & operator=(const Stream &) = delete;
+
+  const double * at(std::size_t i) const noexcept { return p + i * step; }
+};
+
+template<typename F>
+void scalar_loop(F f, const Stream & a, const Stream & b, double * out,
+                 std::size_t i, std::size_t n) noexcept {
+  for(; i < n; ++i){
+    out[i] = f(*a.at(i), *b.at(i));
+  }
+}
+
+struct AddOp { double operator()(double x, double y) const noexcept { return x + y; } };
+struct SubOp { double operator()(double x, double y) const noexcept { return x - y; } };
+struct MulOp { double operator()(double x, double y) const noexcept { return x * y; } };
+struct DivOp { double operator()(double x, double y) const noexcept { return x / y; } };
+
+// the elements [i, n), one at a time; also finishes the SIMD kernels' tails
+void apply_scalar(Op op, const Stream & a, const Stream & b, double * out,
+                  std::size_t i, std::size_t n) noexcept {
+  switch(op){
+    case Op::Add: return scalar_loop(AddOp(), a, b, out, i, n);
+    case Op::Sub: return scalar_loop(SubOp(), a, b, out, i, n);
+    case Op::Mul: return scalar_loop(MulOp(), a, b, out, i, n);
+    case Op::Div: return scalar_loop(DivOp(), a, b, out, i, n);
+  }
+}
+
+#ifdef VECTOR_MATH_X86
+
+// one full-width block at a time, leaving i at the first element not done
+#define VECTOR_MATH_LOOP(WIDTH, LOAD, STORE, OPERATION)                 \
+  for(; i + WIDTH <= n; i += WIDTH){                                    \
+    STORE(out + i, OPERATION(LOAD(a.at(i)), LOAD(b.at(i))));            \
+  }
+
+__attribute__((target("sse2")))
+void apply_sse2(Op op, const Stream & a, const Stream & b, double * out, std::size_t n) noexcept {
+  std::size_t i = 0;
+  switch(op){
+    case Op::Add: VECTOR_MATH_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd); break;
+    case Op::Sub: VECTOR_MATH_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd); break;
+    case Op::Mul: VECTOR_MATH_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd); break;
+    case Op::Div: VECTOR_MATH_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd); break;
+  }
+  apply_scalar(op, a, b, out, i, n);
+}
+
+__attribute__((target("avx2")))
+void apply_avx2(Op op, const Stream & a, const Stream & b, double * out, std::size_t n) noexcept {
+  std::size_t i = 0;
+  switch(op){
+    case Op::Add: VECTOR_MATH_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd); break;
+    case Op::Sub: VECTOR_MATH_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd); break;
+    case Op::Mul: VECTOR_MATH_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd); break;
+    case Op::Div: VECTOR_MATH_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd); break;
+  }
+  // the compiler omits this before a tail call, and without it every SSE
+  // instruction that follows (libm included) pays a transition penalty
+  _mm256_zeroupper();
+  apply_scalar(op, a, b, out, i, n);
+}
+
+#undef VECTOR_MATH_LOOP
+
+#endif
+
+// the reductions work on blocks of this many items, small enough to stay
+// in cache and for their own rounding error to be negligible
+const std::size_t BLOCK = 128;
+
+// the lanes of a block sum, combined in a fixed order, then the items
+// [i, n) that did not fill a lane group
+double finish_lanes(const double lanes[4], const double * data, std::size_t i, std::size_t n) noexcept {
+  double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for(; i < n; ++i){
+    total += data[i];
+  }
+  return total;
+}
+
+double block_sum_scalar(const double * data, std::size_t n) noexcept {
+  double lanes[4] = {0, 0, 0, 0};
+  std::size_t i = 0;
+  for(; i + 4 <= n; i += 4){
+    lanes[0] += data[i];
+    lanes[1] += data[i + 1];
+    lanes[2] += data[i + 2];
+    lanes[3] += data[i + 3];
+  }
+  return finish_lanes(lanes, data, i, n);
+}
+
+#ifdef VECTOR_MATH_X86
+
+__attribute__((target("sse2")))
+double block_sum_sse2(const double * data, std::size_t n) noexcept {
+  __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+  std::size_t i = 0;
+  for(; i + 4 <= n; i += 4){
+    low = _mm_add_pd(low, _mm_loadu_pd(data + i));
+    high = _mm_add_pd(high, _mm_loadu_pd(data + i + 2));
+  }
+  double lanes[4];
+  _mm_storeu_pd(lanes, low);
+  _mm_storeu_pd(lanes + 2, high);
+  return finish_lanes(lanes, data, i, n);
+}
+
+__attribute__((target("avx2")))
+double block_sum_avx2(const double * data, std::size_t n) noexcept {
+  __m256d acc = _mm256_setzero_pd();
+  std::size_t i = 0;
+  for(; i + 4 <= n; i += 4){
+    acc = _mm256_add_pd(acc, _mm256_loadu_pd(data + i));
+  }
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  _mm256_zeroupper();
+  return finish_lanes(lanes, data, i, n);
+}
+
+#endif
+
+double block_sum(Isa isa, const double * data, std::size_t n) noexcept {
+  switch(isa){
+#ifdef VECTOR_MATH_X86
+    case Isa::AVX2:
+      return block_sum_avx2(data, n);
+    case Isa::SSE2:
+      return block_sum_sse2(data, n);
+#endif
+    default:
+      return block_sum_scalar(data, n);
+  }
+}
+
+// the number of items in the first half of a pairwise split: whole blocks,
+// so every instruction set splits the same way
+std::size_t split(std::size_t n) noexcept {
+  return ((n / BLOCK + 1) / 2) * BLOCK;
+}
+
+double pairwise_sum(Isa isa, const double * data, std::size_t n) noexcept {
+  if(n <= BLOCK){
+    return block_sum(isa, data, n);
+  }
+  std::size_t half = split(n);
+  return pairwise_sum(isa, data, half) + pairwise_sum(isa, data + half, n - half);
+}
+
+Moments block_moments(const double * data, std::size_t n) noexcept {
+  double mean = block_sum(best(), data, n) / n;
+  double lanes[4] = {0, 0, 0, 0};
+  std::size_t i = 0;
+  for(; i + 4 <= n; i += 4){
+    for(std::size_t j = 0; j < 4; ++j){
+      double d = data[i + j] - mean;
+      lanes[j] += d * d;
+    }
+  }
+  double m2 = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+  for(; i < n; ++i){
+    m2 += (data[i] - mean) * (data[i] - mean);
+  }
+  return Moments{n, mean, m2};
+}
+
+Moments merge(const Moments & a, const Moments & b) noexcept {
+  std::size_t n = a.count + b.count;
+  double delta = b.mean - a.mean;
+  double mean = a.mean + delta * b.count / n;
+  double m2 = a.m2 + b.m2 + delta * delta * (static_cast<double>(a.count) * b.count / n);
+  return Moments{n, mean, m2};
+}
+
+Moments pairwise_moments(const double * data, std::size_t n) noexcept {
+  if(n <= BLOCK){
+    return block_moments(data, n);
+  }
+  std::size_t half = split(n);
+  return merge(pairwise_moments(data, half), pairwise_moments(data + half, n - half));
+}
+
+Isa detect() noexcept {
+  if(supported(Isa::AVX2)){
+    return Isa::AVX2;
+  }
+  if(supported(Isa::SSE2)){
+    return Isa::SSE2;
+  }
+  return Isa::Scalar;
+}
+
+}
+
+bool supported(Isa isa) noexcept {
+
+  switch(isa){
+#ifdef VECTOR_MATH_X86
+    case Isa::AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+    case Isa::SSE2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse2");
+#endif
+    case Isa::Scalar:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Isa best() noexcept {
+  static const Isa isa = detect();
+  return isa;
+}
+
+void apply(Isa isa, Op op, Operand a, Operand b, double * out, std::size_t n) noexcept {
+
+  Stream left(a), right(b);
+  switch(isa){
+#ifdef VECTOR_MATH_X86
+    case Isa::AVX2:
+      return apply_avx2(op, left, right, out, n);
+    case Isa::SSE2:
+      return apply_sse2(op, left, right, out, n);
+#endif
+    default:
+      return apply_scalar(op, left, right, out, 0, n);
+  }
+}
+
+void apply(Op op, Operand a, Operand b, double * out, std::size_t n) noexcept {
+  apply(best(), op, a, b, out, n);
+}
+
+double sum(Isa isa, const double * data, std::size_t n) noexcept {
+  return n == 0 ? 0.0 : pairwise_sum(isa, data, n);
+}
+
+double sum(const double * data, std::size_t n) noexcept {
+  return sum(best(), data, n);
+}
+
+Moments moments(const double * data, std::size_t n) noexcept {
+  if(n == 0){
+    return Moments{0, 0.0, 0.0};
+  }
+  return pairwise_moments(data, n);
+}
+
+std::size_t argmin(const double * data, std::size_t n) noexcept {
+  std::size_t best = 0;
+  for(std::size_t i = 1; i < n; ++i){
+    if(data[i] < data[best]) best = i;
+  }
+  return best;
+}
+
+std::size_t argmax(const double * data, std::size_t n) noexcept {
+  std::size_t best = 0;
+  for(std::size_t i = 1; i < n; ++i){
+    if(data[i] > data[best]) best = i;
+  }
+  return best;
+}
+
+}
@@ -0,0 +1,94 @@
+/*! \file vector_math.hpp
+Defines the elementwise arithmetic kernels behind the numeric list builtins.
+ */
+#ifndef VECTOR_MATH_HPP
+#define VECTOR_MATH_HPP
+
+#include <cstddef>
+
+namespace vector_math {
+
+/// an elementwise arithmetic operation
+enum class Op {Add, Sub, Mul, Div};
+
+/// an instruction set a kernel can be built for
+enum class Isa {Scalar, SSE2, AVX2};
+
+/*! \struct Operand
+\brief One side of an elementwise operation: an array, or a number
+broadcast to every element.
+ */
+struct Operand {
+  const double * data; //< the items, or nullptr to broadcast value
+  double value;
+};
+
+/// an operand reading the items at data
+inline Operand array(const double * data) noexcept { return Operand{data, 0.0}; }
+
+/// an operand repeating value
+inline Operand broadcast(double value) noexcept { return Operand{nullptr, value}; }
+
+/// true if this build and this processor can run kernels for isa
+bool supported(Isa isa) noexcept;
+
+/// the fastest supported instruction set, detected once at first use
+Isa best() noexcept;
+
+/*! \fn apply
+\brief compute out[i] = a[i] op b[i] for i in [0, n)
+
+\param isa the instruction set to use, which must be supported
+\param op the operation
+\param a the left operand
+\param b the right operand
+\param out the n results, which may alias an array operand
+
+Every instruction set gives bit-identical results: each element is one
+IEEE operation.
+ */
+void apply(Isa isa, Op op, Operand a, Operand b, double * out, std::size_t n) noexcept;
+
+/// apply using the fastest supported instruction set
+void apply(Op op, Operand a, Operand b, double * out, std::size_t n) noexcept;
+
+/*! \fn sum
+\brief the sum of the n items at data
+
+Blocks of items are summed in four interleaved lanes, and the block sums
+are added pairwise, so the rounding error grows with log n rather than n.
+Every instruction set adds in the same order and gives the same result.
+ */
+double sum(Isa isa, const double * data, std::size_t n) noexcept;
+
+/// sum using the fastest supported instruction set
+double sum(const double * data, std::size_t n) noexcept;
+
+/*! \struct Moments
+\brief The mean of some items and the sum of their squared deviations
+from it, from which the variance follows.
+ */
+struct Moments {
+  std::size_t count;
+  double mean;
+  double m2;
+};
+
+/*! \fn moments
+\brief the moments of the n items at data, in one pass over memory
+
+Each block is summed twice while it is in cache, once for its mean and
+once for its deviations, and the blocks are merged pairwise (Chan et al.),
+which avoids the cancellation of the sum-of-squares formula.
+ */
+Moments moments(const double * data, std::size_t n) noexcept;
+
+/// the index of the first smallest of the n items at data, n > 0
+std::size_t argmin(const double * data, std::size_t n) noexcept;
+
+/// the index of the first largest of the n items at data, n > 0
+std::size_t argmax(const double * data, std::size_t n) noexcept;
+
+}
+
+#endif
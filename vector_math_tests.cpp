@@ -0,0 +1,123 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "vector_math.hpp"
+
+using namespace vector_math;
+
+TEST_CASE( "Test the best instruction set is supported", "[vector_math]" ) {
+
+  REQUIRE(supported(Isa::Scalar));
+  REQUIRE(supported(best()));
+}
+
+TEST_CASE( "Test every instruction set gives the same results", "[vector_math]" ) {
+
+  // odd lengths leave a tail for the scalar loop after the SIMD blocks
+  for(std::size_t n : {0, 1, 3, 4, 7, 33}){
+    std::vector<double> a(n), b(n);
+    for(std::size_t i = 0; i < n; ++i){
+      a[i] = 0.5 * i - 3;
+      b[i] = 1.25 * i + 1;
+    }
+
+    for(Op op : {Op::Add, Op::Sub, Op::Mul, Op::Div}){
+      std::vector<double> expected(n), arrays(n), left(n), right(n);
+      apply(Isa::Scalar, op, array(a.data()), array(b.data()), expected.data(), n);
+
+      for(Isa isa : {Isa::Scalar, Isa::SSE2, Isa::AVX2}){
+        if(!supported(isa)) continue;
+
+        apply(isa, op, array(a.data()), array(b.data()), arrays.data(), n);
+        REQUIRE(arrays == expected);
+
+        apply(isa, op, broadcast(2.0), array(b.data()), left.data(), n);
+        apply(isa, op, array(a.data()), broadcast(2.0), right.data(), n);
+        for(std::size_t i = 0; i < n; ++i){
+          double x = 2.0, y = 2.0;
+          apply(Isa::Scalar, op, broadcast(x), broadcast(b[i]), &x, 1);
+          apply(Isa::Scalar, op, broadcast(a[i]), broadcast(y), &y, 1);
+          REQUIRE(left[i] == x);
+          REQUIRE(right[i] == y);
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE( "Test kernels compute the operation", "[vector_math]" ) {
+
+  std::vector<double> a = {1, 2, 3, 4, 5};
+  std::vector<double> b = {5, 4, 3, 2, 1};
+  std::vector<double> out(5);
+
+  apply(Op::Add, array(a.data()), array(b.data()), out.data(), 5);
+  REQUIRE(out == std::vector<double>({6, 6, 6, 6, 6}));
+
+  apply(Op::Sub, broadcast(0), array(a.data()), out.data(), 5);
+  REQUIRE(out == std::vector<double>({-1, -2, -3, -4, -5}));
+
+  apply(Op::Mul, array(a.data()), broadcast(2), out.data(), 5);
+  REQUIRE(out == std::vector<double>({2, 4, 6, 8, 10}));
+
+  // the output may be one of the inputs
+  apply(Op::Div, array(out.data()), array(a.data()), out.data(), 5);
+  REQUIRE(out == std::vector<double>({2, 2, 2, 2, 2}));
+}
+
+TEST_CASE( "Test sums are accurate and the same on every instruction set", "[vector_math]" ) {
+
+  REQUIRE(sum(nullptr, 0) == 0.0);
+
+  // a large value followed by many small ones loses them when added in order
+  std::vector<double> items(100001, 0.1);
+  items[0] = 1e8;
+  double naive = 0;
+  for(double x : items){
+    naive += x;
+  }
+  double exact = 1e8 + 10000.0;
+  double total = sum(items.data(), items.size());
+  REQUIRE(std::abs(total - exact) < std::abs(naive - exact));
+  REQUIRE(std::abs(total - exact) < 1e-6);
+
+  for(std::size_t n : {1, 5, 128, 129, 1000, 100001}){
+    double expected = sum(Isa::Scalar, items.data(), n);
+    for(Isa isa : {Isa::SSE2, Isa::AVX2}){
+      if(supported(isa)){
+        REQUIRE(sum(isa, items.data(), n) == expected);
+      }
+    }
+  }
+}
+
+TEST_CASE( "Test moments are stable", "[vector_math]" ) {
+
+  Moments none = moments(nullptr, 0);
+  REQUIRE(none.count == 0);
+
+  std::vector<double> small = {2, 4, 4, 4, 5, 5, 7, 9};
+  Moments m = moments(small.data(), small.size());
+  REQUIRE(m.count == 8);
+  REQUIRE(m.mean == 5.0);
+  REQUIRE(m.m2 / m.count == 4.0);
+
+  // a large offset cancels catastrophically in the sum-of-squares formula
+  std::vector<double> offset(1000);
+  for(std::size_t i = 0; i < offset.size(); ++i){
+    offset[i] = 1e9 + (i % 2 ? 1.0 : -1.0);
+  }
+  Moments shifted = moments(offset.data(), offset.size());
+  REQUIRE(shifted.mean == 1e9);
+  REQUIRE(std::abs(shifted.m2 / shifted.count - 1.0) < 1e-9);
+}
+
+TEST_CASE( "Test argmin and argmax find the first extreme", "[vector_math]" ) {
+
+  std::vector<double> items = {3, -1, 4, -1, 5, 9, 2, 9};
+  REQUIRE(argmin(items.data(), items.size()) == 1);
+  REQUIRE(argmax(items.data(), items.size()) == 5);
+  REQUIRE(argmin(items.data(), 1) == 0);
+}
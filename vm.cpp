@@ -0,0 +1,306 @@
+#include "vm.hpp"
+
+#include <iterator>
+
+#include "semantic_error.hpp"
+
+Expression VM::run(const Chunk & chunk, Environment & env){
+
+  // the compiled bodies hold their lambdas, so they go with the run
+  try {
+    Expression result = execute(chunk, env);
+    m_bodies.clear();
+    return result;
+  }
+  catch(...){
+    m_bodies.clear();
+    throw;
+  }
+}
+
+const std::shared_ptr<const Chunk> & VM::bodyOf(const Expression & lambda){
+
+  if(lambda.code()){
+    return lambda.code();
+  }
+
+  // the lambda's node may be shared with other threads, so its body is
+  // kept here rather than on it; the parameter list identifies the node
+  Body & body = m_bodies[&*lambda.tailConstBegin()];
+  if(!body.code){
+    body.lambda = lambda;
+    body.code = compileBody(lambda);
+  }
+  return body.code;
+}
+
+std::vector<Expression> VM::popArgs(std::size_t n){
+
+  auto first = m_stack.end() - n;
+  std::vector<Expression> args(std::make_move_iterator(first), std::make_move_iterator(m_stack.end()));
+  m_stack.erase(first, m_stack.end());
+  return args;
+}
+
+bool VM::dispatch(const Atom & op, Arguments args, Environment & scope,
+                  Frame & callee, Expression & result){
+
+  const Expression * lambda = scope.find_exp(op);
+  if(lambda && lambda->isLambda()){
+
+    const Expression & arg_template = *lambda->tailConstBegin();
+    if(args.size() != arg_template.tailLength()){
+      throw SemanticError("Error: during apply: Error in call to procedure: invalid number of arguments.");
+    }
+
+    callee.code = bodyOf(*lambda);
+    callee.chunk = callee.code.get();
+    callee.ip = 0;
+
+    m_scopes.push_back(scope.callScope(lambda->closure().get()));
+    callee.scope = &m_scopes.back();
+    std::size_t count = 0;
+    for(auto p = arg_template.tailConstBegin(); p != arg_template.tailConstEnd(); p++){
+      callee.scope->add_exp(p->head(), args[count++]);
+    }
+    return true;
+  }
+
+  // head must be a symbol
+  if(!op.isSymbol()){
+    throw SemanticError("Error during evaluation: not a symbol");
+  }
+
+  // must map to a proc
+  if(!scope.is_proc(op)){
+    throw SemanticError("Error during evaluation: symbol does not name a procedure");
+  }
+
+  result = scope.get_proc(op)(args);
+  return false;
+}
+
+Expression VM::execute(const Chunk & chunk, Environment & env){
+
+  std::size_t base = m_stack.size();
+  std::size_t frameBase = m_frames.size();
+  std::size_t scopeBase = m_scopes.size();
+
+  // the running frame; the frames it was called from wait in m_frames
+  Frame current{nullptr, &chunk, 0, &env};
+
+  try {
+    while(true){
+
+      if(global_status_flag > 0){
+        throw SemanticError("Error: interpreter kernal interupted");
+      }
+
+      Environment & scope = *current.scope;
+      const Chunk & code = *current.chunk;
+      const Instruction & in = code.code[current.ip++];
+
+      switch(in.op){
+
+      case OpCode::PushConst:
+        m_stack.push_back(code.constants[in.a]);
+        break;
+
+      case OpCode::MakeLambda:
+        m_stack.push_back(code.constants[in.a]);
+        if(!scope.isGlobal()){
+          m_stack.back().setClosure(scope.capture());
+        }
+        break;
+
+      case OpCode::Lookup:
+        {
+          const Atom & sym = code.atoms[in.a];
+          const Expression * exp = scope.find_exp(sym);
+          if(exp){
+            m_stack.push_back(*exp);
+          }
+          else if(scope.is_proc(sym) && !scope.get_proc(sym).signature().accepts(0)){
+            // a call with no arguments to a procedure that needs some
+            throw SemanticError(scope.get_proc(sym).signature().arityError);
+          }
+          else{
+            throw SemanticError("Error during handle lookup: unknown symbol " + sym.asString());
+          }
+        }
+        break;
+
+      case OpCode::MakeList:
+        m_stack.push_back(Expression::packList(popArgs(in.a)));
+        break;
+
+      case OpCode::Pop:
+        m_stack.pop_back();
+        break;
+
+      case OpCode::CheckDefine:
+        {
+          const Atom & sym = code.atoms[in.a];
+          SymbolId s = sym.symbolId();
+          if(scope.is_fixed_proc(sym)){
+            throw SemanticError("Error during handle define: attempt to redefine a built-in procedure");
+          }
+          else if((s == PiSymbol) || (s == ESymbol) || (s == ISymbol)) {
+            throw SemanticError("Error during handle define: attempt to redefine a built-in symbol");
+          }
+        }
+        break;
+
+      case OpCode::Define:
+        scope.add_exp(code.atoms[in.a], m_stack.back());
+        break;
+
+      case OpCode::Call:
+        {
+          // the arguments are passed in place on the stack, and popped once
+          // the procedure has returned or the lambda has bound them
+          std::size_t n = in.b;
+          Arguments args(m_stack.data() + (m_stack.size() - n), n);
+          Frame callee{nullptr, nullptr, 0, nullptr};
+          Expression result;
+          bool entered = dispatch(code.atoms[in.a], args, scope, callee, result);
+          m_stack.erase(m_stack.end() - n, m_stack.end());
+          if(entered){
+            m_frames.push_back(std::move(current));
+            current = std::move(callee);
+          }
+          else{
+            m_stack.push_back(std::move(result));
+          }
+        }
+        break;
+
+      case OpCode::CallBuiltin:
+        {
+          std::size_t n = in.b;
+          Expression result = code.procedures[in.a].callResolved(Arguments(m_stack.data() + (m_stack.size() - n), n));
+          m_stack.erase(m_stack.end() - n, m_stack.end());
+          m_stack.push_back(std::move(result));
+        }
+        break;
+
+      case OpCode::CheckCallable:
+        {
+          const Atom & op = code.atoms[in.a];
+          const Expression * exp = scope.find_exp(op);
+          if(!exp || !exp->isLambda()){
+            if(!scope.is_proc(op) || (in.b & OperatorHasTail)){
+              throw SemanticError((in.b & CallerIsMap) ?
+                                  "Error: first argument to map not a procedure" :
+                                  "Error: first argument to apply not a procedure");
+            }
+          }
+        }
+        break;
+
+      case OpCode::Apply:
+        {
+          Expression arguments = std::move(m_stack.back());
+          m_stack.pop_back();
+          if(!arguments.isList()){
+            throw SemanticError("Error: second argument to apply not a list");
+          }
+
+          // the items of a boxed list are passed in place; unboxed numbers
+          // are boxed into a vector
+          std::vector<Expression> boxed;
+          Arguments args;
+          if(arguments.isRealVector() || arguments.isComplexVector()){
+            boxed.reserve(arguments.tailLength());
+            for(std::size_t i = 0; i < arguments.tailLength(); ++i){
+              boxed.push_back(arguments.item(i));
+            }
+            args = boxed;
+          }
+          else{
+            Expression::TailView items = arguments.tailView();
+            args = Arguments(items.begin(), items.size());
+          }
+
+          Frame callee{nullptr, nullptr, 0, nullptr};
+          Expression result;
+          if(dispatch(code.atoms[in.a], args, scope, callee, result)){
+            m_frames.push_back(std::move(current));
+            current = std::move(callee);
+          }
+          else{
+            m_stack.push_back(std::move(result));
+          }
+        }
+        break;
+
+      case OpCode::Map:
+        {
+          Expression list_evaled = std::move(m_stack.back());
+          m_stack.pop_back();
+          if(!list_evaled.isList()){
+            throw SemanticError("Error: second argument to apply not a list");
+          }
+
+          const Atom op = code.atoms[in.a];
+          std::vector<Expression> results;
+          results.reserve(list_evaled.tailLength());
+          for(std::size_t i = 0; i < list_evaled.tailLength(); ++i){
+            Expression item = list_evaled.item(i);
+            Frame callee{nullptr, nullptr, 0, nullptr};
+            Expression result;
+            if(dispatch(op, Arguments(&item, 1), scope, callee, result)){
+              result = execute(*callee.chunk, *callee.scope);
+              m_scopes.pop_back();
+            }
+            results.push_back(std::move(result));
+          }
+          m_stack.push_back(Expression::packList(std::move(results)));
+        }
+        break;
+
+      case OpCode::SetProperty:
+        {
+          Expression value = std::move(m_stack.back());
+          m_stack.pop_back();
+          m_stack.back().setProperty(SymbolId(in.a), value);
+        }
+        break;
+
+      case OpCode::GetProperty:
+        m_stack.back() = m_stack.back().property(SymbolId(in.a));
+        break;
+
+      case OpCode::EvalTree:
+        {
+          Expression exp = code.constants[in.a];
+          m_stack.push_back(exp.eval(scope));
+        }
+        break;
+
+      case OpCode::Fail:
+        throw SemanticError(code.strings[in.a]);
+
+      case OpCode::Return:
+        if(m_frames.size() == frameBase){
+          Expression result = std::move(m_stack.back());
+          m_stack.erase(m_stack.begin() + base, m_stack.end());
+          return result;
+        }
+        // the callee's result stays on the stack for the caller
+        current = std::move(m_frames.back());
+        m_frames.pop_back();
+        m_scopes.pop_back();
+        break;
+      }
+    }
+  }
+  catch(...){
+    m_stack.erase(m_stack.begin() + base, m_stack.end());
+    m_frames.erase(m_frames.begin() + frameBase, m_frames.end());
+    while(m_scopes.size() > scopeBase){
+      m_scopes.pop_back();
+    }
+    throw;
+  }
+}
@@ -0,0 +1,84 @@
+/*! \file vm.hpp
+Defines the virtual machine that executes compiled bytecode.
+ */
+#ifndef VM_HPP
+#define VM_HPP
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "environment.hpp"
+#include "expression.hpp"
+
+/*! \class VM
+\brief A stack machine executing Chunks against an Environment.
+
+Operands live on an explicit stack shared by all active calls. Calls to
+lambdas push a new frame instead of recursing on the C++ stack; only map,
+which must collect each result, re-enters the machine. The stacks keep
+their capacity between runs, so a VM kept for many runs stops allocating
+for them.
+ */
+class VM {
+public:
+
+  /*! Execute a chunk from its first instruction.
+    \param chunk the compiled program
+    \param env the environment the program runs in
+    \return the Expression left on the stack by Return
+    \throws SemanticError when a semantic error is encountered
+   */
+  Expression run(const Chunk & chunk, Environment & env);
+
+private:
+
+  // an activation record for a chunk being executed
+  struct Frame {
+    std::shared_ptr<const Chunk> code; // keeps a lambda body alive, may be null
+    const Chunk * chunk;
+    std::size_t ip;
+    Environment * scope; // the environment the chunk runs in
+  };
+
+  // the operand stack
+  std::vector<Expression> m_stack;
+
+  // the active frames, innermost last
+  std::vector<Frame> m_frames;
+
+  // the scopes of the active lambda calls, innermost last; a deque so the
+  // frames may point at them while more are added
+  std::deque<Environment> m_scopes;
+
+  // a body compiled for a lambda the tree-walking evaluator made, with the
+  // lambda, which keeps the key alive
+  struct Body {
+    Expression lambda;
+    std::shared_ptr<const Chunk> code;
+  };
+
+  // the bodies compiled during this run, by the lambda's parameter list
+  std::unordered_map<const Expression *, Body> m_bodies;
+
+  // return the compiled body of lambda, compiling it on its first call in
+  // this run
+  const std::shared_ptr<const Chunk> & bodyOf(const Expression & lambda);
+
+  // run chunk in env until its Return
+  Expression execute(const Chunk & chunk, Environment & env);
+
+  // pop the top n operands into a vector, preserving their order
+  std::vector<Expression> popArgs(std::size_t n);
+
+  // resolve a call of op; for a lambda push its scope, bind args in it,
+  // set callee to run its body and return true, otherwise call the
+  // procedure, store its result and return false. args may point into the
+  // operand stack, which is left untouched.
+  bool dispatch(const Atom & op, Arguments args, Environment & scope,
+                Frame & callee, Expression & result);
+};
+
+#endif
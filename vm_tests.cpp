@@ -0,0 +1,250 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sstream>
+#include <fstream>
+
+#include "bytecode.hpp"
+#include "vm.hpp"
+#include "interpreter.hpp"
+#include "semantic_error.hpp"
+#include "startup_config.hpp"
+
+static Expression parse_program(const std::string & program){
+
+  std::istringstream iss(program);
+  return parse(tokenize(iss));
+}
+
+static Interpreter startup_interpreter(Interpreter::EvaluationMode mode){
+
+  Interpreter interp;
+  interp.setEvaluationMode(mode);
+
+  std::ifstream startup_stream(STARTUP_FILE);
+  bool started = false;
+  REQUIRE_NOTHROW(started = interp.evaluateStartup(startup_stream));
+  REQUIRE(started);
+
+  return interp;
+}
+
+TEST_CASE( "Test compiling a procedure call", "[vm]" ) {
+
+  std::shared_ptr<const Chunk> chunk = compile(parse_program("(f 1 2)"));
+
+  REQUIRE(chunk->code.size() == 4);
+  REQUIRE(chunk->code[0].op == OpCode::PushConst);
+  REQUIRE(chunk->code[1].op == OpCode::PushConst);
+  REQUIRE(chunk->code[2].op == OpCode::Call);
+  REQUIRE(chunk->code[2].b == 2);
+  REQUIRE(chunk->code[3].op == OpCode::Return);
+  REQUIRE(chunk->atoms[chunk->code[2].a] == Atom("f"));
+}
+
+TEST_CASE( "Test compiling a built-in procedure call", "[vm]" ) {
+
+  {
+    std::shared_ptr<const Chunk> chunk = compile(parse_program("(+ 1 2)"));
+
+    Procedure add;
+    REQUIRE(builtinProcedure(Atom("+"), add));
+    REQUIRE(chunk->code.size() == 4);
+    REQUIRE(chunk->code[2].op == OpCode::CallBuiltin);
+    REQUIRE(chunk->code[2].b == 2);
+    REQUIRE(chunk->procedures[chunk->code[2].a] == add);
+  }
+
+  {
+    // the argument count is checked once, when the call is compiled
+    std::shared_ptr<const Chunk> chunk = compile(parse_program("(first (list 1) 2)"));
+
+    REQUIRE(chunk->code[chunk->code.size() - 2].op == OpCode::Fail);
+  }
+
+  {
+    // a parameter shadows the procedure in the lambda body
+    std::shared_ptr<const Chunk> chunk = compile(parse_program("(lambda (first) (first 1))"));
+
+    const Chunk & body = *chunk->constants[chunk->code[0].a].code();
+    REQUIRE(body.code[1].op == OpCode::Call);
+  }
+}
+
+TEST_CASE( "Test compiling special forms", "[vm]" ) {
+
+  {
+    std::shared_ptr<const Chunk> chunk = compile(parse_program("(begin (define a 1) (a))"));
+
+    REQUIRE(chunk->code[0].op == OpCode::CheckDefine);
+    REQUIRE(chunk->code[1].op == OpCode::PushConst);
+    REQUIRE(chunk->code[2].op == OpCode::Define);
+    REQUIRE(chunk->code[3].op == OpCode::Pop);
+    REQUIRE(chunk->code[4].op == OpCode::Lookup);
+    REQUIRE(chunk->code[5].op == OpCode::Return);
+  }
+
+  {
+    std::shared_ptr<const Chunk> chunk = compile(parse_program("(lambda (x) (* 2 x))"));
+
+    REQUIRE(chunk->code[0].op == OpCode::MakeLambda);
+    const Expression & lambda = chunk->constants[chunk->code[0].a];
+    REQUIRE(lambda.isLambda());
+    REQUIRE(lambda.code() != nullptr);
+    REQUIRE(lambda.code()->code.back().op == OpCode::Return);
+  }
+
+  {
+    // semantic errors known at compile time become Fail instructions
+    std::shared_ptr<const Chunk> chunk = compile(parse_program("(define begin 1)"));
+
+    REQUIRE(chunk->code[0].op == OpCode::Fail);
+  }
+}
+
+TEST_CASE( "Test running bytecode directly", "[vm]" ) {
+
+  Environment env;
+  VM vm;
+
+  REQUIRE(vm.run(*compile(parse_program("(+ 1 2)")), env) == Expression(3.));
+  REQUIRE(vm.run(*compile(parse_program("(define a (* 2 pi))")), env) == Expression(2*std::atan2(0, -1)));
+  REQUIRE(env.is_exp(Atom("a")));
+  REQUIRE_THROWS_AS(vm.run(*compile(parse_program("(+ 1 b)")), env), SemanticError);
+
+  // the VM recovers after an error
+  REQUIRE(vm.run(*compile(parse_program("(- a a)")), env) == Expression(0.));
+
+  // and after an error inside a call
+  REQUIRE(vm.run(*compile(parse_program("(define f (lambda (x) (+ x b)))")), env).isLambda());
+  REQUIRE_THROWS_AS(vm.run(*compile(parse_program("(list (f 1) 2)")), env), SemanticError);
+  REQUIRE(vm.run(*compile(parse_program("(begin (define b 1) (f 1))")), env) == Expression(2.));
+}
+
+TEST_CASE( "Test calling a lambda made by the tree-walking evaluator", "[vm]" ) {
+
+  Environment env;
+  parse_program("(define f (lambda (x) (* 2 x)))").eval(env);
+  REQUIRE(env.get_exp(Atom("f")).code() == nullptr);
+
+  // its body is compiled by the VM, which leaves the lambda untouched
+  VM vm;
+  REQUIRE(vm.run(*compile(parse_program("(f 2)")), env) == Expression(4.));
+  REQUIRE(vm.run(*compile(parse_program("(map f (list 1 2 3))")), env) == parse_program("(list 2 4 6)").eval(env));
+  REQUIRE(env.get_exp(Atom("f")).code() == nullptr);
+}
+
+TEST_CASE( "Test compiling a deeply nested program", "[vm]" ) {
+
+  // (+ 1 (+ 1 ... (+ 1 0))), compiled and run without recursing per level
+  const std::size_t depth = 100000;
+  std::string program;
+  for(std::size_t i = 0; i < depth; ++i){
+    program += "(+ 1 ";
+  }
+  program += "0" + std::string(depth, ')');
+
+  Interpreter interp;
+  std::istringstream iss(program);
+  REQUIRE(interp.parseStream(iss));
+  REQUIRE(interp.evaluate() == Expression(static_cast<double>(depth)));
+}
+
+TEST_CASE( "Test bytecode matches the tree-walking evaluator", "[vm]" ) {
+
+  std::vector<std::string> programs = {
+    "(4)",
+    "(pi)",
+    "(\"a string\")",
+    "(+ 1 2 3 4 5 6)",
+    "(- (* 3 I) (/ 1 2))",
+    "(begin (define a 1) (define b 2) (+ a b))",
+    "(list 1 (list 2 3) (+ 2 2))",
+    "(list)",
+    "(begin (define f (lambda (x) (* 2 x))) (f 5))",
+    "(begin (define f (lambda (x y) (+ x y))) (define g (lambda (x) (f x x))) (g 21))",
+    "(begin (define x 100) (define f (lambda (x) (* x x))) (list (f 3) x))",
+    "(lambda (x y) (+ x y 1))",
+    "(begin (define make-adder (lambda (n) (lambda (x) (+ x n)))) (define add1 (make-adder 1)) (add1 41))",
+    "(begin (define twice (lambda (f) (lambda (x) (f (f x))))) (define inc (lambda (x) (+ x 1))) (define inc2 (twice inc)) (inc2 5))",
+    "(begin (define f (lambda (n) (begin (define g (lambda (x) (h x))) (define h (lambda (y) (* y n))) (g 2)))) (f 5))",
+    "(apply + (list 1 2 3 4))",
+    "(begin (define linear (lambda (a b x) (+ (* a x) b))) (apply linear (list 3 4 5)))",
+    "(map / (list 1 4 8))",
+    "(begin (define f (lambda (x) (* 2 x))) (map f (range 0 10)))",
+    "(join (rest (list 1 2 3)) (append (list 4) 5))",
+    "(get-property \"type\" (set-property \"type\" \"number_list\" (list 0 1 2 3)))",
+    "(get-property \"size\" (make-point 1 2))",
+    "(make-line (make-point 0 0) (make-point 3 3))",
+    "(begin (define make-point (lambda (x y) (+ x y))) (make-point 1 2))",
+    "(make-line 1 2)",
+    "(make-text \"Hello\")",
+    "(discrete-plot (list (list -1 -1) (list 1 1)) (list (list \"title\" \"The Title\")))"
+  };
+
+  for(auto & program : programs){
+    INFO(program);
+
+    Interpreter walker = startup_interpreter(Interpreter::TreeWalk);
+    Interpreter machine = startup_interpreter(Interpreter::Bytecode);
+
+    std::istringstream iss1(program), iss2(program);
+    REQUIRE(walker.parseStream(iss1));
+    REQUIRE(machine.parseStream(iss2));
+
+    Expression expected = walker.evaluate();
+    Expression result = machine.evaluate();
+    REQUIRE(result == expected);
+    REQUIRE(result.isList() == expected.isList());
+    REQUIRE(result.isLambda() == expected.isLambda());
+  }
+}
+
+TEST_CASE( "Test bytecode raises the same errors as the tree-walking evaluator", "[vm]" ) {
+
+  std::vector<std::string> programs = {
+    "(begin)",
+    "(@ none)",
+    "(- 1 1 2)",
+    "(+ 1 a)",
+    "(1 2 3)",
+    "(define begin 1)",
+    "(define pi 3.14)",
+    "(define + 20)",
+    "(define 5 10)",
+    "(define q 20 40 *)",
+    "(first list)",
+    "(first (list 1) (list 2))",
+    "(first (+ 1 a) (list 2))",
+    "(sqrt \"a\")",
+    "(begin (define f (lambda (first) (first 1))) (f 2))",
+    "(begin (define f (lambda (x y) (# x y))) (f 5))",
+    "(begin (define f (lambda (+ x I) (+ x I))) (f 5))",
+    "(apply (+ z I) (list 0))",
+    "(apply 35 (list 0))",
+    "(apply + 35)",
+    "(map 3 (list 1 2 3 4))",
+    "(set-property not_a_string \"WILL FAIL\" (list 0 1 2 3))",
+    "(get-property 10 (list 0 1 2 3))",
+    "(get-property \"size\" +)",
+    "(discrete-plot (+ 2 3) (list (list 1)))"
+  };
+
+  for(auto & program : programs){
+    INFO(program);
+
+    Interpreter walker = startup_interpreter(Interpreter::TreeWalk);
+    Interpreter machine = startup_interpreter(Interpreter::Bytecode);
+
+    std::istringstream iss1(program), iss2(program);
+    REQUIRE(walker.parseStream(iss1));
+    REQUIRE(machine.parseStream(iss2));
+
+    std::string expected, error;
+    try { walker.evaluate(); } catch(const SemanticError & ex) { expected = ex.what(); }
+    try { machine.evaluate(); } catch(const SemanticError & ex) { error = ex.what(); }
+
+    REQUIRE(!expected.empty());
+    REQUIRE(error == expected);
+  }
+}